@@ -34,6 +34,16 @@
 /* Example/Board Header files */
 #include "Board.h"
 
+#include "datalog.h"
+#include "livestream.h"
+#include "adv_ctrl.h"
+#include "devconfig.h"
+#include "checkpoint.h"
+#include "timebase.h"
+#include "walltime.h"
+#include "samplegov.h"
+#include "wake.h"
+
 /************************************************************************************************
  * Configuration constants for SPIFFS.
  ***********************************************************************************************/
@@ -41,15 +51,6 @@
 #define SPIFFS_LOGICAL_PAGE_SIZE     (256) //size of a single page
 #define SPIFFS_FILE_DESCRIPTOR_SIZE  (22) //size of the file descriptor
 
-#define AMPLITUDE_SAMPLES      (44) //number of samples of amplitude written to memory at once
-#define AMPLITUDE_SIZE         (AMPLITUDE_SAMPLES * 4) //number of bytes written to memory at once
-                                                       //for amplitude
-#define PITCH_SAMPLES          (1) //number of samples of pitch written to memory at once
-#define PITCH_SIZE             (PITCH_SAMPLES * 10) //number of bytes written to memory at once for
-                                                   //pitch
-#define AMPLITUDE_PAGES        (2500) //maximum number of amplitude samples flash memory will hold
-#define PITCH_PAGES            (25) //maximum number of pitch samples flash memory will hold
-
 /************************************************************************************************
  * Thread stack configuration constants.
  ***********************************************************************************************/
@@ -62,6 +63,11 @@
 #define GO                0x0C
 #define MODE              0x01
 
+/************************************************************************************************
+ * Alert constants.
+ ***********************************************************************************************/
+#define ALERT_HOLDOFF     10000 //ms between two alerts, longer than ADVCTRL_BURST_DURATION
+
 /************************************************************************************************
  * Externs
  ***********************************************************************************************/
@@ -80,41 +86,18 @@ static uint8_t spiffsFileDescriptorCache[SPIFFS_FILE_DESCRIPTOR_SIZE * 4];
 // The array below will be used by SPIFFS as a read/write cache.
 static uint8_t spiffsReadWriteCache[SPIFFS_LOGICAL_PAGE_SIZE * 2];
 
-uint16_t amplitudeIndex = 0; //index within the amplitudeStruct for current samples
-
-//Values below are chosen since the file descriptor is the string representation of an integer.
-//These values ensure that the amplitude and pitch file descriptors don't share a name.
-uint16_t amplitudePageIndex = 0; //indicates the current amplitude structure.  i.e. after 5
-                                 //writes, this value would be 5.
-uint16_t pitchPageIndex = AMPLITUDE_PAGES + 1; //indicates the current pitch structure. i.e. after 5 writes,
-                                //this value would be AMPLITUDE_PAGES + 6.
-
-//Holds up to AMPLTUDE_SAMPLES of amplitude data, gathered every 1 second.
-//Format of amplitude data written/read from flash.
-struct amplitudeStruct {
-    uint16_t amplitude[AMPLITUDE_SAMPLES];
-    uint16_t timeStamp[AMPLITUDE_SAMPLES];
-};
-
-//Used to write/read pitch data to/from memory once every hour.
-struct pitchStruct {
-    uint16_t averagePitch;
-    uint16_t minimumPitch;
-    uint16_t maximumPitch;
-    uint16_t doctorThreshold;
-    uint16_t timeStamp;
-};
-
 //Varibles needed for spiffs configuration and use
 spiffs fs;
 SPIFFSNVS_Data spiffsnvsData;
 
 // Tasks
 Task_Struct myTask_spl;
+Task_Struct myTask_storage;
 //Task_Struct myTask_pitch;
 
 // Threads
 uint8_t myTaskStack_spl[THREADSTACKSIZE];
+uint8_t myTaskStack_storage[THREADSTACKSIZE];
 //uint8_t myTaskStack_pitch[THREADSTACKSIZE];
 
 //uint16_t adc_value_spl;
@@ -124,81 +107,64 @@ uint16_t adc_values[4]; //the current pitch values for:
                         //1 -> average pitch
                         //2 -> minimum pitch
                         //3 -> maximum pitch
-uint16_t noise_threshold = 0; //amplitude threshold for voice detection
-uint16_t doctor_threshold = 0; //amplitude threshold to trigger warning
+devConfig_t config; //thresholds, sample period, alert policy and log tiers in force
 uint64_t pitch_count = 0; //number of pitch samples taken since start of current hour
 uint64_t pitch_sum = 0; //sum of pitch samples taken since start of current hour
 
 bool first; //what is this for??
 
-//used for time stamping data
-time_t start_time;
-uint32_t start_time;
-//used for delaying main loop by 1 second
-time_t curr_time;
-uint32_t curr_time;
-//used for writing pitch data to flash once per hour
-time_t pitch_time;
-uint32_t pitch_time;
+//used for time stamping data, timebase units (never wraps)
+uint64_t start_time;
+//used for checkpointing the hour in progress once per minute
+uint64_t ckpt_time;
+//start of the current hourly window, seconds of WallTime_toSeconds
+uint32_t hour_start;
+volatile bool hour_due = false; //set by the hour clock, the window is closed by the task
+volatile bool time_set = false; //set after a Current Time write, the hour clock is started again by the task
+bool ckpt_dirty = false; //hourly data or log changed since the last checkpoint
+bool alert_armed = true; //the level has dropped below the doctor threshold since the last alert
+bool alert_sent = false; //an alert has been raised since boot
+uint64_t alert_time; //time of the last alert, timebase units
 
 
 /************************************************************************************************
  * Semaphore
  ***********************************************************************************************/
 Semaphore_Handle adcSem;
-uint16_t count;
-uint8_t gate = 0;
+uint8_t gate = 0; //sampling stopped, set by the button or after a long silence
+bool idle = false; //the task sleeps until a sound, the button or the hour clock
+volatile bool level_due = false; //set while idle when the level is to be read
 //IArg key; //not used??
 ADC_Handle   adc; //also defined in the main function??
 
-//these only appear in commented out code?  Is that code needed, are these needed??
+//sampling clock, posts adcSem once per sample period
 Clock_Struct clkStruct;
 Clock_Handle clkHandle;
 Clock_Params clkParams;
 
-/************************************************************************************************
- *
- * Mimics the itoa function included in standard C/C++ libraries.  Finds the string
- * representation of an integer.
- *
- ************************************************************************************************/
-void itoa(long unsigned int value, char* result, int base)
-    {
-      // check that the base if valid
-      if (base < 2 || base > 36) { *result = '\0';}
-
-      char* ptr = result, *ptr1 = result, tmp_char;
-      int tmp_value;
-
-      do {
-        tmp_value = value;
-        value /= base;
-        *ptr++ = "zyxwvutsrqponmlkjihgfedcba9876543210123456789abcdefghijklmnopqrstuvwxyz" [35 + (tmp_value - value * base)];
-      } while ( value );
-
-      // Apply negative sign
-      if (tmp_value < 0) *ptr++ = '-';
-      *ptr-- = '\0';
-      while(ptr1 < ptr) {
-        tmp_char = *ptr;
-        *ptr--= *ptr1;
-        *ptr1++ = tmp_char;
-      }
-}
+//hour clock, one shot at the next full hour
+Clock_Struct hourClkStruct;
+Clock_Handle hourClkHandle;
 
 /********** gpioButtonFxn0 **********/
 void gpioButtonFxn0(uint_least8_t index)
 {
-    if (count == 0) {
+    //a press also makes the watch quick to find again
+    AdvCtrl_wake();
+
+    //the task enters and leaves the idle, the LED shows it
+    if (gate == 0) {
         gate = 1;
-        GPIO_toggle(Board_GPIO_LED0);
-        count++;
     } else {
-        Semaphore_post(adcSem);
         gate = 0;
-        GPIO_toggle(Board_GPIO_LED0);
-        count = 0;
     }
+    Semaphore_post(adcSem);
+}
+
+void wakeFxn(void)
+{
+    level_due = true;
+    Semaphore_post(adcSem);
 }
 
 void clkFxn(void* arg0)
@@ -206,41 +172,139 @@ void clkFxn(void* arg0)
     Semaphore_post(adcSem);
 }
 
-/********** myThread_spl **********/
-void *myThread_spl(void *arg0) {
+void hourClkFxn(void* arg0)
+{
+    hour_due = true;
 
-    ADC_Handle              adc;                            //ADC paramters for reading SPL
-    ADC_Params              params;
-    ADC_Handle              adc2;                           //not used??
-    ADC_Params              params2;
-    uint8_t                 txBuffer[2];                    //TX and RX buffer for I2C
-    uint8_t                 rxBuffer[2];
-    I2C_Handle              i2c;                            //I2C configuration parameters
-    I2C_Params              i2cParams;
-    I2C_Transaction         i2cTransaction;
-    Semaphore_Params        semParams;                      //internal parameter for semaphores
-    spiffs_file             fd;                             //SPIFFS file descriptor
-    spiffs_config           fsConfig;                       //internal parameter for SPIFFS operations, not used otherwise
-    int32_t                 status;                         //status of SPIFFS operations, used for error checking
-    struct amplitudeStruct  amplitudeWrite;                 //holds amplitude data written to memory
-    struct pitchStruct      pitchWrite;                     //holds pitch data written to memory
-    char                    fileName[4];                    //SPIFFS file descriptor name
+    //the sampling clock wakes the task within a sample period, only wake it when sampling is stopped
+    if (idle) {
+        Semaphore_post(adcSem);
+    }
+}
 
+//called by the application task once a Current Time write is applied
+void timeSetFxn(void)
+{
+    time_set = true;
 
-    Semaphore_Params_init(&semParams);
-    adcSem = Semaphore_create(0, &semParams, Error_IGNORE);
-    count = 0;
-    if(adcSem == NULL)
-    {
-        /* Semaphore_create() failed */
-        Display_print0(dispHandle, 0, 0, "adcSem Semaphore creation failed\n");
-        while (1);
+    //same as the hour clock, a sampling task wakes within a sample period
+    if (idle) {
+        Semaphore_post(adcSem);
     }
+}
 
-    /* Initialize ADC and GPIO drivers */
-    GPIO_init();
-    ADC_init();
-    I2C_init();
+/********** scheduleHour **********/
+//starts the hour clock for the next full hour of the wall clock
+//returns the start of the hour in progress
+uint32_t scheduleHour(void)
+{
+    uint64_t now = WallTime_correct(Timebase_now());
+    uint32_t start = Timebase_toSeconds(now) / (60 * 60) * (60 * 60);
+    uint32_t ms = (uint32_t)Timebase_toMs(TIMEBASE_FROM_SEC(start + 60 * 60) - now);
+
+    Clock_stop(hourClkHandle);
+    Clock_setTimeout(hourClkHandle, (ms + 1) * (1000 / Clock_tickPeriod));
+    Clock_start(hourClkHandle);
+
+    return start;
+}
+
+/********** saveCheckpoint **********/
+void saveCheckpoint(uint64_t now)
+{
+    ckptState_t ckpt;
+
+    ckpt.hourStart = hour_start;
+    ckpt.pitchSum = (pitch_sum > 0xFFFFFFFF) ? 0xFFFFFFFF : pitch_sum;
+    ckpt.pitchCount = (pitch_count > 0xFFFFFFFF) ? 0xFFFFFFFF : pitch_count;
+    ckpt.pitchAvg = adc_values[1];
+    ckpt.pitchMin = adc_values[2];
+    ckpt.pitchMax = adc_values[3];
+    ckpt.first = first;
+    ckpt.reserved = 0;
+    Checkpoint_save(&ckpt);
+
+    //records since the last checkpoint
+    Datalog_sync();
+
+    ckpt_time = now;
+    ckpt_dirty = false;
+}
+
+/********** endHour **********/
+//writes the summary of the hour of hour_start, also when nothing was measured, and starts the one of next_start
+void endHour(uint32_t next_start)
+{
+    uint16_t pitchRecord[DATALOG_NUM_VALUES]; //hourly pitch values written to the log
+
+    if (pitch_count > 0) {
+        pitchRecord[0] = adc_values[1];
+        pitchRecord[1] = adc_values[2];
+        pitchRecord[2] = adc_values[3];
+    }
+    else {
+        pitchRecord[0] = 0;
+        pitchRecord[1] = 0;
+        pitchRecord[2] = 0;
+    }
+    pitchRecord[3] = config.doctorThreshold;
+    pitchRecord[4] = (pitch_count > 0xFFFF) ? 0xFFFF : pitch_count;
+    if (config.logTiers & DEVCONFIG_LOG_PITCH_HOUR) {
+        //stamped with the start of the hour it covers
+        Datalog_append(DATALOG_TYPE_PITCH_HOUR, hour_start, pitchRecord, DATALOG_NUM_VALUES);
+    }
+
+    hour_start = next_start;
+
+    first = true;
+    pitch_sum = 0;
+    pitch_count = 0;
+
+    //a reset must not bring the finished hour back
+    saveCheckpoint(Timebase_now());
+}
+
+/********** closeWindow **********/
+//ends the hour in progress when the hour clock fires
+void closeWindow(void)
+{
+    uint32_t next_start = scheduleHour();
+
+    hour_due = false;
+
+    //the clock ran fast against the wall clock, the hour is not over yet
+    if (next_start == hour_start) {
+        return;
+    }
+
+    endHour(next_start);
+}
+
+/********** rebaseHour **********/
+//starts the hour clock again on the wall clock just written
+//an hour begun before the clock was known goes on as the hour in progress, another one ends if the clock left it
+void rebaseHour(void)
+{
+    uint32_t next_start;
+
+    time_set = false;
+    next_start = scheduleHour();
+
+    if (hour_start < WALLTIME_MIN_EPOCH) {
+        hour_start = next_start;
+        ckpt_dirty = true;
+    } else if (next_start != hour_start) {
+        endHour(next_start);
+    }
+}
+
+/********** mountStorage **********/
+//mounts the file system, formats it first when none is found
+//returns false if the flash cannot be used
+bool mountStorage(void)
+{
+    spiffs_config           fsConfig;                       //internal parameter for SPIFFS operations, not used otherwise
+    int32_t                 status;                         //status of SPIFFS operations, used for error checking
 
     /*
      * Wake up external flash on LaunchPads. It is powered off by default
@@ -257,7 +321,7 @@ void *myThread_spl(void *arg0) {
         Display_printf(dispHandle, 0, 0,
             "Error with SPIFFS configuration.\n");
 
-        while (1);
+        return false;
     }
 
     Display_printf(dispHandle, 0, 0, "Mounting file system...");
@@ -286,7 +350,7 @@ void *myThread_spl(void *arg0) {
                 Display_printf(dispHandle, 0, 0,
                     "Error formatting memory.\n");
 
-                while (1);
+                return false;
             }
 
             status = SPIFFS_mount(&fs, &fsConfig, spiffsWorkBuffer,
@@ -296,7 +360,7 @@ void *myThread_spl(void *arg0) {
                 Display_printf(dispHandle, 0, 0,
                     "Error mounting file system.\n");
 
-                while (1);
+                return false;
             }
         }
         else {
@@ -304,10 +368,68 @@ void *myThread_spl(void *arg0) {
             Display_printf(dispHandle, 0, 0,
                 "Error mounting file system: %d.\n", status);
 
-            while (1);
+            return false;
         }
     }
-    /***********************************************************************************************/
+
+    return true;
+}
+
+/********** myThread_storage **********/
+//runs below the sensor task so a slow format or flash write never holds up sampling
+void *myThread_storage(void *arg0) {
+
+    //find the records left in flash by the previous run, the records taken
+    //while mounting are numbered after them
+    if (mountStorage()) {
+        Datalog_mount(&fs);
+    }
+    else {
+        //keep sensing and alerting, the log only lives in RAM
+        Display_printf(dispHandle, 0, 0, "Storage degraded, log kept in RAM only");
+        Datalog_mount(NULL);
+    }
+
+    //the records of the sensor task are written here, the sensor task never waits on the flash
+    while (1) {
+        Datalog_process();
+    }
+}
+
+/********** myThread_spl **********/
+void *myThread_spl(void *arg0) {
+
+    ADC_Handle              adc;                            //ADC paramters for reading SPL
+    ADC_Params              params;
+    ADC_Handle              adc2;                           //not used??
+    ADC_Params              params2;
+    uint8_t                 txBuffer[2];                    //TX and RX buffer for I2C
+    uint8_t                 rxBuffer[2];
+    I2C_Handle              i2c;                            //I2C configuration parameters
+    I2C_Params              i2cParams;
+    I2C_Transaction         i2cTransaction;
+    Semaphore_Params        semParams;                      //internal parameter for semaphores
+    uint16_t                samplePeriod;                   //sample period of the sampling clock
+    uint16_t                period;                         //sample period chosen by the governor
+    ckptState_t             ckpt;                           //hour in progress before a reset
+    uint32_t                now_start;                      //start of the hour in progress now
+
+
+    Semaphore_Params_init(&semParams);
+    adcSem = Semaphore_create(0, &semParams, Error_IGNORE);
+    if(adcSem == NULL)
+    {
+        /* Semaphore_create() failed */
+        Display_print0(dispHandle, 0, 0, "adcSem Semaphore creation failed\n");
+        while (1);
+    }
+
+    /* Initialize ADC and GPIO drivers */
+    GPIO_init();
+    ADC_init();
+    I2C_init();
+
+    //the file system is mounted by myThread_storage, records are held in RAM until then
 
 
     /************************************************************************************************
@@ -356,22 +478,88 @@ void *myThread_spl(void *arg0) {
             while (1);
     }
 
-    //time since last pitch write to flash (writes once every hour)
-    pitch_time = Clock_getTicks();
+    //the level channel is watched by the wake hardware while idle
+    Wake_init(adc, wakeFxn);
+
+    //start the sampling clock with the configuration saved by the last run
+    DevConfig_get(&config);
+    samplePeriod = SampleGov_init(&config);
+    Clock_Params_init(&clkParams);
+    clkParams.period = samplePeriod * 1000 / Clock_tickPeriod;
+    clkParams.startFlag = TRUE;
+    Clock_construct(&clkStruct, (Clock_FuncPtr)clkFxn, clkParams.period, &clkParams);
+    clkHandle = Clock_handle(&clkStruct);
+
+    //close the hourly window on the hour, whether or not anyone speaks
+    Clock_Params_init(&clkParams);
+    Clock_construct(&hourClkStruct, (Clock_FuncPtr)hourClkFxn, 0, &clkParams);
+    hourClkHandle = Clock_handle(&hourClkStruct);
+    now_start = scheduleHour();
+    hour_start = now_start;
+
+    //continue the hour that was in progress before a reset
+    if (Checkpoint_restore(&ckpt)) {
+        hour_start = ckpt.hourStart;
+        pitch_sum = ckpt.pitchSum;
+        pitch_count = ckpt.pitchCount;
+        adc_values[1] = ckpt.pitchAvg;
+        adc_values[2] = ckpt.pitchMin;
+        adc_values[3] = ckpt.pitchMax;
+        first = ckpt.first;
+    }
+    ckpt_time = Timebase_now();
+
+    //an hour that ended while the device was off is written on its own, not merged into this one
+    if (hour_start != now_start) {
+        endHour(now_start);
+    }
 
     //infinite loop
     while (1) {
+        if (time_set) {
+            rebaseHour();
+        }
+        if (hour_due) {
+            closeWindow();
+        }
+
         if (gate == 0) {
-            //Semaphore_pend(adcSem, BIOS_WAIT_FOREVER);
-            start_time = Clock_getTicks();
+            //sleep until the next sample period
+            Semaphore_pend(adcSem, BIOS_WAIT_FOREVER);
+            start_time = Timebase_now();
             //Display_printf(dispHandle, 16, 0, "Timer value: %d\n", start_time);
 
+            //pick up a configuration written over BLE
+            DevConfig_get(&config);
+
             //read amplitude value
             ADC_convert(adc, &adc_values);
             Display_printf(dispHandle, 6, 0, "SPL Value: %d\n", adc_values[0]);
 
+            //stream the amplitude to a subscribed central, wall clock time rounded to the sample period
+            LiveStream_push((uint32_t)(((Timebase_toMs(WallTime_correct(start_time)) + samplePeriod / 2) / samplePeriod) * samplePeriod),
+                            adc_values[0]);
+            AdvCtrl_setLevel(adc_values[0]);
+
+            //sample slower in silence or on a low battery, the configured rate is back one period after a sound
+            //and held while a central watches the live level
+            period = SampleGov_update(adc_values[0], &config, LiveStream_numSubscribers() != 0);
+            Wake_track(adc_values[0], config.noiseThreshold);
+            if (period != samplePeriod) {
+                samplePeriod = period;
+                Clock_stop(clkHandle);
+                Clock_setTimeout(clkHandle, samplePeriod * 1000 / Clock_tickPeriod);
+                Clock_setPeriod(clkHandle, samplePeriod * 1000 / Clock_tickPeriod);
+                Clock_start(clkHandle);
+            }
+
+            //the next alert is raised once the level has dropped below the doctor threshold
+            if (adc_values[0] <= config.doctorThreshold) {
+                alert_armed = true;
+            }
+
             //check if amplitude greater than speech threshold
-            if (adc_values[0] > noise_threshold) {
+            if (adc_values[0] > config.noiseThreshold) {
                 //read pitch value
                 ADC_convert(adc, &adc_value_pitch);
                 //adc_values.pitch = adc_value_pitch;
@@ -380,6 +568,7 @@ void *myThread_spl(void *arg0) {
                 //update running sum and average of pitch values over last hour
                 pitch_sum+=adc_value_pitch;
                 pitch_count++;
+                ckpt_dirty = true;
                 adc_values[1] = pitch_sum/pitch_count;
 
                 //set minimum and maximum pitch values if needed
@@ -398,111 +587,96 @@ void *myThread_spl(void *arg0) {
                 Display_printf(dispHandle, 8, 0, "Average Pitch value: %d\n", adc_values[1]);
                 Display_printf(dispHandle, 9, 0, "Min Pitch value: %d\n", adc_values[2]);
                 Display_printf(dispHandle, 10, 0, "Max Pitch value: %d\n", adc_values[3]);
-                Display_printf(dispHandle, 20, 0, "Doctor Threshold: %d\n", doctor_threshold);
-
-                //if hour elapsed since last pitch write to flash, write current values to flash and reset the hourly data
-                if ((start_time - pitch_time) > (100000 * 60 * 60)) {
-                    pitchWrite.averagePitch = adc_values[1];
-                    pitchWrite.minimumPitch = adc_values[2];
-                    pitchWrite.maximumPitch = adc_values[3];
-                    pitchWrite.doctorThreshold = doctor_threshold;
-                    pitchWrite.timeStamp = start_time / 100000;
-
-                    itoa(pitchPageIndex, &fileName, 10);
-                    fd = SPIFFS_open(&fs, &fileName, SPIFFS_RDWR, 0);
-                    if (fd >= 0) {
-                        Display_printf(dispHandle, 15, 40, "Removing spiffsFile for pitch: %d\n", pitchPageIndex);
-                        while (SPIFFS_fremove(&fs, fd) != SPIFFS_OK) {
-                            Display_printf(dispHandle, 19, 40, "Error removing spiffsFile for pitch. %d %d\n", pitchPageIndex, start_time / 100000);
-                        }
-                        SPIFFS_close(&fs, fd);
-                        fd = SPIFFS_open(&fs, &fileName, SPIFFS_RDWR, 0);
-                    }
-                    Display_printf(dispHandle, 14, 40, "Creating spiffsFile for pitch: %d\n", pitchPageIndex);
-                    fd = SPIFFS_open(&fs, &fileName, SPIFFS_CREAT | SPIFFS_RDWR, 0);
-                    while (fd < 0) {
-                        Display_printf(dispHandle, 16, 40, "Error creating spiffsFile for pitch. %d %d\n", pitchPageIndex, start_time / 100000);
-                        fd = SPIFFS_open(&fs, &fileName, SPIFFS_CREAT | SPIFFS_RDWR, 0);
-                    }
-                    Display_printf(dispHandle, 17, 40, "Writing to spiffsFile for pitch: %d\n", pitchPageIndex);
-                    if (SPIFFS_write(&fs, fd, (void *) &pitchWrite, PITCH_SIZE) < 0) {
-                        Display_printf( dispHandle, 21, 40, "Error writing spiffsFile for pitch: %d\n", pitchPageIndex);
-                    }
-                    SPIFFS_close(&fs, fd);
-                    pitch_time = Clock_getTicks();
-                    pitchPageIndex++;
-
-                    first = true;
-                    pitch_sum = 0;
-                    pitch_count = 0;
-                    if (pitchPageIndex > (AMPLITUDE_PAGES + PITCH_PAGES)) {
-                        pitchPageIndex = AMPLITUDE_PAGES + 1;
-                    }
-                }
+                Display_printf(dispHandle, 20, 0, "Doctor Threshold: %d\n", config.doctorThreshold);
 
                 //if ampitude greater than set doctor threshold, write current amplitude reading to flash and trigger haptic motor user alert
-                if (adc_values[0] > doctor_threshold) {
+                if (adc_values[0] > config.doctorThreshold) {
                     //write to memory
-                    amplitudeWrite.amplitude[amplitudeIndex] = adc_values[0];
-                    amplitudeWrite.timeStamp[amplitudeIndex] = start_time / 100000;
-                    Display_printf(dispHandle, 11, 0, "Amplitude Index: %d\n", amplitudeIndex);
-                    Display_printf(dispHandle, 12, 0, "Amplitude Value: %d\n", adc_values[0]);
-                    Display_printf(dispHandle, 13, 0, "Time Stamp: %d\n", start_time / 100000);
-
-                    if (amplitudeIndex > AMPLITUDE_SAMPLES - 1) {
-                        itoa(amplitudePageIndex, &fileName, 10);
-                        fd = SPIFFS_open(&fs, &fileName, SPIFFS_RDWR, 0);
-                        if (fd >= 0) {
-                            Display_printf(dispHandle, 15, 0, "Removing spiffsFile: %d\n", amplitudePageIndex);
-                            while (SPIFFS_fremove(&fs, fd) != SPIFFS_OK) {
-                                Display_printf(dispHandle, 19, 0, "Error removing spiffsFile. %d %d\n", amplitudePageIndex, start_time / 100000);
-                            }
-                            SPIFFS_close(&fs, fd);
-                            fd = SPIFFS_open(&fs, &fileName, SPIFFS_RDWR, 0);
-                        }
-                        Display_printf(dispHandle, 14, 0, "Creating spiffsFile: %d\n", amplitudePageIndex);
-                        fd = SPIFFS_open(&fs, &fileName, SPIFFS_CREAT | SPIFFS_RDWR, 0);
-                        while (fd < 0) {
-                            Display_printf(dispHandle, 16, 0, "Error creating spiffsFile. %d %d\n", amplitudePageIndex, start_time / 100000);
-                            fd = SPIFFS_open(&fs, &fileName, SPIFFS_CREAT | SPIFFS_RDWR, 0);
-                        }
-                        Display_printf(dispHandle, 17, 0, "Writing to spiffsFile: %d\n", amplitudePageIndex);
-                        if (SPIFFS_write(&fs, fd, (void *) &amplitudeWrite, AMPLITUDE_SIZE) < 0) {
-                            Display_printf( dispHandle, 21, 0, "Error writing spiffsFile: %d\n", amplitudePageIndex);
-                        }
-                        //Display_printf(dispHandle, 18, 0, "Write Success: %d\n", amplitudePageIndex);
-                        SPIFFS_close(&fs, fd);
-                        amplitudePageIndex++;
-                        amplitudeIndex = 0;
-                        if (amplitudePageIndex > AMPLITUDE_PAGES) {
-                            amplitudePageIndex = 0;
+                    if (config.logTiers & DEVCONFIG_LOG_AMPLITUDE) {
+                        Datalog_append(DATALOG_TYPE_AMPLITUDE, WallTime_toSeconds(start_time),
+                                       &adc_values[0], 1);
+                        ckpt_dirty = true;
+                    }
+                    //broadcast and notify on the way up only, a long loud period is one alert
+                    if (alert_armed &&
+                        (!alert_sent || (start_time - alert_time) >= TIMEBASE_FROM_MS(ALERT_HOLDOFF))) {
+                        alert_armed = false;
+                        alert_sent = true;
+                        alert_time = start_time;
+                        if (config.alertPolicy & DEVCONFIG_ALERT_ADVERTISE) {
+                            AdvCtrl_setAlert(WallTime_toSeconds(start_time));
                         }
+                        //notify the centrals subscribed to alerts
+                        LiveStream_alert(WallTime_toSeconds(start_time), adc_values[0]);
                     }
-                    amplitudeIndex++;
+                    Display_printf(dispHandle, 11, 0, "Log Head: %d\n", Datalog_getHeadSeq());
+                    Display_printf(dispHandle, 12, 0, "Amplitude Value: %d\n", adc_values[0]);
+                    Display_printf(dispHandle, 13, 0, "Time Stamp: %d\n", WallTime_toSeconds(start_time));
+
                     //haptic write
-                    txBuffer[0] = MODE;
-                    txBuffer[1] = 0x00;
-                    if(!I2C_transfer(i2c, &i2cTransaction)) {
-                        Display_printf(dispHandle, 15, 0, "Error. No Haptic Driver found!");
-                        while(1);
+                    if (config.alertPolicy & DEVCONFIG_ALERT_HAPTIC) {
+                        txBuffer[0] = MODE;
+                        txBuffer[1] = 0x00;
+                        if(!I2C_transfer(i2c, &i2cTransaction)) {
+                            Display_printf(dispHandle, 15, 0, "Error. No Haptic Driver found!");
+                            while(1);
+                        }
+                        txBuffer[0] = GO;
+                        txBuffer[1] = 0x01;
+                        I2C_transfer(i2c, &i2cTransaction);
                     }
-                    txBuffer[0] = GO;
-                    txBuffer[1] = 0x01;
-                    I2C_transfer(i2c, &i2cTransaction);
                     Display_printf(dispHandle, 12, 0, "Above Doctor Threshold");
                 } else {
                     Display_printf(dispHandle, 12, 0, "Not within range!");
                 }
             }
-            curr_time = Clock_getTicks();
-            //delay for 1 second
-            while ((curr_time - start_time) < 10) { //1 second is 100000, value temporarily lowered for testing
-                curr_time = Clock_getTicks();
+
+            //checkpoint the hour in progress and the new log records once a minute
+            if (ckpt_dirty && (start_time - ckpt_time) > TIMEBASE_FROM_MS(CHECKPOINT_PERIOD)) {
+                saveCheckpoint(start_time);
+            }
+
+            //nobody has spoken for a minute, stop sampling until someone does
+            if ((SampleGov_getSilence() >= WAKE_IDLE_AFTER) && (LiveStream_numSubscribers() == 0)) {
+                gate = 1;
             }
         } else {
-            /* Pend on semaphore, tmp116Sem */
-            /* Blocking mode conversion */
+            //a central watching the live level keeps the task sampling, the button included
+            if (!idle && LiveStream_numSubscribers()) {
+                gate = 0;
+                continue;
+            }
+            //no sampling while idle, a sound, the button or the hour clock wakes the task
+            if (!idle) {
+                Clock_stop(clkHandle);
+                //the idle may last hours, a reset must not lose what came before
+                if (ckpt_dirty) {
+                    saveCheckpoint(Timebase_now());
+                }
+                SampleGov_sleep();
+                Wake_enter(config.noiseThreshold);
+                GPIO_write(Board_GPIO_LED0, Board_GPIO_LED_ON);
+                idle = true;
+            }
             Semaphore_pend(adcSem, BIOS_WAIT_FOREVER);
+            //a sound, or a central subscribing to the live level, ends the idle
+            if (level_due) {
+                level_due = false;
+                if (Wake_poll() || LiveStream_numSubscribers()) {
+                    gate = 0;
+                }
+            }
+            //still idle when woken by the hour clock, a Current Time write or a quiet reading
+            if (gate == 0) {
+                Wake_exit();
+                GPIO_write(Board_GPIO_LED0, Board_GPIO_LED_OFF);
+                idle = false;
+                DevConfig_get(&config);
+                samplePeriod = SampleGov_wake(&config);
+                Clock_setTimeout(clkHandle, samplePeriod * 1000 / Clock_tickPeriod);
+                Clock_setPeriod(clkHandle, samplePeriod * 1000 / Clock_tickPeriod);
+                Clock_start(clkHandle);
+            }
         }
     }
 }
@@ -510,13 +684,27 @@ void *myThread_spl(void *arg0) {
 /********** myThread_create **********/
 void myThread_create(void) {
     Task_Params taskParams_spl;
+    Task_Params taskParams_storage;
 
     // Configure task
     Task_Params_init(&taskParams_spl);
     taskParams_spl.stack = myTaskStack_spl;
     taskParams_spl.stackSize = THREADSTACKSIZE;
-    taskParams_spl.priority = 1;
+    taskParams_spl.priority = 2;
     first = true;
 
+    //mounting and formatting the flash can take seconds, done by its own task
+    Task_Params_init(&taskParams_storage);
+    taskParams_storage.stack = myTaskStack_storage;
+    taskParams_storage.stackSize = THREADSTACKSIZE;
+    taskParams_storage.priority = 1;
+
+    //the log can be queried by the BLE task before the file system is mounted
+    Datalog_init();
+
+    //sampling waits for the BLE task to load the last checkpoint
+    Checkpoint_init();
+
    Task_construct(&myTask_spl, (ti_sysbios_knl_Task_FuncPtr)myThread_spl, &taskParams_spl, Error_IGNORE);
+   Task_construct(&myTask_storage, (ti_sysbios_knl_Task_FuncPtr)myThread_storage, &taskParams_storage, Error_IGNORE);
 }
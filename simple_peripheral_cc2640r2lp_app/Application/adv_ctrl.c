@@ -0,0 +1,945 @@
+/******************************************************************************
+
+ @file  adv_ctrl.c
+
+ @brief Advertising control, runs in the context of the application task
+        except for the AdvCtrl_set* functions.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Event.h>
+
+#include <driverlib/aon_batmon.h>
+
+#include <icall.h>
+#include "util.h"
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+#include "peripheral.h"
+#include "gapbondmgr.h"
+
+#include "timebase.h"
+#include "adv_ctrl.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Position of the fields in the summary AD structure
+#define ADVCTRL_LEVEL_POS             5
+#define ADVCTRL_ALERT_POS             7
+#define ADVCTRL_BATTERY_POS           11
+
+// Position of the fields in the alert advertising data
+#define ADVCTRL_ALERT_SEQ_POS         8
+#define ADVCTRL_ALERT_TIME_POS        9
+#define ADVCTRL_ALERT_LEVEL_POS       13
+
+// Alert burst states
+#define ADVCTRL_BURST_IDLE            0 // Normal advertising
+#define ADVCTRL_BURST_STOPPING        1 // Connectable advertising ending
+#define ADVCTRL_BURST_ON              2 // Broadcasting the alert
+#define ADVCTRL_BURST_RESTORING       3 // Burst ending
+
+// Reconnect modes
+#define ADVCTRL_RECONN_NONE           0 // Open to any central
+#define ADVCTRL_RECONN_DIRECTED       1 // Directed at the lost peer
+#define ADVCTRL_RECONN_WHITELIST      2 // Only bonded centrals
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static ICall_SyncHandle advCtrlEvent = NULL;
+static uint32_t advCtrlUpdateEvent;
+
+static uint8_t *pAdv;
+static uint8_t advLen;
+
+// Summary AD structure in the advertising data, NULL if there is none
+static uint8_t *pSummary = NULL;
+
+// Values reported by the other tasks
+static volatile uint16_t level = 0;
+static volatile uint32_t alertTime = ADVCTRL_NO_ALERT;
+static volatile uint8_t dirty = FALSE;
+
+// Time of the last advertising data update
+static uint64_t lastUpdateTime;
+
+// Clock for the rate limit, the battery measurement, the burst length and
+// the stage and whitelist durations
+static Clock_Struct advCtrlClock;
+static Clock_Struct batteryClock;
+static Clock_Struct burstClock;
+static Clock_Struct stageClock;
+static Clock_Struct reconnClock;
+
+// Current GAP Role state
+static gaprole_States_t gapState = GAPROLE_INIT;
+
+// Alert burst
+static uint8_t burstState = ADVCTRL_BURST_IDLE;
+static volatile uint8_t alertPending = FALSE;
+static uint8_t burstInConn;     // Burst while connected, no connectable
+                                // advertising to restore
+static uint16_t savedIntMin;    // Advertising interval before the burst
+static uint16_t savedIntMax;
+
+// Advertising stage
+static uint8_t stage = ADVCTRL_STAGE_FAST;
+static uint8_t stageStarted = FALSE;  // Duration running, set on the first
+                                      // advertising at the stage
+static uint8_t restarting = FALSE;    // Advertising stopped to apply a new
+                                      // interval
+static volatile uint8_t wakePending = FALSE;
+static uint32_t stageDuration[ADVCTRL_NUM_STAGES] =
+{
+  ADVCTRL_FAST_DURATION,
+  ADVCTRL_SLOW_DURATION,
+  0
+};
+static const uint16_t stageInterval[ADVCTRL_NUM_STAGES] =
+{
+  ADVCTRL_FAST_INTERVAL,
+  ADVCTRL_SLOW_INTERVAL,
+  ADVCTRL_BACKGROUND_INTERVAL
+};
+
+// Reconnect to the last peer
+static uint8_t reconnMode = ADVCTRL_RECONN_NONE;
+static uint8_t connected = FALSE;
+static uint8_t peerAddrType;
+static uint8_t peerAddr[B_ADDR_LEN];
+
+// Time spent at each stage
+static advCtrlStats_t stats;
+static uint16_t stageMs[ADVCTRL_NUM_STAGES];  // Part of a second not yet
+                                              // counted in stats
+static uint64_t stageTime;
+
+// Advertising data of the alert burst
+static uint8_t alertAdvData[] =
+{
+  0x02,   // length of this data
+  GAP_ADTYPE_FLAGS,
+  GAP_ADTYPE_FLAGS_BREDR_NOT_SUPPORTED,
+
+  0x0B,   // length of this data
+  GAP_ADTYPE_MANUFACTURER_SPECIFIC,
+  LO_UINT16(ADVCTRL_COMPANY_ID),
+  HI_UINT16(ADVCTRL_COMPANY_ID),
+  ADVCTRL_ALERT_VERSION,
+  0x00,                     // alertSeq
+  0x00, 0x00, 0x00, 0x00,   // alertTime
+  0x00, 0x00                // level
+};
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void advCtrl_clockHandler(UArg arg);
+static void advCtrl_markDirty(void);
+static void advCtrl_publishSummary(void);
+static void advCtrl_startBurst(void);
+static void advCtrl_burstOn(void);
+static void advCtrl_endBurst(void);
+static void advCtrl_burstDone(void);
+static void advCtrl_setInterval(uint16_t intMin, uint16_t intMax);
+static void advCtrl_setStage(uint8_t newStage);
+static void advCtrl_countStageTime(void);
+static void advCtrl_linkLost(void);
+static void advCtrl_endReconnect(void);
+static uint8_t *advCtrl_findSummary(void);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      AdvCtrl_init
+ *
+ * @brief   Initialize the advertising control.
+ *
+ * @param   syncEvent   - event of the application task
+ * @param   updateEvent - event posted when AdvCtrl_processUpdate must run
+ * @param   pAdvData    - advertising data holding ADVCTRL_SUMMARY_AD, kept
+ *                        by the caller
+ * @param   advDataLen  - length of the advertising data
+ *
+ * @return  none
+ */
+void AdvCtrl_init(ICall_SyncHandle syncEvent, uint32_t updateEvent,
+                  uint8_t *pAdvData, uint8_t advDataLen)
+{
+  advCtrlEvent = syncEvent;
+  advCtrlUpdateEvent = updateEvent;
+  pAdv = pAdvData;
+  advLen = advDataLen;
+  pSummary = advCtrl_findSummary();
+
+  AONBatMonEnable();
+
+  Util_constructClock(&advCtrlClock, advCtrl_clockHandler,
+                      ADVCTRL_MIN_UPDATE_PERIOD, 0, false, updateEvent);
+  Util_constructClock(&batteryClock, advCtrl_clockHandler,
+                      ADVCTRL_BATTERY_PERIOD, ADVCTRL_BATTERY_PERIOD, true,
+                      updateEvent);
+  Util_constructClock(&burstClock, advCtrl_clockHandler,
+                      ADVCTRL_BURST_DURATION, 0, false, updateEvent);
+  Util_constructClock(&stageClock, advCtrl_clockHandler,
+                      ADVCTRL_FAST_DURATION, 0, false, updateEvent);
+  Util_constructClock(&reconnClock, advCtrl_clockHandler,
+                      ADVCTRL_WHITELIST_DURATION, 0, false, updateEvent);
+
+  // Start with fast advertising
+  advCtrl_setInterval(stageInterval[ADVCTRL_STAGE_FAST],
+                      stageInterval[ADVCTRL_STAGE_FAST]);
+  stageTime = Timebase_now();
+
+  // Publish the first summary right away
+  lastUpdateTime = stageTime - TIMEBASE_FROM_MS(ADVCTRL_MIN_UPDATE_PERIOD);
+  dirty = TRUE;
+  Event_post(advCtrlEvent, advCtrlUpdateEvent);
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_setLevel
+ *
+ * @brief   Report the current level. Can be called from any task.
+ *
+ * @param   newLevel - amplitude sample
+ *
+ * @return  none
+ */
+void AdvCtrl_setLevel(uint16_t newLevel)
+{
+  uint16_t diff = (newLevel > level) ? (newLevel - level) :
+                                       (level - newLevel);
+
+  if (diff >= ADVCTRL_LEVEL_HYSTERESIS)
+  {
+    level = newLevel;
+    advCtrl_markDirty();
+  }
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_setAlert
+ *
+ * @brief   Report that the doctor threshold was exceeded. Can be called
+ *          from any task.
+ *
+ * @param   time - time of the alert in seconds
+ *
+ * @return  none
+ */
+void AdvCtrl_setAlert(uint32_t time)
+{
+  alertTime = time;
+  alertPending = TRUE;
+  advCtrl_markDirty();
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_wake
+ *
+ * @brief   Go back to the fast advertising stage, for instance on a button
+ *          press. Can be called from any task or interrupt.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void AdvCtrl_wake(void)
+{
+  wakePending = TRUE;
+
+  if (advCtrlEvent != NULL)
+  {
+    Event_post(advCtrlEvent, advCtrlUpdateEvent);
+  }
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_setStageDuration
+ *
+ * @brief   Set how long an advertising stage lasts before the next, slower
+ *          one. Applies from the next time the stage is entered.
+ *
+ * @param   stageId  - ADVCTRL_STAGE_FAST or ADVCTRL_STAGE_SLOW
+ * @param   duration - duration in ms, 0 to stay in the stage
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+bStatus_t AdvCtrl_setStageDuration(uint8_t stageId, uint32_t duration)
+{
+  if (stageId >= ADVCTRL_STAGE_BACKGROUND)
+  {
+    return INVALIDPARAMETER;
+  }
+
+  stageDuration[stageId] = duration;
+
+  return SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_getStats
+ *
+ * @brief   Get the time spent at each advertising stage.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+void AdvCtrl_getStats(advCtrlStats_t *pStats)
+{
+  advCtrl_countStageTime();
+  *pStats = stats;
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_resetStats
+ *
+ * @brief   Clear the advertising stage counters.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void AdvCtrl_resetStats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  memset(stageMs, 0, sizeof(stageMs));
+  stageTime = Timebase_now();
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_processStateChange
+ *
+ * @brief   Follow the GAP Role state, to be called for every state change
+ *          before the application handles it.
+ *
+ * @param   newState - new state
+ *
+ * @return  none
+ */
+void AdvCtrl_processStateChange(gaprole_States_t newState)
+{
+  uint8_t advertEnabled = TRUE;
+  uint8_t stopped = ((newState == GAPROLE_WAITING) ||
+                     (newState == GAPROLE_WAITING_AFTER_TIMEOUT));
+
+  // Close the time of the previous state
+  advCtrl_countStageTime();
+  gapState = newState;
+
+  if (newState == GAPROLE_CONNECTED)
+  {
+    // The advertising after the disconnect depends on how the link ends,
+    // keep the GAP Role from restarting it by itself
+    advertEnabled = FALSE;
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+    advertEnabled = TRUE;
+    GAPRole_GetParameter(GAPROLE_BD_ADDR_TYPE, &peerAddrType);
+    GAPRole_GetParameter(GAPROLE_CONN_BD_ADDR, peerAddr);
+    connected = TRUE;
+    advCtrl_endReconnect();
+
+    // Advertising after the disconnect starts fast
+    restarting = FALSE;
+    if (stage != ADVCTRL_STAGE_FAST)
+    {
+      stats.numWakes++;
+      advCtrl_setStage(ADVCTRL_STAGE_FAST);
+    }
+    Util_stopClock(&stageClock);
+    stageStarted = FALSE;
+  }
+  else if ((newState == GAPROLE_ADVERTISING) && !stageStarted)
+  {
+    stageStarted = TRUE;
+    if (stageDuration[stage] != 0)
+    {
+      Util_restartClock(&stageClock, stageDuration[stage]);
+    }
+  }
+
+  switch (burstState)
+  {
+    case ADVCTRL_BURST_STOPPING:
+      if (stopped)
+      {
+        advCtrl_burstOn();
+      }
+      else if (newState == GAPROLE_CONNECTED)
+      {
+        // A central connected before connectable advertising ended
+#ifdef PLUS_BROADCASTER
+        burstInConn = TRUE;
+        advCtrl_burstOn();
+#else
+        advCtrl_burstDone();
+#endif // PLUS_BROADCASTER
+      }
+      break;
+
+    case ADVCTRL_BURST_RESTORING:
+      if (stopped || (newState == GAPROLE_CONNECTED))
+      {
+        advCtrl_burstDone();
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (connected && stopped)
+  {
+    connected = FALSE;
+    if (burstState == ADVCTRL_BURST_IDLE)
+    {
+      advCtrl_linkLost();
+    }
+  }
+  else if ((reconnMode == ADVCTRL_RECONN_DIRECTED) && stopped)
+  {
+    uint8_t eventType = GAP_ADTYPE_ADV_IND;
+    uint8_t filterPolicy = GAP_FILTER_POLICY_WHITE;
+
+    // The peer did not answer the directed advertising, let any bonded
+    // central reconnect for a while
+    reconnMode = ADVCTRL_RECONN_WHITELIST;
+    GAPRole_SetParameter(GAPROLE_ADV_EVENT_TYPE, sizeof(uint8_t),
+                         &eventType);
+    GAPRole_SetParameter(GAPROLE_ADV_FILTER_POLICY, sizeof(uint8_t),
+                         &filterPolicy);
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+    Util_restartClock(&reconnClock, ADVCTRL_WHITELIST_DURATION);
+  }
+  else if (restarting && stopped)
+  {
+    // Advertising again at the interval of the new stage, unless a burst
+    // took over
+    restarting = FALSE;
+    if (burstState == ADVCTRL_BURST_IDLE)
+    {
+      GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                           &advertEnabled);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_isBursting
+ *
+ * @brief   Check if the non-connectable advertising in progress is an
+ *          alert burst.
+ *
+ * @param   none
+ *
+ * @return  TRUE during an alert burst
+ */
+uint8_t AdvCtrl_isBursting(void)
+{
+  return (burstState != ADVCTRL_BURST_IDLE);
+}
+
+/*********************************************************************
+ * @fn      AdvCtrl_processUpdate
+ *
+ * @brief   Process the update event given to AdvCtrl_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void AdvCtrl_processUpdate(void)
+{
+  uint8_t battery;
+  uint32_t elapsed;
+
+  // Also keeps the stage time below the wrap of the clock ticks
+  advCtrl_countStageTime();
+
+  if (wakePending)
+  {
+    wakePending = FALSE;
+    stats.numWakes++;
+    advCtrl_endReconnect();
+    advCtrl_setStage(ADVCTRL_STAGE_FAST);
+
+    if (((gapState == GAPROLE_WAITING) ||
+         (gapState == GAPROLE_WAITING_AFTER_TIMEOUT)) &&
+        !restarting && (burstState == ADVCTRL_BURST_IDLE))
+    {
+      uint8_t advertEnabled = TRUE;
+
+      // Advertising was off, the button makes the watch discoverable again
+      GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                           &advertEnabled);
+    }
+  }
+  else if ((reconnMode == ADVCTRL_RECONN_WHITELIST) &&
+           !Util_isActive(&reconnClock))
+  {
+    advCtrl_endReconnect();
+  }
+  else if (stageStarted && (stageDuration[stage] != 0) &&
+           !Util_isActive(&stageClock) &&
+           (stage < ADVCTRL_STAGE_BACKGROUND))
+  {
+    advCtrl_setStage(stage + 1);
+  }
+
+  if (pSummary == NULL)
+  {
+    return;
+  }
+
+  if (alertPending)
+  {
+    advCtrl_startBurst();
+  }
+  else if ((burstState == ADVCTRL_BURST_ON) && !Util_isActive(&burstClock))
+  {
+    advCtrl_endBurst();
+  }
+
+  // 3.8 fixed point voltage, kept in 1/32 V
+  battery = (uint8_t)(AONBatMonBatteryVoltageGet() >> 3);
+  if (battery != pSummary[ADVCTRL_BATTERY_POS])
+  {
+    pSummary[ADVCTRL_BATTERY_POS] = battery;
+    dirty = TRUE;
+  }
+
+  // The summary goes out again when the burst is over
+  if (!dirty || (burstState != ADVCTRL_BURST_IDLE))
+  {
+    return;
+  }
+
+  elapsed = Timebase_msSince(lastUpdateTime);
+  if (elapsed < ADVCTRL_MIN_UPDATE_PERIOD)
+  {
+    // Updated too recently, come back when the rate limit allows it
+    if (!Util_isActive(&advCtrlClock))
+    {
+      Util_restartClock(&advCtrlClock, ADVCTRL_MIN_UPDATE_PERIOD - elapsed);
+    }
+    return;
+  }
+
+  advCtrl_publishSummary();
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      advCtrl_clockHandler
+ *
+ * @brief   Clock handler, wakes up the application task.
+ *
+ * @param   arg - event to post
+ *
+ * @return  none
+ */
+static void advCtrl_clockHandler(UArg arg)
+{
+  Event_post(advCtrlEvent, arg);
+}
+
+/*********************************************************************
+ * @fn      advCtrl_publishSummary
+ *
+ * @brief   Put the current summary in the advertising data.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_publishSummary(void)
+{
+  dirty = FALSE;
+  pSummary[ADVCTRL_LEVEL_POS] = LO_UINT16(level);
+  pSummary[ADVCTRL_LEVEL_POS + 1] = HI_UINT16(level);
+  pSummary[ADVCTRL_ALERT_POS] = BREAK_UINT32(alertTime, 0);
+  pSummary[ADVCTRL_ALERT_POS + 1] = BREAK_UINT32(alertTime, 1);
+  pSummary[ADVCTRL_ALERT_POS + 2] = BREAK_UINT32(alertTime, 2);
+  pSummary[ADVCTRL_ALERT_POS + 3] = BREAK_UINT32(alertTime, 3);
+
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, advLen, pAdv);
+  lastUpdateTime = Timebase_now();
+}
+
+/*********************************************************************
+ * @fn      advCtrl_startBurst
+ *
+ * @brief   Broadcast the last alert. An alert during a burst replaces the
+ *          one broadcast, the burst does not last longer for it.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_startBurst(void)
+{
+  uint8_t advertEnabled = FALSE;
+
+  if ((burstState == ADVCTRL_BURST_STOPPING) ||
+      (burstState == ADVCTRL_BURST_RESTORING) ||
+      (reconnMode == ADVCTRL_RECONN_DIRECTED))
+  {
+    // Started again once advertising has settled
+    return;
+  }
+
+  alertPending = FALSE;
+
+  burstInConn = ((gapState == GAPROLE_CONNECTED) ||
+                 (gapState == GAPROLE_CONNECTED_ADV));
+#ifndef PLUS_BROADCASTER
+  if (burstInConn)
+  {
+    // The stack cannot advertise during a connection, the alert only
+    // goes out in the summary
+    return;
+  }
+#endif // !PLUS_BROADCASTER
+
+  alertAdvData[ADVCTRL_ALERT_SEQ_POS]++;
+  alertAdvData[ADVCTRL_ALERT_TIME_POS] = BREAK_UINT32(alertTime, 0);
+  alertAdvData[ADVCTRL_ALERT_TIME_POS + 1] = BREAK_UINT32(alertTime, 1);
+  alertAdvData[ADVCTRL_ALERT_TIME_POS + 2] = BREAK_UINT32(alertTime, 2);
+  alertAdvData[ADVCTRL_ALERT_TIME_POS + 3] = BREAK_UINT32(alertTime, 3);
+  alertAdvData[ADVCTRL_ALERT_LEVEL_POS] = LO_UINT16(level);
+  alertAdvData[ADVCTRL_ALERT_LEVEL_POS + 1] = HI_UINT16(level);
+
+  GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(alertAdvData),
+                       alertAdvData);
+
+  if (burstState == ADVCTRL_BURST_ON)
+  {
+    // Connectable advertising must come back after ADVCTRL_BURST_DURATION
+    return;
+  }
+
+  savedIntMin = GAP_GetParamValue(TGAP_GEN_DISC_ADV_INT_MIN);
+  savedIntMax = GAP_GetParamValue(TGAP_GEN_DISC_ADV_INT_MAX);
+  advCtrl_setInterval(ADVCTRL_BURST_INTERVAL, ADVCTRL_BURST_INTERVAL);
+
+  if (gapState == GAPROLE_ADVERTISING)
+  {
+    // Non-connectable advertising starts once this has ended
+    burstState = ADVCTRL_BURST_STOPPING;
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+  }
+  else
+  {
+    advCtrl_burstOn();
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_burstOn
+ *
+ * @brief   Start non-connectable advertising for the burst.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_burstOn(void)
+{
+  uint8_t advertEnabled = FALSE;
+
+  // Connectable advertising must be off to enable non-connectable
+  GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                       &advertEnabled);
+
+  advertEnabled = TRUE;
+  GAPRole_SetParameter(GAPROLE_ADV_NONCONN_ENABLED, sizeof(uint8_t),
+                       &advertEnabled);
+
+  burstState = ADVCTRL_BURST_ON;
+  Util_restartClock(&burstClock, ADVCTRL_BURST_DURATION);
+}
+
+/*********************************************************************
+ * @fn      advCtrl_endBurst
+ *
+ * @brief   Stop the non-connectable advertising of the burst.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_endBurst(void)
+{
+  uint8_t advertEnabled = FALSE;
+  uint8_t advertising = ((gapState == GAPROLE_ADVERTISING_NONCONN) ||
+                         (gapState == GAPROLE_CONNECTED_ADV));
+
+  GAPRole_SetParameter(GAPROLE_ADV_NONCONN_ENABLED, sizeof(uint8_t),
+                       &advertEnabled);
+
+  burstState = ADVCTRL_BURST_RESTORING;
+  if (!advertising || burstInConn)
+  {
+    // No state change to wait for
+    advCtrl_burstDone();
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_burstDone
+ *
+ * @brief   Go back to the normal advertising after a burst.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_burstDone(void)
+{
+  uint8_t advertEnabled = TRUE;
+
+  advCtrl_setInterval(savedIntMin, savedIntMax);
+
+  burstState = ADVCTRL_BURST_IDLE;
+  advCtrl_publishSummary();
+
+  // While connected advertising resumes when the link ends
+  if (!connected)
+  {
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+  }
+
+  if (alertPending)
+  {
+    // An alert came in while the burst was ending
+    Event_post(advCtrlEvent, advCtrlUpdateEvent);
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_setInterval
+ *
+ * @brief   Set the advertising interval range.
+ *
+ * @param   intMin - shortest interval, in units of 625us
+ * @param   intMax - longest interval, in units of 625us
+ *
+ * @return  none
+ */
+static void advCtrl_setInterval(uint16_t intMin, uint16_t intMax)
+{
+  GAP_SetParamValue(TGAP_GEN_DISC_ADV_INT_MIN, intMin);
+  GAP_SetParamValue(TGAP_GEN_DISC_ADV_INT_MAX, intMax);
+}
+
+/*********************************************************************
+ * @fn      advCtrl_setStage
+ *
+ * @brief   Move to an advertising stage. Advertising in progress is
+ *          restarted to use the interval of the stage.
+ *
+ * @param   newStage - stage
+ *
+ * @return  none
+ */
+static void advCtrl_setStage(uint8_t newStage)
+{
+  uint8_t advertEnabled = FALSE;
+
+  advCtrl_countStageTime();
+
+  stage = newStage;
+  stageStarted = FALSE;
+  Util_stopClock(&stageClock);
+
+  if (burstState != ADVCTRL_BURST_IDLE)
+  {
+    // Applied when the burst restores the interval
+    savedIntMin = stageInterval[stage];
+    savedIntMax = stageInterval[stage];
+    return;
+  }
+
+  advCtrl_setInterval(stageInterval[stage], stageInterval[stage]);
+
+  if (gapState == GAPROLE_ADVERTISING)
+  {
+    // The interval is only read when advertising starts
+    restarting = TRUE;
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_linkLost
+ *
+ * @brief   Start advertising after a disconnect. A bonded peer that lost
+ *          the link gets directed advertising, anything else the normal
+ *          advertising.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_linkLost(void)
+{
+  uint8_t advertEnabled = TRUE;
+  uint8_t idAddr[B_ADDR_LEN];
+  uint8_t reason;
+
+  GAPRole_GetParameter(GAPROLE_CONN_TERM_REASON, &reason);
+
+  // Closed on purpose by either side
+  if ((reason != HCI_DISCONNECT_REMOTE_USER_TERM) &&
+      (reason != HCI_DISCONNECT_REMOTE_DEV_POWER_OFF) &&
+      (reason != HCI_ERROR_CODE_CONN_TERM_BY_LOCAL_HOST) &&
+      (GAPBondMgr_ResolveAddr(peerAddrType, peerAddr, idAddr) <
+       GAP_BONDINGS_MAX))
+  {
+    uint8_t eventType = GAP_ADTYPE_ADV_HDC_DIRECT_IND;
+
+    // Directed at the address the peer used on the link
+    reconnMode = ADVCTRL_RECONN_DIRECTED;
+    stats.numReconnects++;
+    GAPRole_SetParameter(GAPROLE_ADV_EVENT_TYPE, sizeof(uint8_t),
+                         &eventType);
+    GAPRole_SetParameter(GAPROLE_ADV_DIRECT_TYPE, sizeof(uint8_t),
+                         &peerAddrType);
+    GAPRole_SetParameter(GAPROLE_ADV_DIRECT_ADDR, B_ADDR_LEN, peerAddr);
+  }
+
+  GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                       &advertEnabled);
+}
+
+/*********************************************************************
+ * @fn      advCtrl_endReconnect
+ *
+ * @brief   Go back to advertising open to any central. Advertising in
+ *          progress is restarted to apply it.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_endReconnect(void)
+{
+  uint8_t advertEnabled = FALSE;
+  uint8_t eventType = GAP_ADTYPE_ADV_IND;
+  uint8_t filterPolicy = GAP_FILTER_POLICY_ALL;
+
+  if (reconnMode == ADVCTRL_RECONN_NONE)
+  {
+    return;
+  }
+
+  reconnMode = ADVCTRL_RECONN_NONE;
+  Util_stopClock(&reconnClock);
+  GAPRole_SetParameter(GAPROLE_ADV_EVENT_TYPE, sizeof(uint8_t), &eventType);
+  GAPRole_SetParameter(GAPROLE_ADV_FILTER_POLICY, sizeof(uint8_t),
+                       &filterPolicy);
+
+  if ((gapState == GAPROLE_ADVERTISING) && (burstState == ADVCTRL_BURST_IDLE))
+  {
+    restarting = TRUE;
+    GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                         &advertEnabled);
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_countStageTime
+ *
+ * @brief   Add the connectable advertising time since the last call to
+ *          the counter of the current stage.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_countStageTime(void)
+{
+  uint32_t ms = Timebase_msSince(stageTime);
+
+  stageTime = Timebase_now();
+
+  if (gapState == GAPROLE_ADVERTISING)
+  {
+    ms += stageMs[stage];
+    stats.stageTime[stage] += ms / 1000;
+    stageMs[stage] = ms % 1000;
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_markDirty
+ *
+ * @brief   Have the summary refreshed by the application task. The
+ *          sensor task may report values before the application task
+ *          initialized the advertising control.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void advCtrl_markDirty(void)
+{
+  dirty = TRUE;
+
+  if (advCtrlEvent)
+  {
+    Event_post(advCtrlEvent, advCtrlUpdateEvent);
+  }
+}
+
+/*********************************************************************
+ * @fn      advCtrl_findSummary
+ *
+ * @brief   Find the summary AD structure in the advertising data.
+ *
+ * @param   none
+ *
+ * @return  start of the AD structure, NULL if there is none
+ */
+static uint8_t *advCtrl_findSummary(void)
+{
+  uint8_t i;
+
+  for (i = 0; (i + 1 < advLen) && pAdv[i]; i += pAdv[i] + 1)
+  {
+    if ((pAdv[i] == ADVCTRL_SUMMARY_AD_LEN) &&
+        (i + ADVCTRL_SUMMARY_AD_LEN < advLen) &&
+        (pAdv[i + 1] == GAP_ADTYPE_MANUFACTURER_SPECIFIC) &&
+        (BUILD_UINT16(pAdv[i + 2], pAdv[i + 3]) == ADVCTRL_COMPANY_ID))
+    {
+      return &pAdv[i];
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+*********************************************************************/
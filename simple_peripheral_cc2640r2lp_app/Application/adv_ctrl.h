@@ -0,0 +1,281 @@
+/******************************************************************************
+
+ @file  adv_ctrl.h
+
+ @brief Advertising control.
+
+        The advertising data carries a manufacturer specific status summary
+        so a scanner gets the current state of the watch without
+        connecting (all values little endian):
+
+            [len][0xFF][company u16][version u8][level u16]
+            [lastAlertTime u32][battery u8]
+
+        level is the last amplitude sample, lastAlertTime the time in
+        seconds of the last time the doctor threshold was exceeded
+        (ADVCTRL_NO_ALERT if never) and battery the battery voltage in
+        1/32 V.
+
+        The summary is refreshed when it changes, at most once every
+        ADVCTRL_MIN_UPDATE_PERIOD ms. A level change smaller than
+        ADVCTRL_LEVEL_HYSTERESIS is not a change.
+
+        When the doctor threshold is exceeded the watch broadcasts the
+        alert in a burst of non-connectable advertisements, every
+        ADVCTRL_BURST_INTERVAL for ADVCTRL_BURST_DURATION ms, so a
+        caregiver device in range learns about it without keeping a
+        connection open:
+
+            [0x02][0x01][flags][len][0xFF][company u16]
+            [ADVCTRL_ALERT_VERSION][alertSeq u8][alertTime u32][level u16]
+
+        alertSeq is incremented by every alert so repeats can be told
+        apart. An alert during a burst replaces the one broadcast but
+        does not make the burst longer: connectable advertising, with the
+        summary, always resumes ADVCTRL_BURST_DURATION ms after the burst
+        started. While connected there is only a burst when the stack
+        can advertise in a connection (PLUS_BROADCASTER).
+
+        Connectable advertising steps down through three stages to save
+        power while nobody connects: ADVCTRL_STAGE_FAST after boot, a
+        button press (AdvCtrl_wake) or a disconnect, ADVCTRL_STAGE_SLOW
+        once the fast stage has lasted its duration, and
+        ADVCTRL_STAGE_BACKGROUND after the slow stage until the next wake.
+        The interval of a stage is set through TGAP_GEN_DISC_ADV_INT_MIN/MAX;
+        advertising is restarted to apply it.
+
+        After a link loss from a bonded peer the watch first advertises
+        directed at that peer (high duty cycle, 1.28 s at most), then
+        undirected with the whitelist of the bond manager for
+        ADVCTRL_WHITELIST_DURATION ms, so only bonded centrals can scan or
+        connect, before it is open to any central again. A wake ends this
+        reconnect mode.
+
+ *****************************************************************************/
+
+#ifndef ADV_CTRL_H
+#define ADV_CTRL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+#include "peripheral.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Company identifier of the summary (0xFFFF: not assigned, for tests and
+// internal use)
+#define ADVCTRL_COMPANY_ID            0xFFFF
+
+// Version of the summary layout
+#define ADVCTRL_SUMMARY_VERSION       0x01
+
+// Version of the alert layout, high bit set to tell it from a summary
+#define ADVCTRL_ALERT_VERSION         0x81
+
+// Length field of the summary AD structure
+#define ADVCTRL_SUMMARY_AD_LEN        0x0B
+
+// lastAlertTime before the first alert
+#define ADVCTRL_NO_ALERT              0xFFFFFFFF
+
+// Shortest time between two advertising data updates, in ms
+#define ADVCTRL_MIN_UPDATE_PERIOD     1000
+
+// Smallest level change that refreshes the summary
+#define ADVCTRL_LEVEL_HYSTERESIS      16
+
+// How often the battery voltage is measured, in ms
+#define ADVCTRL_BATTERY_PERIOD        60000
+
+// Alert burst advertising interval (units of 625us, 160=100ms, the shortest
+// allowed for non-connectable advertising)
+#define ADVCTRL_BURST_INTERVAL        160
+
+// Length of an alert burst, in ms
+#define ADVCTRL_BURST_DURATION        2000
+
+// Advertising stages
+#define ADVCTRL_STAGE_FAST            0
+#define ADVCTRL_STAGE_SLOW            1
+#define ADVCTRL_STAGE_BACKGROUND      2
+#define ADVCTRL_NUM_STAGES            3
+
+// Advertising interval of each stage (units of 625us, 160=100ms,
+// 1636=1022.5ms, 4000=2500ms)
+#define ADVCTRL_FAST_INTERVAL         160
+#define ADVCTRL_SLOW_INTERVAL         1636
+#define ADVCTRL_BACKGROUND_INTERVAL   4000
+
+// Whitelist advertising after the directed advertising of a reconnect, in ms
+#define ADVCTRL_WHITELIST_DURATION    30000
+
+// Default duration of the fast and slow stages, in ms. The background stage
+// lasts until the next wake.
+#define ADVCTRL_FAST_DURATION         30000
+#define ADVCTRL_SLOW_DURATION         300000
+
+// Summary AD structure to put in the advertising data
+#define ADVCTRL_SUMMARY_AD                                            \
+  ADVCTRL_SUMMARY_AD_LEN,                                             \
+  GAP_ADTYPE_MANUFACTURER_SPECIFIC,                                   \
+  LO_UINT16(ADVCTRL_COMPANY_ID),                                      \
+  HI_UINT16(ADVCTRL_COMPANY_ID),                                      \
+  ADVCTRL_SUMMARY_VERSION,                                            \
+  0x00, 0x00,               /* level */                               \
+  0xFF, 0xFF, 0xFF, 0xFF,   /* lastAlertTime */                       \
+  0x00                      /* battery */
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t stageTime[ADVCTRL_NUM_STAGES]; // Seconds of connectable
+                                          // advertising at each stage
+  uint32_t numWakes;      // Returns to the fast stage
+  uint32_t numReconnects; // Link losses answered with directed advertising
+} advCtrlStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      AdvCtrl_init
+ *
+ * @brief   Initialize the advertising control.
+ *
+ * @param   syncEvent   - event of the application task
+ * @param   updateEvent - event posted when AdvCtrl_processUpdate must run
+ * @param   pAdvData    - advertising data holding ADVCTRL_SUMMARY_AD, kept
+ *                        by the caller
+ * @param   advDataLen  - length of the advertising data
+ *
+ * @return  none
+ */
+extern void AdvCtrl_init(ICall_SyncHandle syncEvent, uint32_t updateEvent,
+                         uint8_t *pAdvData, uint8_t advDataLen);
+
+/*********************************************************************
+ * @fn      AdvCtrl_setLevel
+ *
+ * @brief   Report the current level. Can be called from any task.
+ *
+ * @param   level - amplitude sample
+ *
+ * @return  none
+ */
+extern void AdvCtrl_setLevel(uint16_t level);
+
+/*********************************************************************
+ * @fn      AdvCtrl_setAlert
+ *
+ * @brief   Report that the doctor threshold was exceeded, and have it
+ *          broadcast. Can be called from any task.
+ *
+ * @param   time - time of the alert in seconds
+ *
+ * @return  none
+ */
+extern void AdvCtrl_setAlert(uint32_t time);
+
+/*********************************************************************
+ * @fn      AdvCtrl_wake
+ *
+ * @brief   Go back to the fast advertising stage, for instance on a button
+ *          press. Can be called from any task or interrupt.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void AdvCtrl_wake(void);
+
+/*********************************************************************
+ * @fn      AdvCtrl_setStageDuration
+ *
+ * @brief   Set how long an advertising stage lasts before the next, slower
+ *          one. Applies from the next time the stage is entered.
+ *
+ * @param   stageId  - ADVCTRL_STAGE_FAST or ADVCTRL_STAGE_SLOW
+ * @param   duration - duration in ms, 0 to stay in the stage
+ *
+ * @return  SUCCESS or INVALIDPARAMETER
+ */
+extern bStatus_t AdvCtrl_setStageDuration(uint8_t stageId,
+                                          uint32_t duration);
+
+/*********************************************************************
+ * @fn      AdvCtrl_getStats
+ *
+ * @brief   Get the time spent at each advertising stage.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+extern void AdvCtrl_getStats(advCtrlStats_t *pStats);
+
+/*********************************************************************
+ * @fn      AdvCtrl_resetStats
+ *
+ * @brief   Clear the advertising stage counters.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void AdvCtrl_resetStats(void);
+
+/*********************************************************************
+ * @fn      AdvCtrl_processStateChange
+ *
+ * @brief   Follow the GAP Role state, to be called for every state change
+ *          before the application handles it.
+ *
+ * @param   newState - new state
+ *
+ * @return  none
+ */
+extern void AdvCtrl_processStateChange(gaprole_States_t newState);
+
+/*********************************************************************
+ * @fn      AdvCtrl_isBursting
+ *
+ * @brief   Check if the non-connectable advertising in progress is an
+ *          alert burst.
+ *
+ * @param   none
+ *
+ * @return  TRUE during an alert burst
+ */
+extern uint8_t AdvCtrl_isBursting(void);
+
+/*********************************************************************
+ * @fn      AdvCtrl_processUpdate
+ *
+ * @brief   Process the update event given to AdvCtrl_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void AdvCtrl_processUpdate(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ADV_CTRL_H */
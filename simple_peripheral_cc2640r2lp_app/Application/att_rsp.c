@@ -54,11 +54,21 @@
  /*********************************************************************
  * TYPEDEFS
  */
+
+// Pending responses of one connection, oldest at index head
+typedef struct
+{
+  gattMsgEvent_t *pRsp[ATT_RSP_QUEUE_DEPTH];
+  uint8_t head;
+  uint8_t count;
+} attRspQueue_t;
  
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
 
+static void attRsp_popAttRsp(attRspQueue_t *pQueue, uint8_t status);
+
 /*********************************************************************
  * EXTERNAL VARIABLES
  */
@@ -67,7 +77,13 @@
  * LOCAL VARIABLES
  */
 
- static gattMsgEvent_t * pAttRsp;
+ static attRspQueue_t attRspQueue[MAX_NUM_BLE_CONNS];
+
+// Responses given up on because a queue stayed full
+ static uint32_t numOverflows = 0;
+
+// Responses given up on because they could not be retried
+ static uint32_t numDropped = 0;
 
 /*********************************************************************
  * PUBLIC FUNCTIONS
@@ -76,60 +92,130 @@
 uint8_t attRsp_isAttRsp(gattMsgEvent_t * pMsg)
 {
   // See if GATT server was unable to transmit an ATT response
-  if (pMsg->hdr.status == blePending)
+  if ((pMsg->hdr.status == blePending) &&
+      (pMsg->connHandle < MAX_NUM_BLE_CONNS))
   {
+    attRspQueue_t *pQueue = &attRspQueue[pMsg->connHandle];
 
-      // First free any pending response
-      attRsp_freeAttRsp(FAILURE);
+    if (pQueue->count == ATT_RSP_QUEUE_DEPTH)
+    {
+      // Queue full, retry the pending responses in place to make room
+      attRsp_sendAttRsp(pMsg->connHandle);
+    }
 
-      // Hold on to the response message for retransmission
-      pAttRsp = pMsg;
+    if (pQueue->count == ATT_RSP_QUEUE_DEPTH)
+    {
+      // Still no buffer. Give up on the oldest response, as a single
+      // pending response slot would have, rather than on this one
+      attRsp_popAttRsp(pQueue, FAILURE);
+      numOverflows++;
+    }
 
-      // There's a message to retransmit
-      return (TRUE);
+    // Hold on to the response message for retransmission, behind the
+    // ones already waiting so the client gets them in order
+    pQueue->pRsp[(pQueue->head + pQueue->count) % ATT_RSP_QUEUE_DEPTH] = pMsg;
+    pQueue->count++;
+
+    // There's a message to retransmit
+    return (TRUE);
   }
   return (FALSE);
 }
 
 
-bStatus_t attRsp_sendAttRsp(void)
+bStatus_t attRsp_sendAttRsp(uint16_t connHandle)
 {
-  // See if there's a pending ATT Response to be transmitted
-  if (pAttRsp != NULL)
+  attRspQueue_t *pQueue;
+
+  if (connHandle >= MAX_NUM_BLE_CONNS)
   {
+    return(SUCCESS);
+  }
+
+  pQueue = &attRspQueue[connHandle];
+
+  // Send the pending ATT Responses in the order they were produced
+  while (pQueue->count)
+  {
+    gattMsgEvent_t *pAttRsp = pQueue->pRsp[pQueue->head];
     uint8_t status;
 
     // Try to retransmit ATT response till either we're successful or
     // the ATT Client times out (after 30s) and drops the connection.
     status = GATT_SendRsp(pAttRsp->connHandle, pAttRsp->method, &(pAttRsp->msg));
-    if ((status != blePending) && (status != MSG_BUFFER_NOT_AVAIL))
+    if ((status == blePending) || (status == MSG_BUFFER_NOT_AVAIL))
     {
-      // We're done with the response message
-      attRsp_freeAttRsp(status);
+      // Still no buffer, try again on the next connection event
+      return(status);
     }
-    return(status);
+
+    // We're done with the response message
+    attRsp_popAttRsp(pQueue, status);
   }
-  return(bleMemAllocError);
+
+  return(SUCCESS);
 }
 
 
-void attRsp_freeAttRsp(uint8_t status)
+void attRsp_freeAttRsp(uint16_t connHandle, uint8_t status)
 {
-  // See if there's a pending ATT response message
-  if (pAttRsp != NULL)
+  uint8_t i;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
   {
-    // See if the response was sent out successfully
-    if (status != SUCCESS)
+    if ((connHandle == i) || (connHandle == LINKDB_CONNHANDLE_ALL))
     {
-      // Free response payload
-      GATT_bm_free(&pAttRsp->msg, pAttRsp->method);
+      // Free every pending ATT response message of the connection
+      while (attRspQueue[i].count)
+      {
+        attRsp_popAttRsp(&attRspQueue[i], status);
+      }
     }
-    
-    // Free response message
-    ICall_freeMsg(pAttRsp);
-    
-    // Reset our globals
-    pAttRsp = NULL;
   }
 }
 
+void attRsp_dropAttRsp(uint16_t connHandle)
+{
+  if (connHandle >= MAX_NUM_BLE_CONNS)
+  {
+    return;
+  }
+
+  while (attRspQueue[connHandle].count)
+  {
+    attRsp_popAttRsp(&attRspQueue[connHandle], FAILURE);
+    numDropped++;
+  }
+}
+
+uint32_t attRsp_getNumOverflows(void)
+{
+  return(numOverflows);
+}
+
+uint32_t attRsp_getNumDropped(void)
+{
+  return(numDropped);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+static void attRsp_popAttRsp(attRspQueue_t *pQueue, uint8_t status)
+{
+  gattMsgEvent_t *pAttRsp = pQueue->pRsp[pQueue->head];
+
+  // See if the response was sent out successfully
+  if (status != SUCCESS)
+  {
+    // Free response payload
+    GATT_bm_free(&pAttRsp->msg, pAttRsp->method);
+  }
+
+  // Free response message
+  ICall_freeMsg(pAttRsp);
+
+  pQueue->head = (pQueue->head + 1) % ATT_RSP_QUEUE_DEPTH;
+  pQueue->count--;
+}
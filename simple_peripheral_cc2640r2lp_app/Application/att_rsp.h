@@ -0,0 +1,123 @@
+/******************************************************************************
+
+ @file  att_rsp.h
+
+ @brief This file contains att response utility functions commonly used by
+        BLE applications for CC26xx with TIRTOS.
+
+        ATT responses the GATT server could not send for lack of HCI
+        buffers (blePending) are held in a small queue per connection and
+        retried, in the order they were produced, on the connection events
+        of that connection. When a queue is full the pending responses
+        are retried at once; if the stack still has no buffer the oldest
+        one is given up on and counted (attRsp_getNumOverflows). When no
+        connection event can be registered to retry them, the application
+        gives up on the responses of the connection with attRsp_dropAttRsp.
+
+ *****************************************************************************/
+
+#ifndef ATT_RSP_H
+#define ATT_RSP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Pending ATT responses held per connection
+#define ATT_RSP_QUEUE_DEPTH           4
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      attRsp_isAttRsp
+ *
+ * @brief   Check if a GATT message is an ATT response the GATT server
+ *          could not send, and if so hold on to it for retransmission.
+ *
+ * @param   pMsg - GATT message
+ *
+ * @return  TRUE if the message is held and must not be freed by the
+ *          caller, FALSE otherwise
+ */
+extern uint8_t attRsp_isAttRsp(gattMsgEvent_t *pMsg);
+
+/*********************************************************************
+ * @fn      attRsp_sendAttRsp
+ *
+ * @brief   Retransmit the pending ATT responses of a connection, oldest
+ *          first, until the stack runs out of buffers again.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  SUCCESS when no response is left pending, blePending or
+ *          MSG_BUFFER_NOT_AVAIL otherwise
+ */
+extern bStatus_t attRsp_sendAttRsp(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      attRsp_freeAttRsp
+ *
+ * @brief   Free the pending ATT responses of a connection.
+ *
+ * @param   connHandle - connection handle, LINKDB_CONNHANDLE_ALL for all
+ * @param   status - SUCCESS if the payloads were sent, else they are freed
+ *
+ * @return  none
+ */
+extern void attRsp_freeAttRsp(uint16_t connHandle, uint8_t status);
+
+/*********************************************************************
+ * @fn      attRsp_dropAttRsp
+ *
+ * @brief   Give up on the pending ATT responses of a connection that
+ *          cannot be retried, and count them.
+ *
+ * @param   connHandle - connection handle
+ *
+ * @return  none
+ */
+extern void attRsp_dropAttRsp(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      attRsp_getNumOverflows
+ *
+ * @brief   Get the number of ATT responses given up on because the queue
+ *          of their connection stayed full.
+ *
+ * @param   none
+ *
+ * @return  number of responses given up on since boot
+ */
+extern uint32_t attRsp_getNumOverflows(void);
+
+/*********************************************************************
+ * @fn      attRsp_getNumDropped
+ *
+ * @brief   Get the number of ATT responses given up on by
+ *          attRsp_dropAttRsp.
+ *
+ * @param   none
+ *
+ * @return  number of responses given up on since boot
+ */
+extern uint32_t attRsp_getNumDropped(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* ATT_RSP_H */
@@ -0,0 +1,258 @@
+/******************************************************************************
+
+ @file  checkpoint.c
+
+ @brief Checkpoints of the hourly aggregation of the sensor task, kept in
+        SNV.
+
+        The state is handed from the sensor task to the application task
+        like the device configuration: the writer bumps pendingGen before
+        and after changing pendingState, the reader copies it again when
+        pendingGen was odd or moved during its copy.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stddef.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/sysbios/knl/Event.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "checkpoint.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// CRC-16/CCITT
+#define CHECKPOINT_CRC_INIT           0xFFFF
+#define CHECKPOINT_CRC_POLY           0x1021
+
+// Layout of ckptState_t, items of another layout are not restored
+#define CHECKPOINT_LAYOUT             1
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t    gen;      // Incremented by every write, selects the newest item
+  ckptState_t state;
+  uint16_t    crc;      // CRC of gen and state
+  uint16_t    layout;   // CHECKPOINT_LAYOUT
+} ckptRecord_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static ICall_SyncHandle ckptEvent;
+static uint32_t ckptSaveEvent;
+
+// Posted once the last checkpoint is loaded
+static Semaphore_Struct loadedSemStruct;
+static Semaphore_Handle loadedSem;
+
+// Last checkpoint found in SNV
+static ckptRecord_t lastRecord;
+static uint8_t lastValid = FALSE;
+
+// State handed over by the sensor task, odd pendingGen while it changes
+static ckptState_t pendingState;
+static volatile uint16_t pendingGen = 0;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint16_t checkpoint_crc(const ckptRecord_t *pRecord);
+static uint8_t checkpoint_read(uint8_t nvId, ckptRecord_t *pRecord);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Checkpoint_init
+ *
+ * @brief   Construct the lock the sensor task waits on until the last
+ *          checkpoint is loaded. Must be called before the BIOS is
+ *          started.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void Checkpoint_init(void)
+{
+  Semaphore_Params semParams;
+
+  Semaphore_Params_init(&semParams);
+  semParams.mode = Semaphore_Mode_BINARY;
+  Semaphore_construct(&loadedSemStruct, 0, &semParams);
+  loadedSem = Semaphore_handle(&loadedSemStruct);
+}
+
+/*********************************************************************
+ * @fn      Checkpoint_load
+ *
+ * @brief   Load the last checkpoint from SNV and release the sensor task.
+ *          To be called by the application task once it is registered
+ *          with ICall.
+ *
+ * @param   syncEvent - event of the application task
+ * @param   saveEvent - event posted when Checkpoint_process must run
+ *
+ * @return  none
+ */
+void Checkpoint_load(ICall_SyncHandle syncEvent, uint32_t saveEvent)
+{
+  ckptRecord_t record;
+
+  ckptEvent = syncEvent;
+  ckptSaveEvent = saveEvent;
+
+  if (checkpoint_read(CHECKPOINT_NV_ID_0, &record))
+  {
+    lastRecord = record;
+    lastValid = TRUE;
+  }
+
+  if (checkpoint_read(CHECKPOINT_NV_ID_1, &record) &&
+      (!lastValid || (int32_t)(record.gen - lastRecord.gen) > 0))
+  {
+    lastRecord = record;
+    lastValid = TRUE;
+  }
+
+  Semaphore_post(loadedSem);
+}
+
+/*********************************************************************
+ * @fn      Checkpoint_restore
+ *
+ * @brief   Get the state of the last checkpoint. Called by the sensor
+ *          task, waits until Checkpoint_load has run.
+ *
+ * @param   pState - filled in with the state
+ *
+ * @return  TRUE if a checkpoint was found, FALSE if pState was not changed
+ */
+uint8_t Checkpoint_restore(ckptState_t *pState)
+{
+  Semaphore_pend(loadedSem, BIOS_WAIT_FOREVER);
+
+  if (lastValid)
+  {
+    *pState = lastRecord.state;
+  }
+
+  return lastValid;
+}
+
+/*********************************************************************
+ * @fn      Checkpoint_save
+ *
+ * @brief   Hand the state over to be written. Called by the sensor task.
+ *
+ * @param   pState - state to write
+ *
+ * @return  none
+ */
+void Checkpoint_save(const ckptState_t *pState)
+{
+  pendingGen++;
+  pendingState = *pState;
+  pendingGen++;
+
+  Event_post(ckptEvent, ckptSaveEvent);
+}
+
+/*********************************************************************
+ * @fn      Checkpoint_process
+ *
+ * @brief   Write the state handed over by Checkpoint_save. To be called by
+ *          the application task on the event given to Checkpoint_load.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void Checkpoint_process(void)
+{
+  uint16_t gen;
+
+  do
+  {
+    gen = pendingGen;
+    lastRecord.state = pendingState;
+  } while ((gen & 1) || (gen != pendingGen));
+
+  lastRecord.gen++;
+  lastRecord.layout = CHECKPOINT_LAYOUT;
+  lastRecord.crc = checkpoint_crc(&lastRecord);
+
+  // Even generations in item 0, odd ones in item 1: the item overwritten
+  // is never the newest one
+  osal_snv_write((lastRecord.gen & 1) ? CHECKPOINT_NV_ID_1 : CHECKPOINT_NV_ID_0,
+                 sizeof(ckptRecord_t), &lastRecord);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      checkpoint_crc
+ *
+ * @brief   CRC of the generation and state of a record.
+ *
+ * @param   pRecord - record
+ *
+ * @return  CRC
+ */
+static uint16_t checkpoint_crc(const ckptRecord_t *pRecord)
+{
+  const uint8_t *pData = (const uint8_t *)pRecord;
+  uint16_t len = offsetof(ckptRecord_t, crc);
+  uint16_t crc = CHECKPOINT_CRC_INIT;
+  uint8_t bit;
+
+  while (len--)
+  {
+    crc ^= (uint16_t)*pData++ << 8;
+    for (bit = 0; bit < 8; bit++)
+    {
+      crc = (crc & 0x8000) ? (crc << 1) ^ CHECKPOINT_CRC_POLY : (crc << 1);
+    }
+  }
+
+  return crc;
+}
+
+/*********************************************************************
+ * @fn      checkpoint_read
+ *
+ * @brief   Read a record from SNV and check its CRC and layout.
+ *
+ * @param   nvId    - SNV item
+ * @param   pRecord - filled in with the record
+ *
+ * @return  TRUE if the record is valid
+ */
+static uint8_t checkpoint_read(uint8_t nvId, ckptRecord_t *pRecord)
+{
+  return ((osal_snv_read(nvId, sizeof(ckptRecord_t), pRecord) == SUCCESS) &&
+          (pRecord->crc == checkpoint_crc(pRecord)) &&
+          (pRecord->layout == CHECKPOINT_LAYOUT));
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,133 @@
+/******************************************************************************
+
+ @file  checkpoint.h
+
+ @brief Checkpoints of the hourly aggregation of the sensor task, so a reset
+        or a brownout does not lose the hour in progress.
+
+        Once every CHECKPOINT_PERIOD ms, when something changed, the sensor
+        task hands its state over and the application task writes it to
+        SNV. Two SNV items are written in turn, each with a generation
+        number and a CRC; a write cut short by a reset leaves the other
+        item intact. At boot the valid item with the highest generation is
+        given back to the sensor task before it takes its first sample.
+
+        The state holds the wall clock start of the hourly window. When the
+        hour is over by the time it is restored, the sensor task writes it
+        on its own rather than adding the new hour to it.
+
+ *****************************************************************************/
+
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include <icall.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// SNV items written in turn
+#define CHECKPOINT_NV_ID_0            (BLE_NVID_CUST_START + 3)
+#define CHECKPOINT_NV_ID_1            (BLE_NVID_CUST_START + 4)
+
+// Time between two checkpoints, in ms
+#define CHECKPOINT_PERIOD             60000
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t hourStart;   // Start of the hourly window, seconds of the wall clock
+  uint32_t pitchSum;    // Sum of the pitch samples of the window
+  uint32_t pitchCount;  // Number of pitch samples of the window
+  uint16_t pitchAvg;    // Average, min and max pitch of the window
+  uint16_t pitchMin;
+  uint16_t pitchMax;
+  uint8_t  first;       // TRUE until the first pitch sample of the window
+  uint8_t  reserved;
+} ckptState_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Checkpoint_init
+ *
+ * @brief   Construct the lock the sensor task waits on until the last
+ *          checkpoint is loaded. Must be called before the BIOS is
+ *          started.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void Checkpoint_init(void);
+
+/*********************************************************************
+ * @fn      Checkpoint_load
+ *
+ * @brief   Load the last checkpoint from SNV and release the sensor task.
+ *          To be called by the application task once it is registered
+ *          with ICall.
+ *
+ * @param   syncEvent - event of the application task
+ * @param   saveEvent - event posted when Checkpoint_process must run
+ *
+ * @return  none
+ */
+extern void Checkpoint_load(ICall_SyncHandle syncEvent, uint32_t saveEvent);
+
+/*********************************************************************
+ * @fn      Checkpoint_restore
+ *
+ * @brief   Get the state of the last checkpoint. Called by the sensor
+ *          task, waits until Checkpoint_load has run.
+ *
+ * @param   pState - filled in with the state
+ *
+ * @return  TRUE if a checkpoint was found, FALSE if pState was not changed
+ */
+extern uint8_t Checkpoint_restore(ckptState_t *pState);
+
+/*********************************************************************
+ * @fn      Checkpoint_save
+ *
+ * @brief   Hand the state over to be written. Called by the sensor task.
+ *
+ * @param   pState - state to write
+ *
+ * @return  none
+ */
+extern void Checkpoint_save(const ckptState_t *pState);
+
+/*********************************************************************
+ * @fn      Checkpoint_process
+ *
+ * @brief   Write the state handed over by Checkpoint_save. To be called by
+ *          the application task on the event given to Checkpoint_load.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void Checkpoint_process(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CHECKPOINT_H */
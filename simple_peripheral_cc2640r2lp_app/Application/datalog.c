@@ -0,0 +1,876 @@
+/******************************************************************************
+
+ @file  datalog.c
+
+ @brief Sequence numbered record log kept in the external flash (SPIFFS).
+
+        The sensor task only puts records in queueRecs, without a lock. The
+        storage task numbers and writes them and the BLE task reads the
+        log, so every access to the file system and to the RAM tail goes
+        through logLock; both run below the sensor task, which never waits
+        on the lock or on the flash. Records queued before the file system
+        is mounted only get their sequence numbers once the head of the log
+        is known.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <ti/sysbios/BIOS.h>
+#include <ti/sysbios/knl/Semaphore.h>
+#include <ti/display/Display.h>
+
+#include <bcomdef.h>
+
+#include "datalog.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Prefix of the SPIFFS file names used by the log
+#define DATALOG_FILE_PREFIX           'L'
+
+// Size of a SPIFFS file name including prefix and terminator
+#define DATALOG_FILE_NAME_LEN         12
+
+// Size in bytes of a complete log file
+#define DATALOG_FILE_SIZE             (DATALOG_RECORDS_PER_FILE * sizeof(datalogRecord_t))
+
+// Files of the old per-type layout, named after their page index: "0" to
+// "2500" hold amplitude pages, "2501" to "2525" one pitch hour each
+#define DATALOG_LEGACY_AMPLITUDE_PAGES 2501
+#define DATALOG_LEGACY_PITCH_PAGES    25
+#define DATALOG_LEGACY_SAMPLES        44 // Amplitudes of an amplitude page
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Amplitude page of the old layout
+typedef struct
+{
+  uint16_t amplitude[DATALOG_LEGACY_SAMPLES];
+  uint16_t timeStamp[DATALOG_LEGACY_SAMPLES]; // Seconds since boot, 16 bit
+} datalogLegacyAmplitude_t;
+
+// Pitch page of the old layout
+typedef struct
+{
+  uint16_t averagePitch;
+  uint16_t minimumPitch;
+  uint16_t maximumPitch;
+  uint16_t doctorThreshold;
+  uint16_t timeStamp;                         // Seconds since boot, 16 bit
+} datalogLegacyPitch_t;
+
+/*********************************************************************
+ * EXTERNAL VARIABLES
+ */
+extern Display_Handle dispHandle;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Serializes the storage task (writer) and the BLE task (reader)
+static Semaphore_Struct logLockStruct;
+static Semaphore_Handle logLock;
+
+// Posted by the sensor task when records are queued or a sync is due
+static Semaphore_Struct storeSemStruct;
+static Semaphore_Handle storeSem;
+
+// File system holding the log, NULL until mounted or when degraded
+static spiffs *pLogFs = NULL;
+
+// DATALOG_STORAGE_*
+static volatile uint8_t storageState = DATALOG_STORAGE_MOUNTING;
+
+// Records appended by the sensor task and not yet taken by the storage
+// task, the sensor task moves queueHead and the storage task queueTail
+static datalogRecord_t queueRecs[DATALOG_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueTail = 0;
+static uint16_t numDropped = 0;
+
+// Datalog_sync was called since the last write of the tail file
+static volatile bool syncDue = false;
+
+// Records of the file currently being filled
+static datalogRecord_t tailRecs[DATALOG_RECORDS_PER_FILE];
+
+// Sequence number of the next record
+static uint32_t headSeq = 0;
+
+// Sequence number of the oldest record in the log
+static uint32_t oldestSeq = 0;
+
+// Head of the log at the last write of the tail file, records from here
+// on are only in RAM
+static uint32_t syncedSeq = 0;
+
+// File kept open between reads, a transfer reads one file in order
+static spiffs_file readFd = -1;
+static uint32_t readFileSeq = DATALOG_INVALID_SEQ;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void datalog_fileName(uint32_t fileSeq, char *pName);
+static bool datalog_parseFileName(const uint8_t *pName, uint32_t *pFileSeq);
+static bool datalog_parseLegacyName(const uint8_t *pName, uint32_t *pPage);
+static void datalog_legacyName(uint32_t page, char *pName);
+static void datalog_migrateLegacy(uint16_t numFiles);
+static void datalog_migratePage(uint32_t page);
+static void datalog_closeReadFile(void);
+static void datalog_takeQueue(void);
+static void datalog_syncTail(void);
+static void datalog_flushTail(uint32_t fileSeq);
+static uint32_t datalog_appendRecord(const datalogRecord_t *pRecord);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Datalog_init
+ *
+ * @brief   Construct the log lock and the semaphore of the storage task.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void Datalog_init(void)
+{
+  Semaphore_Params semParams;
+
+  Semaphore_Params_init(&semParams);
+  semParams.mode = Semaphore_Mode_BINARY;
+  Semaphore_construct(&logLockStruct, 1, &semParams);
+  logLock = Semaphore_handle(&logLockStruct);
+
+  Semaphore_construct(&storeSemStruct, 0, &semParams);
+  storeSem = Semaphore_handle(&storeSemStruct);
+}
+
+/*********************************************************************
+ * @fn      Datalog_mount
+ *
+ * @brief   Attach the log to a mounted file system. The oldest file and
+ *          the newest file give the range of sequence numbers; a newest
+ *          file that is not complete is loaded back into the RAM tail.
+ *          Files written by the old per-type layout are then moved into
+ *          the log, page by page, and removed once their records are in
+ *          flash.
+ *
+ * @param   pFs - mounted SPIFFS instance
+ *
+ * @return  none
+ */
+void Datalog_mount(spiffs *pFs)
+{
+  spiffs_DIR dir;
+  struct spiffs_dirent entry;
+  struct spiffs_dirent *pEntry;
+  uint32_t fileSeq;
+  uint32_t minFileSeq = DATALOG_INVALID_SEQ;
+  uint32_t maxFileSeq = 0;
+  uint32_t maxFileSize = 0;
+  uint32_t page;
+  uint16_t legacyFiles = 0;
+
+  Semaphore_pend(logLock, BIOS_WAIT_FOREVER);
+
+  pLogFs = pFs;
+
+  if ((pFs != NULL) && (SPIFFS_opendir(pFs, "/", &dir) != NULL))
+  {
+    while ((pEntry = SPIFFS_readdir(&dir, &entry)) != NULL)
+    {
+      if (datalog_parseFileName(pEntry->name, &fileSeq))
+      {
+        if ((minFileSeq == DATALOG_INVALID_SEQ) || (fileSeq < minFileSeq))
+        {
+          minFileSeq = fileSeq;
+        }
+        if (fileSeq >= maxFileSeq)
+        {
+          maxFileSeq = fileSeq;
+          maxFileSize = pEntry->size;
+        }
+      }
+      else if (datalog_parseLegacyName(pEntry->name, &page))
+      {
+        // Moved into the log once mounting is done
+        legacyFiles++;
+      }
+    }
+    SPIFFS_closedir(&dir);
+  }
+
+  if (minFileSeq != DATALOG_INVALID_SEQ)
+  {
+    oldestSeq = minFileSeq * DATALOG_RECORDS_PER_FILE;
+
+    if (maxFileSize >= DATALOG_FILE_SIZE)
+    {
+      headSeq = (maxFileSeq + 1) * DATALOG_RECORDS_PER_FILE;
+    }
+    else
+    {
+      // The newest file was cut short, continue filling it from RAM.
+      char name[DATALOG_FILE_NAME_LEN];
+      spiffs_file fd;
+      int32_t bytes = 0;
+
+      datalog_fileName(maxFileSeq, name);
+      fd = SPIFFS_open(pFs, name, SPIFFS_RDONLY, 0);
+      if (fd >= 0)
+      {
+        bytes = SPIFFS_read(pFs, fd, tailRecs, maxFileSize);
+        SPIFFS_close(pFs, fd);
+      }
+
+      headSeq = maxFileSeq * DATALOG_RECORDS_PER_FILE;
+      if (bytes > 0)
+      {
+        headSeq += bytes / sizeof(datalogRecord_t);
+      }
+    }
+  }
+
+  syncedSeq = headSeq;
+  storageState = (pFs != NULL) ? DATALOG_STORAGE_READY : DATALOG_STORAGE_DEGRADED;
+
+  // Records of the sensor task while mounting follow what was found
+  datalog_takeQueue();
+
+  Display_printf(dispHandle, 0, 0, "Log records %d..%d, %d lost while mounting",
+                 oldestSeq, headSeq, numDropped);
+
+  Semaphore_post(logLock);
+
+  if (legacyFiles)
+  {
+    datalog_migrateLegacy(legacyFiles);
+  }
+}
+
+/*********************************************************************
+ * @fn      Datalog_append
+ *
+ * @brief   Queue a record for the storage task. Called by the sensor
+ *          task only, never blocks.
+ *
+ * @param   type      - DATALOG_TYPE_*
+ * @param   timeStamp - time of the record in seconds
+ * @param   pValues   - record values, numValues entries
+ * @param   numValues - number of values (at most DATALOG_NUM_VALUES)
+ *
+ * @return  none
+ */
+void Datalog_append(uint8_t type, uint32_t timeStamp,
+                    const uint16_t *pValues, uint8_t numValues)
+{
+  uint8_t head = queueHead;
+  datalogRecord_t *pRec;
+
+  // The storage task is behind, or still mounting
+  if ((uint8_t)(head - queueTail) >= DATALOG_QUEUE_SIZE)
+  {
+    numDropped++;
+    return;
+  }
+
+  pRec = &queueRecs[head % DATALOG_QUEUE_SIZE];
+  memset(pRec, 0, sizeof(datalogRecord_t));
+  pRec->timeStamp = timeStamp;
+  pRec->type = type;
+  memcpy(pRec->value, pValues,
+         MIN(numValues, DATALOG_NUM_VALUES) * sizeof(uint16_t));
+
+  // The record is complete before the storage task can see it
+  queueHead = head + 1;
+
+  Semaphore_post(storeSem);
+}
+
+/*********************************************************************
+ * @fn      Datalog_sync
+ *
+ * @brief   Have the storage task write the records of the file being
+ *          filled that are only in RAM, after the records queued before.
+ *          Mounting finds the file cut short and continues it. Called by
+ *          the sensor task, never blocks.
+ *
+ * @return  none
+ */
+void Datalog_sync(void)
+{
+  syncDue = true;
+
+  Semaphore_post(storeSem);
+}
+
+/*********************************************************************
+ * @fn      Datalog_process
+ *
+ * @brief   Wait for records queued by Datalog_append or a Datalog_sync,
+ *          then number and write them. Run in a loop by the storage task
+ *          once Datalog_mount has returned.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void Datalog_process(void)
+{
+  Semaphore_pend(storeSem, BIOS_WAIT_FOREVER);
+
+  Semaphore_pend(logLock, BIOS_WAIT_FOREVER);
+
+  datalog_takeQueue();
+
+  if (syncDue)
+  {
+    syncDue = false;
+    datalog_syncTail();
+  }
+
+  Semaphore_post(logLock);
+}
+
+/*********************************************************************
+ * @fn      Datalog_read
+ *
+ * @brief   Read consecutive records starting at a sequence number.
+ *
+ * @param   seq      - sequence number of the first record
+ * @param   pRecs    - buffer for the records
+ * @param   maxCount - size of pRecs in records
+ *
+ * @return  number of records read, 0 if seq is not in the log
+ */
+uint8_t Datalog_read(uint32_t seq, datalogRecord_t *pRecs, uint8_t maxCount)
+{
+  uint32_t tailSeq;
+  uint8_t count = 0;
+
+  Semaphore_pend(logLock, BIOS_WAIT_FOREVER);
+
+  tailSeq = headSeq - (headSeq % DATALOG_RECORDS_PER_FILE);
+
+  if ((seq < oldestSeq) || (seq >= syncedSeq) || (maxCount == 0))
+  {
+    count = 0;
+  }
+  else if (seq >= tailSeq)
+  {
+    // Still in RAM, and in flash up to syncedSeq
+    count = MIN(maxCount, syncedSeq - seq);
+    memcpy(pRecs, &tailRecs[seq - tailSeq], count * sizeof(datalogRecord_t));
+  }
+  else if (pLogFs != NULL)
+  {
+    uint32_t fileSeq = seq / DATALOG_RECORDS_PER_FILE;
+    uint8_t index = seq % DATALOG_RECORDS_PER_FILE;
+    int32_t bytes;
+
+    count = MIN(maxCount, DATALOG_RECORDS_PER_FILE - index);
+
+    if (readFileSeq != fileSeq)
+    {
+      char name[DATALOG_FILE_NAME_LEN];
+
+      datalog_closeReadFile();
+      datalog_fileName(fileSeq, name);
+      readFd = SPIFFS_open(pLogFs, name, SPIFFS_RDONLY, 0);
+      if (readFd >= 0)
+      {
+        readFileSeq = fileSeq;
+      }
+    }
+
+    if ((readFd >= 0) &&
+        (SPIFFS_lseek(pLogFs, readFd, index * sizeof(datalogRecord_t),
+                      SPIFFS_SEEK_SET) >= 0))
+    {
+      bytes = SPIFFS_read(pLogFs, readFd, pRecs,
+                          count * sizeof(datalogRecord_t));
+      count = (bytes > 0) ? (bytes / sizeof(datalogRecord_t)) : 0;
+    }
+    else
+    {
+      count = 0;
+    }
+
+    // A file that does not hold what its name says is not used
+    if ((count > 0) && (pRecs[0].seq != seq))
+    {
+      count = 0;
+    }
+  }
+
+  Semaphore_post(logLock);
+
+  return (count);
+}
+
+/*********************************************************************
+ * @fn      Datalog_getHeadSeq
+ *
+ * @brief   Sequence number the next appended record will get.
+ *
+ * @return  head sequence number
+ */
+uint32_t Datalog_getHeadSeq(void)
+{
+  return (headSeq);
+}
+
+/*********************************************************************
+ * @fn      Datalog_getSyncedSeq
+ *
+ * @brief   Sequence number after the last record written to flash. The
+ *          records from here to the head are only in RAM and not read.
+ *
+ * @return  synced head sequence number
+ */
+uint32_t Datalog_getSyncedSeq(void)
+{
+  return (syncedSeq);
+}
+
+/*********************************************************************
+ * @fn      Datalog_getOldestSeq
+ *
+ * @brief   Sequence number of the oldest record still in the log.
+ *
+ * @return  oldest sequence number
+ */
+uint32_t Datalog_getOldestSeq(void)
+{
+  return (oldestSeq);
+}
+
+/*********************************************************************
+ * @fn      Datalog_getStorageState
+ *
+ * @brief   State of the file system holding the log.
+ *
+ * @return  DATALOG_STORAGE_*
+ */
+uint8_t Datalog_getStorageState(void)
+{
+  return (storageState);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      datalog_fileName
+ *
+ * @brief   Build the SPIFFS file name of a log file.
+ *
+ * @param   fileSeq - file sequence number
+ * @param   pName   - buffer of DATALOG_FILE_NAME_LEN bytes
+ *
+ * @return  none
+ */
+static void datalog_fileName(uint32_t fileSeq, char *pName)
+{
+  char digits[10];
+  uint8_t numDigits = 0;
+
+  do
+  {
+    digits[numDigits++] = '0' + (fileSeq % 10);
+    fileSeq /= 10;
+  } while (fileSeq);
+
+  *pName++ = DATALOG_FILE_PREFIX;
+  while (numDigits)
+  {
+    *pName++ = digits[--numDigits];
+  }
+  *pName = '\0';
+}
+
+/*********************************************************************
+ * @fn      datalog_parseFileName
+ *
+ * @brief   Get the file sequence number from a SPIFFS file name.
+ *
+ * @param   pName    - file name
+ * @param   pFileSeq - file sequence number
+ *
+ * @return  TRUE if the name belongs to a log file
+ */
+static bool datalog_parseFileName(const uint8_t *pName, uint32_t *pFileSeq)
+{
+  uint32_t fileSeq = 0;
+
+  if ((*pName++ != DATALOG_FILE_PREFIX) || (*pName == '\0'))
+  {
+    return (FALSE);
+  }
+
+  while (*pName)
+  {
+    if ((*pName < '0') || (*pName > '9'))
+    {
+      return (FALSE);
+    }
+    fileSeq = (fileSeq * 10) + (*pName++ - '0');
+  }
+
+  *pFileSeq = fileSeq;
+
+  return (TRUE);
+}
+
+/*********************************************************************
+ * @fn      datalog_legacyName
+ *
+ * @brief   Build the name of a file of the old per-type layout.
+ *
+ * @param   page  - page index
+ * @param   pName - buffer of DATALOG_FILE_NAME_LEN bytes
+ *
+ * @return  none
+ */
+static void datalog_legacyName(uint32_t page, char *pName)
+{
+  // A log file name without the prefix
+  datalog_fileName(page, pName);
+  memmove(pName, pName + 1, strlen(pName));
+}
+
+/*********************************************************************
+ * @fn      datalog_parseLegacyName
+ *
+ * @brief   Get the page index from the name of a file of the old per-type
+ *          layout.
+ *
+ * @param   pName - file name
+ * @param   pPage - page index
+ *
+ * @return  TRUE if the name belongs to an old amplitude or pitch page
+ */
+static bool datalog_parseLegacyName(const uint8_t *pName, uint32_t *pPage)
+{
+  uint32_t page = 0;
+
+  if ((*pName == '\0') ||
+      (strlen((const char *)pName) >= DATALOG_FILE_NAME_LEN))
+  {
+    return (FALSE);
+  }
+
+  while (*pName)
+  {
+    if ((*pName < '0') || (*pName > '9'))
+    {
+      return (FALSE);
+    }
+    page = (page * 10) + (*pName++ - '0');
+  }
+
+  if (page >= DATALOG_LEGACY_AMPLITUDE_PAGES + DATALOG_LEGACY_PITCH_PAGES)
+  {
+    return (FALSE);
+  }
+
+  *pPage = page;
+
+  return (TRUE);
+}
+
+/*********************************************************************
+ * @fn      datalog_migrateLegacy
+ *
+ * @brief   Move the pages of the old per-type layout into the log. The
+ *          lock is taken page by page, so the sensor task keeps appending
+ *          in between. Called by the storage task after mounting.
+ *
+ * @param   numFiles - number of old pages found when mounting
+ *
+ * @return  none
+ */
+static void datalog_migrateLegacy(uint16_t numFiles)
+{
+  uint32_t page;
+  uint16_t numMigrated = 0;
+  char name[DATALOG_FILE_NAME_LEN];
+  spiffs_stat stat;
+
+  for (page = 0;
+       (page < DATALOG_LEGACY_AMPLITUDE_PAGES + DATALOG_LEGACY_PITCH_PAGES) &&
+       (numMigrated < numFiles);
+       page++)
+  {
+    datalog_legacyName(page, name);
+
+    Semaphore_pend(logLock, BIOS_WAIT_FOREVER);
+    if (SPIFFS_stat(pLogFs, name, &stat) != SPIFFS_OK)
+    {
+      Semaphore_post(logLock);
+      continue;
+    }
+    datalog_migratePage(page);
+    Semaphore_post(logLock);
+
+    // The page is only removed once its records are in flash, the
+    // records of the sensor task go in between the pages
+    Semaphore_pend(logLock, BIOS_WAIT_FOREVER);
+    datalog_takeQueue();
+    datalog_syncTail();
+    SPIFFS_remove(pLogFs, name);
+    Semaphore_post(logLock);
+
+    numMigrated++;
+  }
+
+  Display_printf(dispHandle, 0, 0, "Moved %d legacy log files into the log",
+                 numMigrated);
+}
+
+/*********************************************************************
+ * @fn      datalog_migratePage
+ *
+ * @brief   Append the records of a page of the old layout to the log.
+ *          Called with logLock held.
+ *
+ * @param   page - page index, the name of the file
+ *
+ * @return  none
+ */
+static void datalog_migratePage(uint32_t page)
+{
+  char name[DATALOG_FILE_NAME_LEN];
+  datalogLegacyAmplitude_t amplitudePage;
+  datalogLegacyPitch_t pitchPage;
+  datalogRecord_t rec;
+  spiffs_file fd;
+  int32_t bytes = -1;
+  uint8_t i;
+
+  datalog_legacyName(page, name);
+  fd = SPIFFS_open(pLogFs, name, SPIFFS_RDONLY, 0);
+  if (fd < 0)
+  {
+    return;
+  }
+
+  memset(&rec, 0, sizeof(datalogRecord_t));
+
+  if (page < DATALOG_LEGACY_AMPLITUDE_PAGES)
+  {
+    // Only complete pages were written
+    bytes = SPIFFS_read(pLogFs, fd, &amplitudePage, sizeof(amplitudePage));
+    if (bytes == sizeof(amplitudePage))
+    {
+      rec.type = DATALOG_TYPE_AMPLITUDE;
+      for (i = 0; i < DATALOG_LEGACY_SAMPLES; i++)
+      {
+        rec.timeStamp = amplitudePage.timeStamp[i];
+        rec.value[0] = amplitudePage.amplitude[i];
+        datalog_appendRecord(&rec);
+      }
+    }
+  }
+  else
+  {
+    bytes = SPIFFS_read(pLogFs, fd, &pitchPage, sizeof(pitchPage));
+    if (bytes == sizeof(pitchPage))
+    {
+      // The old layout only wrote hours with speech and kept no count
+      rec.type = DATALOG_TYPE_PITCH_HOUR;
+      rec.timeStamp = pitchPage.timeStamp;
+      rec.value[0] = pitchPage.averagePitch;
+      rec.value[1] = pitchPage.minimumPitch;
+      rec.value[2] = pitchPage.maximumPitch;
+      rec.value[3] = pitchPage.doctorThreshold;
+      rec.value[4] = 1;
+      datalog_appendRecord(&rec);
+    }
+  }
+
+  SPIFFS_close(pLogFs, fd);
+}
+
+/*********************************************************************
+ * @fn      datalog_closeReadFile
+ *
+ * @brief   Close the file kept open for reads.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void datalog_closeReadFile(void)
+{
+  if (readFd >= 0)
+  {
+    SPIFFS_close(pLogFs, readFd);
+  }
+
+  readFd = -1;
+  readFileSeq = DATALOG_INVALID_SEQ;
+}
+
+/*********************************************************************
+ * @fn      datalog_takeQueue
+ *
+ * @brief   Append the records queued by the sensor task to the log.
+ *          Called by the storage task with logLock held.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void datalog_takeQueue(void)
+{
+  while (queueTail != queueHead)
+  {
+    datalog_appendRecord(&queueRecs[queueTail % DATALOG_QUEUE_SIZE]);
+
+    // The slot is free once the record is copied
+    queueTail++;
+  }
+}
+
+/*********************************************************************
+ * @fn      datalog_syncTail
+ *
+ * @brief   Write the records of the file being filled that are only in
+ *          RAM. Called by the storage task with logLock held.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void datalog_syncTail(void)
+{
+  char name[DATALOG_FILE_NAME_LEN];
+  spiffs_file fd;
+  uint32_t count;
+
+  // A complete file was written by datalog_appendRecord
+  count = headSeq % DATALOG_RECORDS_PER_FILE;
+
+  if ((pLogFs != NULL) && (count != 0) && (headSeq != syncedSeq))
+  {
+    datalog_fileName(headSeq / DATALOG_RECORDS_PER_FILE, name);
+    fd = SPIFFS_open(pLogFs, name, SPIFFS_CREAT | SPIFFS_TRUNC | SPIFFS_RDWR, 0);
+    if (fd >= 0)
+    {
+      if (SPIFFS_write(pLogFs, fd, tailRecs, count * sizeof(datalogRecord_t)) ==
+          (int32_t)(count * sizeof(datalogRecord_t)))
+      {
+        syncedSeq = headSeq;
+      }
+      SPIFFS_close(pLogFs, fd);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      datalog_appendRecord
+ *
+ * @brief   Give a record the next sequence number and add it to the RAM
+ *          tail. Called with logLock held.
+ *
+ * @param   pRecord - record, the sequence number is filled in
+ *
+ * @return  sequence number given to the record
+ */
+static uint32_t datalog_appendRecord(const datalogRecord_t *pRecord)
+{
+  uint32_t seq = headSeq;
+
+  tailRecs[seq % DATALOG_RECORDS_PER_FILE] = *pRecord;
+  tailRecs[seq % DATALOG_RECORDS_PER_FILE].seq = seq;
+
+  headSeq++;
+
+  // Write the tail out as soon as it holds a complete file
+  if ((headSeq % DATALOG_RECORDS_PER_FILE) == 0)
+  {
+    datalog_flushTail(seq / DATALOG_RECORDS_PER_FILE);
+  }
+
+  return (seq);
+}
+
+/*********************************************************************
+ * @fn      datalog_flushTail
+ *
+ * @brief   Write the complete RAM tail to its file and drop the oldest
+ *          file when the log is over DATALOG_MAX_FILES. Called with
+ *          logLock held.
+ *
+ * @param   fileSeq - file sequence number of the tail
+ *
+ * @return  none
+ */
+static void datalog_flushTail(uint32_t fileSeq)
+{
+  char name[DATALOG_FILE_NAME_LEN];
+  spiffs_file fd = -1;
+  int32_t bytes = -1;
+
+  if (pLogFs != NULL)
+  {
+    datalog_fileName(fileSeq, name);
+    fd = SPIFFS_open(pLogFs, name, SPIFFS_CREAT | SPIFFS_TRUNC | SPIFFS_RDWR, 0);
+    if (fd >= 0)
+    {
+      bytes = SPIFFS_write(pLogFs, fd, tailRecs, DATALOG_FILE_SIZE);
+      SPIFFS_close(pLogFs, fd);
+    }
+  }
+
+  if (bytes == DATALOG_FILE_SIZE)
+  {
+    syncedSeq = headSeq;
+  }
+  else
+  {
+    if (pLogFs != NULL)
+    {
+      Display_printf(dispHandle, 21, 0, "Error writing log file: %d", fileSeq);
+    }
+
+    // Nothing older is left, the log starts again after this file
+    if (oldestSeq == fileSeq * DATALOG_RECORDS_PER_FILE)
+    {
+      oldestSeq = headSeq;
+      syncedSeq = headSeq;
+    }
+  }
+
+  while ((headSeq - oldestSeq) > (DATALOG_MAX_FILES * DATALOG_RECORDS_PER_FILE))
+  {
+    uint32_t oldestFileSeq = oldestSeq / DATALOG_RECORDS_PER_FILE;
+
+    if (readFileSeq == oldestFileSeq)
+    {
+      datalog_closeReadFile();
+    }
+
+    if (pLogFs != NULL)
+    {
+      datalog_fileName(oldestFileSeq, name);
+      SPIFFS_remove(pLogFs, name);
+    }
+    oldestSeq = (oldestFileSeq + 1) * DATALOG_RECORDS_PER_FILE;
+  }
+}
@@ -0,0 +1,222 @@
+/******************************************************************************
+
+ @file  datalog.h
+
+ @brief Sequence numbered record log kept in the external flash (SPIFFS).
+
+        Every record written to flash gets a 32-bit sequence number that
+        never repeats, so a central can ask for "everything after N" and
+        the watch can find it again after a disconnect or a reset.
+
+        Records are grouped DATALOG_RECORDS_PER_FILE to a SPIFFS file named
+        after the file sequence number ("L<seq / DATALOG_RECORDS_PER_FILE>").
+        The file currently being filled is held in RAM and written out when
+        it is full, and by Datalog_sync before that so a reset only loses
+        the records since the last sync. When DATALOG_MAX_FILES is exceeded
+        the oldest file is removed.
+
+        Only records in flash are read back: a reset hands the sequence
+        numbers of the records lost from RAM out again, a central must not
+        have been given them already.
+
+        The sensor task only queues its records (at most DATALOG_QUEUE_SIZE,
+        later ones are dropped); the storage task numbers and writes them
+        in Datalog_process, below the sensor task, so sampling never waits
+        on the flash. The file system is mounted in the background, the
+        records queued until then are numbered once mounting is done. When it cannot be
+        mounted the log runs degraded: only the records of the file being
+        filled are kept, in RAM, and none are read back.
+
+        Pages left by the old per-type layout (files "0" to "2525") are
+        moved into the log after mounting and then removed. Their 16 bit
+        boot relative timestamps are kept as they are, and only the newest
+        DATALOG_MAX_FILES worth of records survive the move.
+
+ *****************************************************************************/
+
+#ifndef DATALOG_H
+#define DATALOG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <third_party/spiffs/spiffs.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Number of records stored in one SPIFFS file
+#define DATALOG_RECORDS_PER_FILE      16
+
+// Maximum number of SPIFFS files used by the log (16000 records)
+#define DATALOG_MAX_FILES             1000
+
+// Number of 16-bit values carried by a record
+#define DATALOG_NUM_VALUES            5
+
+// Sequence number that is never assigned to a record
+#define DATALOG_INVALID_SEQ           0xFFFFFFFF
+
+// Records queued by the sensor task for the storage task (power of 2)
+#define DATALOG_QUEUE_SIZE            32
+
+// Storage states
+#define DATALOG_STORAGE_MOUNTING      0x00
+#define DATALOG_STORAGE_READY         0x01
+#define DATALOG_STORAGE_DEGRADED      0x02 // No file system, RAM only
+
+// Record types. PITCH_HOUR records come once per wall clock hour, stamped
+// with the start of the hour, with a sample count of 0 and no pitch values
+// for a quiet hour.
+#define DATALOG_TYPE_AMPLITUDE        0x01 // value[0] = amplitude above the doctor threshold
+#define DATALOG_TYPE_PITCH_HOUR       0x02 // value[0..4] = average, min, max pitch, doctor threshold, sample count
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t seq;                         // Sequence number of the record
+  uint32_t timeStamp;                   // Seconds, WallTime_toSeconds
+  uint8_t  type;                        // DATALOG_TYPE_*
+  uint8_t  flags;                       // Reserved, 0
+  uint16_t value[DATALOG_NUM_VALUES];   // Meaning depends on type
+} datalogRecord_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Datalog_init
+ *
+ * @brief   Construct the log lock. Must be called before the BIOS is
+ *          started and before any other Datalog function.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void Datalog_init(void);
+
+/*********************************************************************
+ * @fn      Datalog_mount
+ *
+ * @brief   Attach the log to a mounted file system and recover the
+ *          oldest and next sequence numbers from the files found on it,
+ *          then number the records appended while mounting.
+ *
+ * @param   pFs - mounted SPIFFS instance, NULL if mounting failed
+ *
+ * @return  none
+ */
+extern void Datalog_mount(spiffs *pFs);
+
+/*********************************************************************
+ * @fn      Datalog_append
+ *
+ * @brief   Queue a record for the storage task. Called by the sensor
+ *          task only, never blocks.
+ *
+ * @param   type      - DATALOG_TYPE_*
+ * @param   timeStamp - time of the record in seconds
+ * @param   pValues   - record values, numValues entries
+ * @param   numValues - number of values (at most DATALOG_NUM_VALUES)
+ *
+ * @return  none
+ */
+extern void Datalog_append(uint8_t type, uint32_t timeStamp,
+                           const uint16_t *pValues, uint8_t numValues);
+
+/*********************************************************************
+ * @fn      Datalog_sync
+ *
+ * @brief   Have the storage task write the records of the file being
+ *          filled that are only in RAM, after the records queued before.
+ *          Mounting finds the file cut short and continues it. Called by
+ *          the sensor task, never blocks.
+ *
+ * @return  none
+ */
+extern void Datalog_sync(void);
+
+/*********************************************************************
+ * @fn      Datalog_process
+ *
+ * @brief   Wait for records queued by Datalog_append or a Datalog_sync,
+ *          then number and write them. Run in a loop by the storage task
+ *          once Datalog_mount has returned.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void Datalog_process(void);
+
+/*********************************************************************
+ * @fn      Datalog_read
+ *
+ * @brief   Read consecutive records starting at a sequence number. The
+ *          read stops at the end of a file or at the synced head.
+ *
+ * @param   seq      - sequence number of the first record
+ * @param   pRecs    - buffer for the records
+ * @param   maxCount - size of pRecs in records
+ *
+ * @return  number of records read, 0 if seq is not in the log
+ */
+extern uint8_t Datalog_read(uint32_t seq, datalogRecord_t *pRecs,
+                            uint8_t maxCount);
+
+/*********************************************************************
+ * @fn      Datalog_getHeadSeq
+ *
+ * @brief   Sequence number the next appended record will get.
+ *
+ * @return  head sequence number
+ */
+extern uint32_t Datalog_getHeadSeq(void);
+
+/*********************************************************************
+ * @fn      Datalog_getSyncedSeq
+ *
+ * @brief   Sequence number after the last record written to flash. The
+ *          records from here to the head are only in RAM and not read.
+ *
+ * @return  synced head sequence number
+ */
+extern uint32_t Datalog_getSyncedSeq(void);
+
+/*********************************************************************
+ * @fn      Datalog_getOldestSeq
+ *
+ * @brief   Sequence number of the oldest record still in the log.
+ *
+ * @return  oldest sequence number (equals the head when the log is empty)
+ */
+extern uint32_t Datalog_getOldestSeq(void);
+
+/*********************************************************************
+ * @fn      Datalog_getStorageState
+ *
+ * @brief   State of the file system holding the log.
+ *
+ * @return  DATALOG_STORAGE_*
+ */
+extern uint8_t Datalog_getStorageState(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATALOG_H */
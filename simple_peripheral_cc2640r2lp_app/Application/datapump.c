@@ -0,0 +1,487 @@
+/******************************************************************************
+
+ @file  datapump.c
+
+ @brief Connection event driven transmit pump and scheduler for
+        notification streams.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include "datapump.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// No class can send
+#define DATAPUMP_CLASS_NONE           0xFF
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  dataPumpSend_t pfnSend;   // Send function, NULL if the stream is unused
+  uint8_t        trafClass; // DATAPUMP_CLASS_*
+} dataPumpStream_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static dataPumpRegisterCb_t pfnRegisterCb = NULL;
+
+static dataPumpStream_t streams[DATAPUMP_MAX_STREAMS];
+
+// Bit per active stream
+static uint8_t activeMask = 0;
+
+// Bit per active stream that had nothing to send in the current run
+static uint8_t emptyMask;
+
+// Notifications each class may queue per connection event
+static const uint8_t classLimit[DATAPUMP_NUM_CLASSES] =
+{
+  DATAPUMP_ALERT_LIMIT,
+  DATAPUMP_LIVE_LIMIT,
+  DATAPUMP_BULK_LIMIT
+};
+
+// Notifications each class may still queue until the next connection event
+static uint8_t classBudget[DATAPUMP_NUM_CLASSES];
+
+// Budget of the idle class used by the other one since the connection event
+static uint8_t spareUsed;
+
+// LIVE and BULK notifications queued since the last connection event
+static uint8_t numShared;
+
+// Weighted round between LIVE and BULK
+static uint8_t liveCredit;
+static uint8_t bulkCredit;
+
+// Notifications queued since the last connection event
+static uint16_t numSinceEvt = 0;
+
+static dataPumpStats_t stats;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void dataPump_run(void);
+static uint8_t dataPump_pickClass(void);
+static uint8_t dataPump_pickStream(uint8_t trafClass);
+static uint8_t dataPump_spareBudget(void);
+static uint8_t dataPump_mayQueue(uint8_t trafClass);
+static void dataPump_resetBudgets(void);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      DataPump_init
+ *
+ * @brief   Initialize the pump.
+ *
+ * @param   pfnRegister - (un)registers for connection event reports
+ *
+ * @return  none
+ */
+void DataPump_init(dataPumpRegisterCb_t pfnRegister)
+{
+  pfnRegisterCb = pfnRegister;
+  memset(streams, 0, sizeof(streams));
+  dataPump_resetBudgets();
+  DataPump_resetStats();
+}
+
+/*********************************************************************
+ * @fn      DataPump_addStream
+ *
+ * @brief   Give a stream its traffic class and send function.
+ *
+ * @param   stream    - DATAPUMP_STREAM_*
+ * @param   trafClass - DATAPUMP_CLASS_*
+ * @param   pfnSend   - send function of the stream
+ *
+ * @return  none
+ */
+void DataPump_addStream(uint8_t stream, uint8_t trafClass,
+                        dataPumpSend_t pfnSend)
+{
+  if ((stream < DATAPUMP_MAX_STREAMS) && (trafClass < DATAPUMP_NUM_CLASSES))
+  {
+    streams[stream].pfnSend = pfnSend;
+    streams[stream].trafClass = trafClass;
+  }
+}
+
+/*********************************************************************
+ * @fn      DataPump_start
+ *
+ * @brief   Activate a stream and send what the scheduler allows right
+ *          away.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+void DataPump_start(uint8_t stream)
+{
+  if ((stream >= DATAPUMP_MAX_STREAMS) || (streams[stream].pfnSend == NULL))
+  {
+    return;
+  }
+
+  if (!activeMask)
+  {
+    numSinceEvt = 0;
+    dataPump_resetBudgets();
+    if (pfnRegisterCb)
+    {
+      pfnRegisterCb(TRUE);
+    }
+  }
+  activeMask |= (1 << stream);
+
+  dataPump_run();
+}
+
+/*********************************************************************
+ * @fn      DataPump_stop
+ *
+ * @brief   Deactivate a stream.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+void DataPump_stop(uint8_t stream)
+{
+  if (!(activeMask & (1 << stream)))
+  {
+    return;
+  }
+
+  activeMask &= ~(1 << stream);
+  if (!activeMask && pfnRegisterCb)
+  {
+    pfnRegisterCb(FALSE);
+  }
+}
+
+/*********************************************************************
+ * @fn      DataPump_kick
+ *
+ * @brief   Send what the scheduler allows now, e.g. when a stream has
+ *          new data, instead of waiting for the next connection event.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+void DataPump_kick(uint8_t stream)
+{
+  if (activeMask & (1 << stream))
+  {
+    dataPump_run();
+  }
+}
+
+/*********************************************************************
+ * @fn      DataPump_processConnEvt
+ *
+ * @brief   Refill the TX buffers after a connection event.
+ *
+ * @param   pReport - connection event report
+ *
+ * @return  none
+ */
+void DataPump_processConnEvt(Gap_ConnEventRpt_t *pReport)
+{
+  if (!activeMask)
+  {
+    return;
+  }
+
+  // Everything queued since the previous event went out in this one or
+  // is still waiting in the stack
+  stats.numEvents++;
+  stats.numNotis += numSinceEvt;
+  stats.lastPerEvt = numSinceEvt;
+  if (numSinceEvt > stats.maxPerEvt)
+  {
+    stats.maxPerEvt = numSinceEvt;
+  }
+  numSinceEvt = 0;
+
+  dataPump_resetBudgets();
+  dataPump_run();
+}
+
+/*********************************************************************
+ * @fn      DataPump_getStats
+ *
+ * @brief   Get the notifications per connection event metric.
+ *
+ * @param   pStats - filled with the metric
+ *
+ * @return  none
+ */
+void DataPump_getStats(dataPumpStats_t *pStats)
+{
+  *pStats = stats;
+}
+
+/*********************************************************************
+ * @fn      DataPump_resetStats
+ *
+ * @brief   Restart the notifications per connection event metric.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void DataPump_resetStats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      dataPump_run
+ *
+ * @brief   Queue notifications, in the order given by the scheduler,
+ *          until the stack is full or no class may send anymore.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void dataPump_run(void)
+{
+  uint8_t trafClass;
+  uint8_t stream;
+  bStatus_t status;
+
+  emptyMask = 0;
+
+  while ((trafClass = dataPump_pickClass()) != DATAPUMP_CLASS_NONE)
+  {
+    stream = dataPump_pickStream(trafClass);
+    status = streams[stream].pfnSend();
+
+    if (status == SUCCESS)
+    {
+      if (classBudget[trafClass])
+      {
+        classBudget[trafClass]--;
+      }
+      else
+      {
+        spareUsed++;
+      }
+      if ((trafClass == DATAPUMP_CLASS_LIVE) && liveCredit)
+      {
+        liveCredit--;
+      }
+      else if ((trafClass == DATAPUMP_CLASS_BULK) && bulkCredit)
+      {
+        bulkCredit--;
+      }
+
+      if (trafClass != DATAPUMP_CLASS_ALERT)
+      {
+        numShared++;
+      }
+
+      stats.classNotis[trafClass]++;
+      numSinceEvt++;
+    }
+    else if ((status == blePending) || (status == MSG_BUFFER_NOT_AVAIL))
+    {
+      // The stack is full, go on after the next connection event
+      break;
+    }
+    else
+    {
+      // Nothing to send for now, leave the buffers to the other streams
+      emptyMask |= (1 << stream);
+    }
+  }
+
+  for (trafClass = 0; trafClass < DATAPUMP_NUM_CLASSES; trafClass++)
+  {
+    if (!dataPump_mayQueue(trafClass) &&
+        (dataPump_pickStream(trafClass) < DATAPUMP_MAX_STREAMS))
+    {
+      // Held back by the class limit or the alert reserve
+      stats.numLimited++;
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      dataPump_pickClass
+ *
+ * @brief   Choose the class of the next notification: ALERT first, then
+ *          LIVE and BULK in turn by their weights. A class is left out
+ *          when it may not queue more in this connection event, see
+ *          dataPump_mayQueue.
+ *
+ * @param   none
+ *
+ * @return  DATAPUMP_CLASS_*, DATAPUMP_CLASS_NONE if no class may send
+ */
+static uint8_t dataPump_pickClass(void)
+{
+  uint8_t ready[DATAPUMP_NUM_CLASSES];
+  uint8_t i;
+
+  for (i = 0; i < DATAPUMP_NUM_CLASSES; i++)
+  {
+    ready[i] = (dataPump_mayQueue(i) &&
+                (dataPump_pickStream(i) < DATAPUMP_MAX_STREAMS));
+  }
+
+  if (ready[DATAPUMP_CLASS_ALERT])
+  {
+    return DATAPUMP_CLASS_ALERT;
+  }
+
+  if (ready[DATAPUMP_CLASS_LIVE] && ready[DATAPUMP_CLASS_BULK])
+  {
+    if (!liveCredit && !bulkCredit)
+    {
+      // Start a new round
+      liveCredit = DATAPUMP_LIVE_WEIGHT;
+      bulkCredit = DATAPUMP_BULK_WEIGHT;
+    }
+
+    return (liveCredit) ? DATAPUMP_CLASS_LIVE : DATAPUMP_CLASS_BULK;
+  }
+
+  if (ready[DATAPUMP_CLASS_LIVE])
+  {
+    return DATAPUMP_CLASS_LIVE;
+  }
+
+  if (ready[DATAPUMP_CLASS_BULK])
+  {
+    return DATAPUMP_CLASS_BULK;
+  }
+
+  return DATAPUMP_CLASS_NONE;
+}
+
+/*********************************************************************
+ * @fn      dataPump_pickStream
+ *
+ * @brief   Find the first active stream of a class that may have
+ *          something to send.
+ *
+ * @param   trafClass - DATAPUMP_CLASS_*
+ *
+ * @return  stream, DATAPUMP_MAX_STREAMS if there is none
+ */
+static uint8_t dataPump_pickStream(uint8_t trafClass)
+{
+  uint8_t i;
+
+  for (i = 0; i < DATAPUMP_MAX_STREAMS; i++)
+  {
+    if ((activeMask & ~emptyMask & (1 << i)) &&
+        (streams[i].trafClass == trafClass))
+    {
+      break;
+    }
+  }
+
+  return i;
+}
+
+/*********************************************************************
+ * @fn      dataPump_spareBudget
+ *
+ * @brief   Budget left by LIVE or BULK while it has nothing to send,
+ *          which the other one may use once it reached its own limit. A
+ *          class that has data again keeps its own budget. The budget of
+ *          ALERT is never lent.
+ *
+ * @param   none
+ *
+ * @return  notifications that may still be queued on the spare budget
+ */
+static uint8_t dataPump_spareBudget(void)
+{
+  uint8_t spare = 0;
+  uint8_t trafClass;
+
+  for (trafClass = DATAPUMP_CLASS_LIVE; trafClass < DATAPUMP_NUM_CLASSES;
+       trafClass++)
+  {
+    if (dataPump_pickStream(trafClass) == DATAPUMP_MAX_STREAMS)
+    {
+      // Nothing to send for now, lend what is left of its budget
+      spare += classBudget[trafClass];
+    }
+  }
+
+  return (spare > spareUsed) ? (spare - spareUsed) : 0;
+}
+
+/*********************************************************************
+ * @fn      dataPump_mayQueue
+ *
+ * @brief   Check whether a class may queue another notification before
+ *          the next connection event: ALERT within its limit, LIVE and
+ *          BULK within their limit or the spare budget and while the
+ *          buffers reserved for alerts stay free.
+ *
+ * @param   trafClass - DATAPUMP_CLASS_*
+ *
+ * @return  TRUE if the class may queue
+ */
+static uint8_t dataPump_mayQueue(uint8_t trafClass)
+{
+  if (trafClass == DATAPUMP_CLASS_ALERT)
+  {
+    return (classBudget[trafClass] != 0);
+  }
+
+  if (numShared >= DATAPUMP_STACK_DEPTH - DATAPUMP_ALERT_RESERVE)
+  {
+    return FALSE;
+  }
+
+  return (classBudget[trafClass] || dataPump_spareBudget());
+}
+
+/*********************************************************************
+ * @fn      dataPump_resetBudgets
+ *
+ * @brief   Give every class its limit for the next connection event.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void dataPump_resetBudgets(void)
+{
+  memcpy(classBudget, classLimit, sizeof(classBudget));
+  spareUsed = 0;
+  numShared = 0;
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,218 @@
+/******************************************************************************
+
+ @file  datapump.h
+
+ @brief Connection event driven transmit pump and scheduler for
+        notification streams.
+
+        While at least one stream is active the application registers for
+        connection event reports. After each connection event the active
+        streams queue notifications until the stack refuses the next one
+        (blePending or MSG_BUFFER_NOT_AVAIL), so the TX buffers freed by
+        the event are refilled right away: nothing is queued beyond what
+        the stack can hold and no connection event goes by with free
+        buffers and pending data.
+
+        Every stream belongs to a traffic class, which decides who gets
+        the next buffer:
+          ALERT - strict priority, served before anything else
+          LIVE  - shares with BULK, DATAPUMP_LIVE_WEIGHT notifications
+                  for every DATAPUMP_BULK_WEIGHT of BULK
+          BULK  - history downloads
+        Each class may queue at most its DATAPUMP_*_LIMIT notifications
+        per connection event. LIVE and BULK lend their limit to each other
+        while one of them has nothing to send, so a download alone is not
+        held back by DATAPUMP_BULK_LIMIT. Together they never queue more
+        than DATAPUMP_STACK_DEPTH - DATAPUMP_ALERT_RESERVE notifications
+        per connection event, and the limit of ALERT is never lent: the
+        reserved stack buffers stay free, so an alert is queued as soon as
+        it is raised, ahead of anything queued after it, instead of
+        waiting for the backlog to drain. When the link sends the whole
+        stack in a connection event the alert goes out in the next one. A
+        link slower than what is queued per event fills the stack with the
+        rest, and the alert is then queued first after the next event.
+
+        The number of notifications queued per connection event is kept as
+        a metric, to see whether the link is saturated.
+
+        Must be used from the ICall registered application task.
+
+ *****************************************************************************/
+
+#ifndef DATAPUMP_H
+#define DATAPUMP_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Streams
+#define DATAPUMP_STREAM_LOG           0
+#define DATAPUMP_STREAM_LIVE          1
+#define DATAPUMP_STREAM_ALERT         2
+#define DATAPUMP_MAX_STREAMS          4
+
+// Traffic classes
+#define DATAPUMP_CLASS_ALERT          0
+#define DATAPUMP_CLASS_LIVE           1
+#define DATAPUMP_CLASS_BULK           2
+#define DATAPUMP_NUM_CLASSES          3
+
+// TX buffers of the stack
+#ifdef MAX_NUM_PDU
+#define DATAPUMP_STACK_DEPTH          MAX_NUM_PDU
+#else
+#define DATAPUMP_STACK_DEPTH          5   // Default of the stack build
+#endif
+
+// Stack buffers LIVE and BULK leave free for alerts
+#define DATAPUMP_ALERT_RESERVE        1
+
+// Notifications a class may queue per connection event
+#define DATAPUMP_ALERT_LIMIT          8
+#define DATAPUMP_LIVE_LIMIT           4
+#define DATAPUMP_BULK_LIMIT           3
+
+// Share of the buffers between LIVE and BULK when both have data
+#define DATAPUMP_LIVE_WEIGHT          3
+#define DATAPUMP_BULK_WEIGHT          1
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Queue the next notification of a stream. Returns SUCCESS when queued,
+// blePending or MSG_BUFFER_NOT_AVAIL when the stack has no buffer left, any
+// other status when the stream has nothing to send for now
+typedef bStatus_t (*dataPumpSend_t)(void);
+
+// Called with TRUE when connection event reports are needed, FALSE when
+// they are no longer needed
+typedef void (*dataPumpRegisterCb_t)(uint8_t enable);
+
+typedef struct
+{
+  uint32_t numEvents;     // Connection events while a stream was active
+  uint32_t numNotis;      // Notifications queued during these events
+  uint16_t lastPerEvt;    // Notifications queued after the last event
+  uint16_t maxPerEvt;     // Most notifications queued after one event
+  uint32_t classNotis[DATAPUMP_NUM_CLASSES]; // Notifications of each class
+  uint32_t numLimited;    // Times a class had data but reached its limit
+} dataPumpStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      DataPump_init
+ *
+ * @brief   Initialize the pump.
+ *
+ * @param   pfnRegister - (un)registers for connection event reports
+ *
+ * @return  none
+ */
+extern void DataPump_init(dataPumpRegisterCb_t pfnRegister);
+
+/*********************************************************************
+ * @fn      DataPump_addStream
+ *
+ * @brief   Give a stream its traffic class and send function.
+ *
+ * @param   stream    - DATAPUMP_STREAM_*
+ * @param   trafClass - DATAPUMP_CLASS_*
+ * @param   pfnSend   - send function of the stream
+ *
+ * @return  none
+ */
+extern void DataPump_addStream(uint8_t stream, uint8_t trafClass,
+                               dataPumpSend_t pfnSend);
+
+/*********************************************************************
+ * @fn      DataPump_start
+ *
+ * @brief   Activate a stream and send what the scheduler allows right
+ *          away.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+extern void DataPump_start(uint8_t stream);
+
+/*********************************************************************
+ * @fn      DataPump_stop
+ *
+ * @brief   Deactivate a stream.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+extern void DataPump_stop(uint8_t stream);
+
+/*********************************************************************
+ * @fn      DataPump_kick
+ *
+ * @brief   Send what the scheduler allows now, e.g. when a stream has
+ *          new data, instead of waiting for the next connection event.
+ *
+ * @param   stream - DATAPUMP_STREAM_*
+ *
+ * @return  none
+ */
+extern void DataPump_kick(uint8_t stream);
+
+/*********************************************************************
+ * @fn      DataPump_processConnEvt
+ *
+ * @brief   Refill the TX buffers after a connection event.
+ *
+ * @param   pReport - connection event report
+ *
+ * @return  none
+ */
+extern void DataPump_processConnEvt(Gap_ConnEventRpt_t *pReport);
+
+/*********************************************************************
+ * @fn      DataPump_getStats
+ *
+ * @brief   Get the notifications per connection event metric.
+ *
+ * @param   pStats - filled with the metric
+ *
+ * @return  none
+ */
+extern void DataPump_getStats(dataPumpStats_t *pStats);
+
+/*********************************************************************
+ * @fn      DataPump_resetStats
+ *
+ * @brief   Restart the notifications per connection event metric.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void DataPump_resetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DATAPUMP_H */
@@ -0,0 +1,238 @@
+/******************************************************************************
+
+ @file  devconfig.c
+
+ @brief Device configuration, kept in SNV.
+
+        The configuration is written by the application task and read by
+        the sensor task, which runs at a higher priority. Both copy
+        activeConfig with the interrupts disabled: a reader retrying until
+        the writer is done would never let the writer finish.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <ti/sysbios/hal/Hwi.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "devconfig.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Offsets in the record
+#define DEVCONFIG_VERSION_POS         0
+#define DEVCONFIG_ALERT_POS           1
+#define DEVCONFIG_NOISE_POS           2
+#define DEVCONFIG_DOCTOR_POS          4
+#define DEVCONFIG_PERIOD_POS          6
+#define DEVCONFIG_LOG_POS             8
+#define DEVCONFIG_RESERVED_POS        9
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Configuration in force
+static devConfig_t activeConfig =
+{
+  DEVCONFIG_DEFAULT_NOISE,
+  DEVCONFIG_DEFAULT_DOCTOR,
+  DEVCONFIG_DEFAULT_PERIOD,
+  DEVCONFIG_DEFAULT_ALERT,
+  DEVCONFIG_DEFAULT_LOG
+};
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void devConfig_parse(const uint8_t *pData, devConfig_t *pConfig);
+static void devConfig_publish(const devConfig_t *pConfig);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      DevConfig_init
+ *
+ * @brief   Load the record of SNV. To be called by the application task
+ *          once it is registered with ICall.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void DevConfig_init(void)
+{
+  uint8_t record[DEVCONFIG_LEN];
+  devConfig_t config;
+
+  // A record of another version keeps the defaults until it is rewritten
+  if ((osal_snv_read(DEVCONFIG_NV_ID, DEVCONFIG_LEN, record) == SUCCESS) &&
+      DevConfig_validate(record, DEVCONFIG_LEN))
+  {
+    devConfig_parse(record, &config);
+    devConfig_publish(&config);
+  }
+}
+
+/*********************************************************************
+ * @fn      DevConfig_validate
+ *
+ * @brief   Check a record. Has no side effects, may be called from the
+ *          stack context.
+ *
+ * @param   pData - record
+ * @param   len   - length of the record
+ *
+ * @return  TRUE if the record can be applied
+ */
+uint8_t DevConfig_validate(const uint8_t *pData, uint16_t len)
+{
+  devConfig_t config;
+
+  if ((len != DEVCONFIG_LEN) ||
+      (pData[DEVCONFIG_VERSION_POS] != DEVCONFIG_VERSION) ||
+      (pData[DEVCONFIG_RESERVED_POS] != 0))
+  {
+    return FALSE;
+  }
+
+  devConfig_parse(pData, &config);
+
+  return ((config.noiseThreshold <= config.doctorThreshold) &&
+          (config.samplePeriod >= DEVCONFIG_MIN_SAMPLE_PERIOD) &&
+          (config.samplePeriod <= DEVCONFIG_MAX_SAMPLE_PERIOD) &&
+          (config.samplePeriod % 10 == 0) &&
+          !(config.alertPolicy & ~DEVCONFIG_ALERT_ALL) &&
+          !(config.logTiers & ~DEVCONFIG_LOG_ALL));
+}
+
+/*********************************************************************
+ * @fn      DevConfig_set
+ *
+ * @brief   Apply a record, save it to SNV and hand it to the sensor task.
+ *
+ * @param   pData - record
+ * @param   len   - length of the record
+ *
+ * @return  SUCCESS, bleInvalidRange if the record is not valid
+ */
+uint8_t DevConfig_set(const uint8_t *pData, uint16_t len)
+{
+  devConfig_t config;
+
+  if (!DevConfig_validate(pData, len))
+  {
+    return bleInvalidRange;
+  }
+
+  devConfig_parse(pData, &config);
+  devConfig_publish(&config);
+
+  // Applied even if SNV is full; it is then lost at the next reset
+  osal_snv_write(DEVCONFIG_NV_ID, DEVCONFIG_LEN, (uint8_t *)pData);
+
+  return SUCCESS;
+}
+
+/*********************************************************************
+ * @fn      DevConfig_get
+ *
+ * @brief   Get the configuration in force. May be called by any task.
+ *
+ * @param   pConfig - filled in with the configuration
+ *
+ * @return  none
+ */
+void DevConfig_get(devConfig_t *pConfig)
+{
+  UInt key = Hwi_disable();
+
+  *pConfig = activeConfig;
+
+  Hwi_restore(key);
+}
+
+/*********************************************************************
+ * @fn      DevConfig_build
+ *
+ * @brief   Build the record of the configuration in force, for reads of
+ *          the Config characteristic.
+ *
+ * @param   pData - DEVCONFIG_LEN bytes, filled in with the record
+ *
+ * @return  none
+ */
+void DevConfig_build(uint8_t *pData)
+{
+  devConfig_t config;
+
+  DevConfig_get(&config);
+
+  pData[DEVCONFIG_VERSION_POS] = DEVCONFIG_VERSION;
+  pData[DEVCONFIG_ALERT_POS] = config.alertPolicy;
+  pData[DEVCONFIG_NOISE_POS] = LO_UINT16(config.noiseThreshold);
+  pData[DEVCONFIG_NOISE_POS + 1] = HI_UINT16(config.noiseThreshold);
+  pData[DEVCONFIG_DOCTOR_POS] = LO_UINT16(config.doctorThreshold);
+  pData[DEVCONFIG_DOCTOR_POS + 1] = HI_UINT16(config.doctorThreshold);
+  pData[DEVCONFIG_PERIOD_POS] = LO_UINT16(config.samplePeriod);
+  pData[DEVCONFIG_PERIOD_POS + 1] = HI_UINT16(config.samplePeriod);
+  pData[DEVCONFIG_LOG_POS] = config.logTiers;
+  pData[DEVCONFIG_RESERVED_POS] = 0;
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      devConfig_parse
+ *
+ * @brief   Decode a record.
+ *
+ * @param   pData   - record, DEVCONFIG_LEN bytes
+ * @param   pConfig - filled in with the configuration
+ *
+ * @return  none
+ */
+static void devConfig_parse(const uint8_t *pData, devConfig_t *pConfig)
+{
+  pConfig->alertPolicy = pData[DEVCONFIG_ALERT_POS];
+  pConfig->noiseThreshold = BUILD_UINT16(pData[DEVCONFIG_NOISE_POS],
+                                         pData[DEVCONFIG_NOISE_POS + 1]);
+  pConfig->doctorThreshold = BUILD_UINT16(pData[DEVCONFIG_DOCTOR_POS],
+                                          pData[DEVCONFIG_DOCTOR_POS + 1]);
+  pConfig->samplePeriod = BUILD_UINT16(pData[DEVCONFIG_PERIOD_POS],
+                                       pData[DEVCONFIG_PERIOD_POS + 1]);
+  pConfig->logTiers = pData[DEVCONFIG_LOG_POS];
+}
+
+/*********************************************************************
+ * @fn      devConfig_publish
+ *
+ * @brief   Replace the configuration in force. Only called by the
+ *          application task.
+ *
+ * @param   pConfig - new configuration
+ *
+ * @return  none
+ */
+static void devConfig_publish(const devConfig_t *pConfig)
+{
+  UInt key = Hwi_disable();
+
+  activeConfig = *pConfig;
+
+  Hwi_restore(key);
+}
+
+/*********************************************************************
+*********************************************************************/
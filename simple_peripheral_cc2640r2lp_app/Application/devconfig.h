@@ -0,0 +1,165 @@
+/******************************************************************************
+
+ @file  devconfig.h
+
+ @brief Device configuration, kept in SNV and written over the Config
+        characteristic of the MyData service.
+
+        Record (all values little endian):
+
+            [version u8][alertPolicy u8][noiseThreshold u16]
+            [doctorThreshold u16][samplePeriod u16][logTiers u8]
+            [reserved u8]
+
+        version must be DEVCONFIG_VERSION. Samples louder than
+        noiseThreshold are measured for pitch; samples louder than
+        doctorThreshold, which must not be below noiseThreshold, raise an
+        alert handled as told by the DEVCONFIG_ALERT_* bits of
+        alertPolicy. samplePeriod is the time between two level samples
+        in ms while there is sound (samplegov.h slows down in silence), a
+        multiple of 10 from DEVCONFIG_MIN_SAMPLE_PERIOD to
+        DEVCONFIG_MAX_SAMPLE_PERIOD. logTiers selects the records written
+        to the flash log (DEVCONFIG_LOG_*). reserved must be 0.
+
+        A record that does not pass these checks is rejected as a whole
+        and the previous configuration stays in force. An accepted one is
+        written to SNV and handed to the sensor task in one step, so the
+        sensor task never sees a mix of two records. At boot the record
+        of SNV is used, the defaults when there is none or when it was
+        written by another version.
+
+ *****************************************************************************/
+
+#ifndef DEVCONFIG_H
+#define DEVCONFIG_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include <bcomdef.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// SNV item holding the record
+#define DEVCONFIG_NV_ID               (BLE_NVID_CUST_START + 2)
+
+// Version of the record layout
+#define DEVCONFIG_VERSION             1
+
+// Size of the record
+#define DEVCONFIG_LEN                 10
+
+// Alert policy bits
+#define DEVCONFIG_ALERT_HAPTIC        0x01 // Run the haptic motor
+#define DEVCONFIG_ALERT_ADVERTISE     0x02 // Advertise the alert (adv_ctrl.h)
+#define DEVCONFIG_ALERT_ALL           (DEVCONFIG_ALERT_HAPTIC | \
+                                       DEVCONFIG_ALERT_ADVERTISE)
+
+// Log tier bits
+#define DEVCONFIG_LOG_AMPLITUDE       0x01 // A record for every alert
+#define DEVCONFIG_LOG_PITCH_HOUR      0x02 // A pitch summary every hour
+#define DEVCONFIG_LOG_ALL             (DEVCONFIG_LOG_AMPLITUDE | \
+                                       DEVCONFIG_LOG_PITCH_HOUR)
+
+// Range of the sample period, in ms
+#define DEVCONFIG_MIN_SAMPLE_PERIOD   100
+#define DEVCONFIG_MAX_SAMPLE_PERIOD   2500
+
+// Defaults, used until a record has been written
+#define DEVCONFIG_DEFAULT_NOISE       0
+#define DEVCONFIG_DEFAULT_DOCTOR      0
+#define DEVCONFIG_DEFAULT_PERIOD      100
+#define DEVCONFIG_DEFAULT_ALERT       DEVCONFIG_ALERT_ALL
+#define DEVCONFIG_DEFAULT_LOG         DEVCONFIG_LOG_ALL
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16_t noiseThreshold;  // Amplitude above which pitch is measured
+  uint16_t doctorThreshold; // Amplitude above which an alert is raised
+  uint16_t samplePeriod;    // Time between two level samples, in ms
+  uint8_t  alertPolicy;     // DEVCONFIG_ALERT_* bits
+  uint8_t  logTiers;        // DEVCONFIG_LOG_* bits
+} devConfig_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      DevConfig_init
+ *
+ * @brief   Load the record of SNV. To be called by the application task
+ *          once it is registered with ICall.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void DevConfig_init(void);
+
+/*********************************************************************
+ * @fn      DevConfig_validate
+ *
+ * @brief   Check a record. Has no side effects, may be called from the
+ *          stack context.
+ *
+ * @param   pData - record
+ * @param   len   - length of the record
+ *
+ * @return  TRUE if the record can be applied
+ */
+extern uint8_t DevConfig_validate(const uint8_t *pData, uint16_t len);
+
+/*********************************************************************
+ * @fn      DevConfig_set
+ *
+ * @brief   Apply a record, save it to SNV and hand it to the sensor task.
+ *
+ * @param   pData - record
+ * @param   len   - length of the record
+ *
+ * @return  SUCCESS, bleInvalidRange if the record is not valid
+ */
+extern uint8_t DevConfig_set(const uint8_t *pData, uint16_t len);
+
+/*********************************************************************
+ * @fn      DevConfig_get
+ *
+ * @brief   Get the configuration in force. May be called by any task.
+ *
+ * @param   pConfig - filled in with the configuration
+ *
+ * @return  none
+ */
+extern void DevConfig_get(devConfig_t *pConfig);
+
+/*********************************************************************
+ * @fn      DevConfig_build
+ *
+ * @brief   Build the record of the configuration in force, for reads of
+ *          the Config characteristic.
+ *
+ * @param   pData - DEVCONFIG_LEN bytes, filled in with the record
+ *
+ * @return  none
+ */
+extern void DevConfig_build(uint8_t *pData);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* DEVCONFIG_H */
@@ -0,0 +1,237 @@
+/******************************************************************************
+
+ @file  gattdb.c
+
+ @brief Versioned attribute database, kept in SNV.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+#include "gapbondmgr.h"
+
+#include "gattdb.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// FNV-1a parameters
+#define GATTDB_FNV_OFFSET             2166136261UL
+#define GATTDB_FNV_PRIME              16777619UL
+
+#if GAP_BONDINGS_MAX > 32
+#error "GAP_BONDINGS_MAX does not fit in gattDbRecord_t.pending"
+#endif
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t hash;          // Hash of the layout the bonds were told about
+  uint32_t pending;       // Bit i: bond i has not received Service Changed
+} gattDbRecord_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static uint32_t dbHash = GATTDB_FNV_OFFSET;
+
+static gattDbRecord_t record;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void gattDb_hashBytes(const uint8_t *pData, uint8_t len);
+static uint8_t gattDb_bondIndex(uint16_t connHandle);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      GattDb_addService
+ *
+ * @brief   Add a registered service to the database hash. To be called by
+ *          the AddService function of the service once
+ *          GATTServApp_RegisterService has assigned the handles.
+ *
+ * @param   pAttrTbl - attribute table of the service
+ * @param   numAttrs - number of attributes in the table
+ *
+ * @return  none
+ */
+void GattDb_addService(gattAttribute_t *pAttrTbl, uint16_t numAttrs)
+{
+  uint16_t i;
+
+  for (i = 0; i < numAttrs; i++)
+  {
+    gattAttribute_t *pAttr = &pAttrTbl[i];
+    uint8_t handle[2];
+
+    handle[0] = LO_UINT16(pAttr->handle);
+    handle[1] = HI_UINT16(pAttr->handle);
+
+    gattDb_hashBytes(handle, sizeof(handle));
+    gattDb_hashBytes(pAttr->type.uuid, pAttr->type.len);
+    gattDb_hashBytes(&pAttr->permissions, 1);
+
+    // The properties are part of the layout, the values of the others not
+    if ((pAttr->type.len == ATT_BT_UUID_SIZE) &&
+        (BUILD_UINT16(pAttr->type.uuid[0], pAttr->type.uuid[1]) ==
+         GATT_CHARACTER_UUID))
+    {
+      gattDb_hashBytes(pAttr->pValue, 1);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      GattDb_init
+ *
+ * @brief   Compare the hash with the one of the last boot, once every
+ *          service has been added. A different hash marks every bond as
+ *          needing a Service Changed indication.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void GattDb_init(void)
+{
+  uint8_t version = GATTDB_VERSION;
+
+  gattDb_hashBytes(&version, 1);
+
+  if (osal_snv_read(GATTDB_NV_ID, sizeof(record), &record) != SUCCESS)
+  {
+    // No hash yet, bonds from an older build may have any layout cached
+    record.hash = ~dbHash;
+    record.pending = 0;
+  }
+
+  if (record.hash != dbHash)
+  {
+    record.hash = dbHash;
+    record.pending = 0xFFFFFFFF;
+    osal_snv_write(GATTDB_NV_ID, sizeof(record), &record);
+  }
+}
+
+/*********************************************************************
+ * @fn      GattDb_getHash
+ *
+ * @brief   Get the database hash.
+ *
+ * @param   none
+ *
+ * @return  hash
+ */
+uint32_t GattDb_getHash(void)
+{
+  return dbHash;
+}
+
+/*********************************************************************
+ * @fn      GattDb_linkEncrypted
+ *
+ * @brief   Send the Service Changed indication to a bonded peer that has
+ *          not received it since the layout changed.
+ *
+ * @param   connHandle - connection of the peer
+ * @param   taskId     - task receiving the confirmation
+ *
+ * @return  none
+ */
+void GattDb_linkEncrypted(uint16_t connHandle, uint8_t taskId)
+{
+  uint8_t index = gattDb_bondIndex(connHandle);
+
+  if ((index >= GAP_BONDINGS_MAX) || !(record.pending & (1UL << index)))
+  {
+    return;
+  }
+
+  // Kept pending when the stack has no buffer, sent at the next connection
+  if (GATTServApp_SendServiceChangedInd(connHandle, taskId) == SUCCESS)
+  {
+    record.pending &= ~(1UL << index);
+    osal_snv_write(GATTDB_NV_ID, sizeof(record), &record);
+  }
+}
+
+/*********************************************************************
+ * @fn      GattDb_bondSaved
+ *
+ * @brief   Mark a new bond as up to date, its central has discovered the
+ *          current layout.
+ *
+ * @param   connHandle - connection of the peer
+ *
+ * @return  none
+ */
+void GattDb_bondSaved(uint16_t connHandle)
+{
+  uint8_t index = gattDb_bondIndex(connHandle);
+
+  if ((index < GAP_BONDINGS_MAX) && (record.pending & (1UL << index)))
+  {
+    record.pending &= ~(1UL << index);
+    osal_snv_write(GATTDB_NV_ID, sizeof(record), &record);
+  }
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      gattDb_hashBytes
+ *
+ * @brief   Fold bytes into the database hash.
+ *
+ * @param   pData - bytes
+ * @param   len   - number of bytes
+ *
+ * @return  none
+ */
+static void gattDb_hashBytes(const uint8_t *pData, uint8_t len)
+{
+  while (len--)
+  {
+    dbHash = (dbHash ^ *pData++) * GATTDB_FNV_PRIME;
+  }
+}
+
+/*********************************************************************
+ * @fn      gattDb_bondIndex
+ *
+ * @brief   Find the bond of the peer of a connection.
+ *
+ * @param   connHandle - connection of the peer
+ *
+ * @return  bond index, GAP_BONDINGS_MAX or more if the peer is not bonded
+ */
+static uint8_t gattDb_bondIndex(uint16_t connHandle)
+{
+  linkDBInfo_t linkInfo;
+  uint8_t idAddr[B_ADDR_LEN];
+
+  if (linkDB_GetInfo(connHandle, &linkInfo) != SUCCESS)
+  {
+    return GAP_BONDINGS_MAX;
+  }
+
+  return GAPBondMgr_ResolveAddr(linkInfo.addrType, linkInfo.addr, idAddr);
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,121 @@
+/******************************************************************************
+
+ @file  gattdb.h
+
+ @brief Versioned attribute database, so bonded centrals can keep their
+        discovery results across connections.
+
+        Every service registered by the application is folded into a hash
+        of the database layout: the handles, types and permissions of its
+        attributes and the properties of its characteristics. The hash is
+        kept in SNV. When a build changes the layout, each bond gets one
+        Service Changed indication, covering the whole database, the next
+        time its link is encrypted; a central that has not seen it yet has
+        to discover again. Until then the central can trust its cache.
+
+        The GAP, GATT and Device Information services are registered by the
+        stack and not hashed; GATTDB_VERSION must be incremented when they
+        change (new SDK, DevInfo characteristics added or removed).
+
+        Services must be added in a fixed order, new ones at the end, so
+        the handles stay the same between builds.
+
+ *****************************************************************************/
+
+#ifndef GATTDB_H
+#define GATTDB_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// SNV item holding the hash and the bonds not yet told about a change
+#define GATTDB_NV_ID                  (BLE_NVID_CUST_START + 1)
+
+// Version of the part of the database that is not hashed
+#define GATTDB_VERSION                1
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      GattDb_addService
+ *
+ * @brief   Add a registered service to the database hash. To be called by
+ *          the AddService function of the service once
+ *          GATTServApp_RegisterService has assigned the handles.
+ *
+ * @param   pAttrTbl - attribute table of the service
+ * @param   numAttrs - number of attributes in the table
+ *
+ * @return  none
+ */
+extern void GattDb_addService(gattAttribute_t *pAttrTbl, uint16_t numAttrs);
+
+/*********************************************************************
+ * @fn      GattDb_init
+ *
+ * @brief   Compare the hash with the one of the last boot, once every
+ *          service has been added. A different hash marks every bond as
+ *          needing a Service Changed indication.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void GattDb_init(void);
+
+/*********************************************************************
+ * @fn      GattDb_getHash
+ *
+ * @brief   Get the database hash.
+ *
+ * @param   none
+ *
+ * @return  hash
+ */
+extern uint32_t GattDb_getHash(void);
+
+/*********************************************************************
+ * @fn      GattDb_linkEncrypted
+ *
+ * @brief   Send the Service Changed indication to a bonded peer that has
+ *          not received it since the layout changed.
+ *
+ * @param   connHandle - connection of the peer
+ * @param   taskId     - task receiving the confirmation
+ *
+ * @return  none
+ */
+extern void GattDb_linkEncrypted(uint16_t connHandle, uint8_t taskId);
+
+/*********************************************************************
+ * @fn      GattDb_bondSaved
+ *
+ * @brief   Mark a new bond as up to date, its central has discovered the
+ *          current layout.
+ *
+ * @param   connHandle - connection of the peer
+ *
+ * @return  none
+ */
+extern void GattDb_bondSaved(uint16_t connHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GATTDB_H */
@@ -0,0 +1,673 @@
+/******************************************************************************
+
+ @file  livestream.c
+
+ @brief Live streaming of the sound level over the Live Level service.
+        Samples are pushed by the sensor task into a single producer,
+        single consumer queue and sent from the application task.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <ti/sysbios/knl/Event.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "services/livelevel.h"
+#include "datapump.h"
+#include "livestream.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Size of the packet header, up to and including the first level
+#define LIVESTREAM_HDR_LEN            8
+
+// Most samples in a packet
+#define LIVESTREAM_MAX_COUNT          255
+
+// Longest period the packet header can hold, in ms
+#define LIVESTREAM_MAX_PERIOD         2550
+
+// Largest packet, the payload of a notification in a 251 byte LL PDU
+#define LIVESTREAM_MAX_PKT_LEN        244
+
+/*********************************************************************
+ * MACROS
+ */
+
+#define LIVESTREAM_NEXT(i)            (((i) + 1) & (LIVESTREAM_QUEUE_SIZE - 1))
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint16_t connHandle;    // LINKDB_CONNHANDLE_INVALID if the entry is free
+  uint8_t  tail;          // Next sample to send to this central
+} liveSub_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static ICall_SyncHandle liveStreamEvent;
+static uint32_t liveStreamDataEvent;
+
+// Subscribed centrals, each with its own position in the queue
+static liveSub_t subs[MAX_NUM_BLE_CONNS];
+static volatile uint8_t numSubs = 0;
+
+// Subscriber to try first, so a fast link does not starve the others
+static uint8_t nextSub = 0;
+
+// Queued samples: written at queueHead by the sensor task, read from
+// queueTail, the position of the subscriber furthest behind, by the
+// application task
+static uint32_t queueTime[LIVESTREAM_QUEUE_SIZE];
+static uint16_t queueLevel[LIVESTREAM_QUEUE_SIZE];
+static volatile uint8_t queueHead = 0;
+static volatile uint8_t queueTail = 0;
+static volatile uint32_t numPushed = 0;
+
+// Position of the packet being sent: first sample, and where the
+// subscriber goes once the packet has been queued
+static uint8_t pktTail;
+
+// Last packet encoded, sent as is to the next subscriber at the same
+// position with the same MTU
+static uint8_t shareBuf[LIVESTREAM_MAX_PKT_LEN];
+static uint16_t shareLen = 0;
+static uint16_t shareMaxLen;
+static uint8_t shareFrom;
+static uint8_t shareTo;
+static uint32_t sharePushed;    // numPushed when the packet was encoded
+
+// Alert raised by the sensor task, odd alertGen while it changes
+static uint32_t alertTime;
+static uint16_t alertLevel;
+static volatile uint16_t alertGen = 0;
+
+// Alert being sent, application task only
+static uint16_t sendGen = 0;
+static uint32_t sendTime;
+static uint16_t sendLevel;
+
+// Connections the alert is still to be sent to, bit per connection handle
+static uint32_t alertMask = 0;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static bStatus_t liveStream_send(void);
+static bStatus_t liveStream_sendAlert(void);
+static uint16_t liveStream_encodeAlert(uint8_t *pBuf, uint16_t maxLen);
+static uint16_t liveStream_encodePkt(uint8_t *pBuf, uint16_t maxLen);
+static uint16_t liveStream_packSamples(uint8_t *pBuf, uint16_t maxLen,
+                                       uint8_t head);
+static liveSub_t *liveStream_findSub(uint16_t connHandle);
+static void liveStream_updateTail(void);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LiveStream_init
+ *
+ * @brief   Initialize the live stream.
+ *
+ * @param   syncEvent - event of the application task
+ * @param   dataEvent - event posted when samples or an alert are ready
+ *                      to be sent
+ *
+ * @return  none
+ */
+void LiveStream_init(ICall_SyncHandle syncEvent, uint32_t dataEvent)
+{
+  uint8_t i;
+
+  liveStreamEvent = syncEvent;
+  liveStreamDataEvent = dataEvent;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    subs[i].connHandle = LINKDB_CONNHANDLE_INVALID;
+  }
+
+  DataPump_addStream(DATAPUMP_STREAM_LIVE, DATAPUMP_CLASS_LIVE,
+                     liveStream_send);
+  DataPump_addStream(DATAPUMP_STREAM_ALERT, DATAPUMP_CLASS_ALERT,
+                     liveStream_sendAlert);
+}
+
+/*********************************************************************
+ * @fn      LiveStream_push
+ *
+ * @brief   Queue a level sample. Called by the sensor task, does nothing
+ *          unless a central is subscribed.
+ *
+ * @param   timeMs - wall clock time of the sample in ms, low 32 bits
+ * @param   level  - level sample
+ *
+ * @return  none
+ */
+void LiveStream_push(uint32_t timeMs, uint16_t level)
+{
+  uint8_t head = queueHead;
+  uint8_t pending;
+
+  if (numSubs == 0)
+  {
+    return;
+  }
+
+  if (LIVESTREAM_NEXT(head) == queueTail)
+  {
+    // The slowest link does not keep up, the newest sample is lost
+    return;
+  }
+
+  queueTime[head] = timeMs;
+  queueLevel[head] = level;
+  queueHead = LIVESTREAM_NEXT(head);
+  numPushed++;
+
+  // Wake up the application task once a few samples can share a packet
+  pending = (queueHead - queueTail) & (LIVESTREAM_QUEUE_SIZE - 1);
+  if (pending >= LIVESTREAM_FLUSH_SAMPLES)
+  {
+    Event_post(liveStreamEvent, liveStreamDataEvent);
+  }
+}
+
+/*********************************************************************
+ * @fn      LiveStream_alert
+ *
+ * @brief   Raise an alert. Called by the sensor task when the level
+ *          rises above the doctor threshold.
+ *
+ * @param   time  - time of the alert in seconds
+ * @param   level - level sample
+ *
+ * @return  none
+ */
+void LiveStream_alert(uint32_t time, uint16_t level)
+{
+  // The sensor task preempts the reader, never the other way around
+  alertGen++;
+  alertTime = time;
+  alertLevel = level;
+  alertGen++;
+
+  Event_post(liveStreamEvent, liveStreamDataEvent);
+}
+
+/*********************************************************************
+ * @fn      LiveStream_numSubscribers
+ *
+ * @brief   Number of centrals subscribed to the stream. May be called by
+ *          any task.
+ *
+ * @param   none
+ *
+ * @return  number of subscribers
+ */
+uint8_t LiveStream_numSubscribers(void)
+{
+  return numSubs;
+}
+
+/*********************************************************************
+ * @fn      LiveStream_processData
+ *
+ * @brief   Process the data event given to LiveStream_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void LiveStream_processData(void)
+{
+  uint16_t gen;
+  uint32_t time;
+  uint16_t level;
+
+  do
+  {
+    gen = alertGen;
+    time = alertTime;
+    level = alertLevel;
+  } while ((gen & 1) || (gen != alertGen));
+
+  if (gen != sendGen)
+  {
+    // A new alert, for every connection subscribed to it
+    sendGen = gen;
+    sendTime = time;
+    sendLevel = level;
+    alertMask = (1UL << MAX_NUM_BLE_CONNS) - 1;
+    DataPump_start(DATAPUMP_STREAM_ALERT);
+  }
+
+  DataPump_kick(DATAPUMP_STREAM_LIVE);
+}
+
+/*********************************************************************
+ * @fn      LiveStream_processCfg
+ *
+ * @brief   Start or stop the stream after the Level CCC was written.
+ *
+ * @param   connHandle - connection of the central
+ *
+ * @return  none
+ */
+void LiveStream_processCfg(uint16_t connHandle)
+{
+  liveSub_t *pSub = liveStream_findSub(connHandle);
+
+  if (!LiveLevel_IsNotifyEnabled(connHandle))
+  {
+    if (pSub != NULL)
+    {
+      LiveStream_linkTerminated(connHandle);
+    }
+    return;
+  }
+
+  if (pSub != NULL)
+  {
+    // Already subscribed
+    return;
+  }
+
+  pSub = liveStream_findSub(LINKDB_CONNHANDLE_INVALID);
+  if (pSub == NULL)
+  {
+    return;
+  }
+
+  // A new subscriber starts with the next sample
+  pSub->connHandle = connHandle;
+  pSub->tail = queueHead;
+  if (numSubs++ == 0)
+  {
+    queueTail = pSub->tail;
+    DataPump_start(DATAPUMP_STREAM_LIVE);
+  }
+}
+
+/*********************************************************************
+ * @fn      LiveStream_linkTerminated
+ *
+ * @brief   Stop the stream of a connection that was closed.
+ *
+ * @param   connHandle - connection that was closed, or
+ *                       LINKDB_CONNHANDLE_ALL
+ *
+ * @return  none
+ */
+void LiveStream_linkTerminated(uint16_t connHandle)
+{
+  uint8_t i;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    if ((subs[i].connHandle != LINKDB_CONNHANDLE_INVALID) &&
+        ((subs[i].connHandle == connHandle) ||
+         (connHandle == LINKDB_CONNHANDLE_ALL)))
+    {
+      subs[i].connHandle = LINKDB_CONNHANDLE_INVALID;
+      numSubs--;
+    }
+  }
+
+  // No alert for a closed connection
+  if (connHandle == LINKDB_CONNHANDLE_ALL)
+  {
+    alertMask = 0;
+  }
+  else if (connHandle < MAX_NUM_BLE_CONNS)
+  {
+    alertMask &= ~(1UL << connHandle);
+  }
+  if (alertMask == 0)
+  {
+    DataPump_stop(DATAPUMP_STREAM_ALERT);
+  }
+
+  if (numSubs == 0)
+  {
+    DataPump_stop(DATAPUMP_STREAM_LIVE);
+  }
+  liveStream_updateTail();
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      liveStream_send
+ *
+ * @brief   Send a packet of the queued samples to the next subscriber that
+ *          has samples waiting. Send function of DATAPUMP_STREAM_LIVE.
+ *
+ * @param   none
+ *
+ * @return  SUCCESS when a packet was queued, FAILURE when no sample is
+ *          waiting, else the status of the stack
+ */
+static bStatus_t liveStream_send(void)
+{
+  bStatus_t status = FAILURE;
+  bStatus_t subStatus;
+  uint8_t i;
+  uint8_t n;
+
+  for (n = 0; n < MAX_NUM_BLE_CONNS; n++)
+  {
+    liveSub_t *pSub;
+
+    i = (nextSub + n) % MAX_NUM_BLE_CONNS;
+    pSub = &subs[i];
+
+    if ((pSub->connHandle == LINKDB_CONNHANDLE_INVALID) ||
+        (pSub->tail == queueHead))
+    {
+      continue;
+    }
+
+    pktTail = pSub->tail;
+    subStatus = LiveLevel_NotifyEncode(pSub->connHandle,
+                                       liveStream_encodePkt);
+    if (subStatus == SUCCESS)
+    {
+      // The samples are only taken off the queue once they are on their
+      // way to every subscriber
+      pSub->tail = pktTail;
+      liveStream_updateTail();
+      nextSub = (i + 1) % MAX_NUM_BLE_CONNS;
+
+      return SUCCESS;
+    }
+
+    if ((subStatus == blePending) || (subStatus == MSG_BUFFER_NOT_AVAIL))
+    {
+      // This link is full, the others may still take a packet
+      status = subStatus;
+    }
+  }
+
+  return status;
+}
+
+/*********************************************************************
+ * @fn      liveStream_sendAlert
+ *
+ * @brief   Send the alert to the next connection it is still to be sent
+ *          to. Send function of DATAPUMP_STREAM_ALERT, which is stopped
+ *          once every connection has been tried.
+ *
+ * @param   none
+ *
+ * @return  SUCCESS when a notification was queued, FAILURE when the alert
+ *          has been sent everywhere, else the status of the stack
+ */
+static bStatus_t liveStream_sendAlert(void)
+{
+  bStatus_t status;
+  uint8_t i;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    if (!(alertMask & (1UL << i)))
+    {
+      continue;
+    }
+
+    status = LiveLevel_AlertEncode(i, liveStream_encodeAlert);
+    if ((status == blePending) || (status == MSG_BUFFER_NOT_AVAIL))
+    {
+      // Try this connection again after the next connection event
+      return status;
+    }
+
+    // Sent, or not subscribed to alerts
+    alertMask &= ~(1UL << i);
+    if (status == SUCCESS)
+    {
+      return SUCCESS;
+    }
+  }
+
+  DataPump_stop(DATAPUMP_STREAM_ALERT);
+
+  return FAILURE;
+}
+
+/*********************************************************************
+ * @fn      liveStream_encodeAlert
+ *
+ * @brief   Encode the alert being sent into a notification buffer.
+ *
+ * @param   pBuf   - notification payload
+ * @param   maxLen - size of the payload
+ *
+ * @return  length of the notification
+ */
+static uint16_t liveStream_encodeAlert(uint8_t *pBuf, uint16_t maxLen)
+{
+  if (maxLen < LIVELEVEL_ALERT_LEN)
+  {
+    return 0;
+  }
+
+  pBuf[0] = BREAK_UINT32(sendTime, 0);
+  pBuf[1] = BREAK_UINT32(sendTime, 1);
+  pBuf[2] = BREAK_UINT32(sendTime, 2);
+  pBuf[3] = BREAK_UINT32(sendTime, 3);
+  pBuf[4] = LO_UINT16(sendLevel);
+  pBuf[5] = HI_UINT16(sendLevel);
+
+  return LIVELEVEL_ALERT_LEN;
+}
+
+/*********************************************************************
+ * @fn      liveStream_encodePkt
+ *
+ * @brief   Fill a notification buffer with the queued samples from
+ *          pktTail on. The packet is packed once and copied for each
+ *          subscriber at the same position with the same MTU. Sets pktTail
+ *          after the last sample in the packet.
+ *
+ * @param   pBuf   - notification payload
+ * @param   maxLen - size of the payload
+ *
+ * @return  length of the packet
+ */
+static uint16_t liveStream_encodePkt(uint8_t *pBuf, uint16_t maxLen)
+{
+  uint32_t pushed = numPushed;
+  uint8_t head = queueHead;
+
+  if (maxLen > LIVESTREAM_MAX_PKT_LEN)
+  {
+    maxLen = LIVESTREAM_MAX_PKT_LEN;
+  }
+
+  // Packed again when a sample came in since, it may fit as well
+  if ((shareLen == 0) || (shareFrom != pktTail) ||
+      (shareMaxLen != maxLen) || (sharePushed != pushed))
+  {
+    shareFrom = pktTail;
+    shareMaxLen = maxLen;
+    sharePushed = pushed;
+    shareLen = liveStream_packSamples(shareBuf, maxLen, head);
+    shareTo = pktTail;
+  }
+  else
+  {
+    pktTail = shareTo;
+  }
+
+  memcpy(pBuf, shareBuf, shareLen);
+
+  return shareLen;
+}
+
+/*********************************************************************
+ * @fn      liveStream_packSamples
+ *
+ * @brief   Pack the queued samples from pktTail on. Sets pktTail after the
+ *          last sample packed.
+ *
+ * @param   pBuf   - packet
+ * @param   maxLen - size of the packet
+ * @param   head   - end of the queued samples
+ *
+ * @return  length of the packet
+ */
+static uint16_t liveStream_packSamples(uint8_t *pBuf, uint16_t maxLen,
+                                       uint8_t head)
+{
+  uint8_t i = pktTail;
+  uint16_t len = LIVESTREAM_HDR_LEN;
+  uint32_t time = queueTime[i];
+  uint16_t level = queueLevel[i];
+  uint8_t count = 1;
+  uint32_t period = queueTime[LIVESTREAM_NEXT(i)] - time;
+  int32_t delta;
+
+  if (maxLen < LIVESTREAM_HDR_LEN)
+  {
+    return 0;
+  }
+
+  // The sample period can be configured, the packet takes the one between
+  // its first two samples
+  if ((LIVESTREAM_NEXT(i) == head) || (period == 0) ||
+      (period > LIVESTREAM_MAX_PERIOD) || (period % 10 != 0))
+  {
+    period = LIVESTREAM_PERIOD;
+  }
+
+  pBuf[0] = BREAK_UINT32(time, 0);
+  pBuf[1] = BREAK_UINT32(time, 1);
+  pBuf[2] = BREAK_UINT32(time, 2);
+  pBuf[3] = BREAK_UINT32(time, 3);
+  pBuf[4] = period / 10;
+  pBuf[6] = LO_UINT16(level);
+  pBuf[7] = HI_UINT16(level);
+
+  for (i = LIVESTREAM_NEXT(i);
+       (i != head) && (count < LIVESTREAM_MAX_COUNT);
+       i = LIVESTREAM_NEXT(i))
+  {
+    if (queueTime[i] - time != period)
+    {
+      // Gap in the samples, the next packet gets a new base time
+      break;
+    }
+
+    delta = (int32_t)queueLevel[i] - level;
+    if ((delta > INT8_MAX) || (delta <= LIVESTREAM_DELTA_ESCAPE))
+    {
+      if (len + 3 > maxLen)
+      {
+        break;
+      }
+      pBuf[len++] = (uint8_t)LIVESTREAM_DELTA_ESCAPE;
+      pBuf[len++] = LO_UINT16(queueLevel[i]);
+      pBuf[len++] = HI_UINT16(queueLevel[i]);
+    }
+    else
+    {
+      if (len + 1 > maxLen)
+      {
+        break;
+      }
+      pBuf[len++] = (uint8_t)delta;
+    }
+
+    time = queueTime[i];
+    level = queueLevel[i];
+    count++;
+  }
+
+  pBuf[5] = count;
+  pktTail = i;
+
+  return len;
+}
+
+/*********************************************************************
+ * @fn      liveStream_findSub
+ *
+ * @brief   Find the subscriber entry of a connection.
+ *
+ * @param   connHandle - connection, LINKDB_CONNHANDLE_INVALID for a free
+ *                       entry
+ *
+ * @return  entry, NULL if none
+ */
+static liveSub_t *liveStream_findSub(uint16_t connHandle)
+{
+  uint8_t i;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    if (subs[i].connHandle == connHandle)
+    {
+      return &subs[i];
+    }
+  }
+
+  return NULL;
+}
+
+/*********************************************************************
+ * @fn      liveStream_updateTail
+ *
+ * @brief   Free the samples every subscriber has been sent.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void liveStream_updateTail(void)
+{
+  uint8_t head = queueHead;
+  uint8_t tail = head;
+  uint8_t maxPending = 0;
+  uint8_t pending;
+  uint8_t i;
+
+  for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+  {
+    if (subs[i].connHandle == LINKDB_CONNHANDLE_INVALID)
+    {
+      continue;
+    }
+
+    pending = (head - subs[i].tail) & (LIVESTREAM_QUEUE_SIZE - 1);
+    if (pending >= maxPending)
+    {
+      maxPending = pending;
+      tail = subs[i].tail;
+    }
+  }
+
+  queueTail = tail;
+}
+
+/*********************************************************************
+*********************************************************************/
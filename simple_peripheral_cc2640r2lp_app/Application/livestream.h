@@ -0,0 +1,164 @@
+/******************************************************************************
+
+ @file  livestream.h
+
+ @brief Live streaming of the sound level over the Live Level service.
+
+        While a central is subscribed to the Level characteristic, every
+        level sample the sensor task measures is queued and sent, as many
+        samples as fit in each notification (all values little endian):
+
+            [baseTime u32][period u8][count u8][level u16][delta]...
+
+        baseTime is the time of the first sample in ms on the wall clock
+        (see walltime.h), its low 32 bits: the central takes the rest from
+        its own clock. period is the time between two samples in units of
+        10 ms, count the number of samples in the packet. The first level is sent as is; each next one as its
+        difference to the level before it, one signed byte, or when the
+        difference does not fit as LIVESTREAM_DELTA_ESCAPE followed by the
+        level itself (u16). A packet only holds samples that are period
+        apart, a gap starts a new packet.
+
+        Every connected central can subscribe (up to MAX_NUM_BLE_CONNS).
+        Each one has its own position in the queue and is sent packets as
+        fast as its link and MTU allow; a sample is only dropped from the
+        queue once every subscriber has been sent it. Subscribers at the
+        same position with the same MTU get the same packet, packed once.
+
+        The stream of a central stops by itself when it unsubscribes or
+        its link drops.
+
+        When the level rises above the doctor threshold the sensor task
+        raises an alert (once per loud period, and not more often than
+        every few seconds when the level hovers around the threshold),
+        sent as an Alert notification to every central subscribed to it.
+        Alerts are the DATAPUMP_CLASS_ALERT traffic of the data pump and
+        go out before any queued sample or log record. An alert not yet
+        sent is replaced by a newer one.
+
+ *****************************************************************************/
+
+#ifndef LIVESTREAM_H
+#define LIVESTREAM_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Default time between two level samples, in ms; the sensor task samples
+// at the period of the device configuration (see devconfig.h)
+#define LIVESTREAM_PERIOD             100
+
+// Samples queued before the application task is woken up to send them
+#define LIVESTREAM_FLUSH_SAMPLES      3
+
+// Samples waiting to be sent (power of 2)
+#define LIVESTREAM_QUEUE_SIZE         64
+
+// Delta byte announcing a full level
+#define LIVESTREAM_DELTA_ESCAPE       ((int8_t)0x80)
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LiveStream_init
+ *
+ * @brief   Initialize the live stream.
+ *
+ * @param   syncEvent - event of the application task
+ * @param   dataEvent - event posted when samples or an alert are ready
+ *                      to be sent
+ *
+ * @return  none
+ */
+extern void LiveStream_init(ICall_SyncHandle syncEvent, uint32_t dataEvent);
+
+/*********************************************************************
+ * @fn      LiveStream_push
+ *
+ * @brief   Queue a level sample. Called by the sensor task, does nothing
+ *          unless a central is subscribed.
+ *
+ * @param   timeMs - wall clock time of the sample in ms, low 32 bits
+ * @param   level  - level sample
+ *
+ * @return  none
+ */
+extern void LiveStream_push(uint32_t timeMs, uint16_t level);
+
+/*********************************************************************
+ * @fn      LiveStream_alert
+ *
+ * @brief   Raise an alert. Called by the sensor task when the level
+ *          rises above the doctor threshold.
+ *
+ * @param   time  - time of the alert in seconds
+ * @param   level - level sample
+ *
+ * @return  none
+ */
+extern void LiveStream_alert(uint32_t time, uint16_t level);
+
+/*********************************************************************
+ * @fn      LiveStream_numSubscribers
+ *
+ * @brief   Number of centrals subscribed to the stream. May be called by
+ *          any task.
+ *
+ * @param   none
+ *
+ * @return  number of subscribers
+ */
+extern uint8_t LiveStream_numSubscribers(void);
+
+/*********************************************************************
+ * @fn      LiveStream_processData
+ *
+ * @brief   Process the data event given to LiveStream_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void LiveStream_processData(void);
+
+/*********************************************************************
+ * @fn      LiveStream_processCfg
+ *
+ * @brief   Start or stop the stream after the Level CCC was written.
+ *
+ * @param   connHandle - connection of the central
+ *
+ * @return  none
+ */
+extern void LiveStream_processCfg(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      LiveStream_linkTerminated
+ *
+ * @brief   Stop the stream of a connection that was closed.
+ *
+ * @param   connHandle - connection that was closed, or
+ *                       LINKDB_CONNHANDLE_ALL
+ *
+ * @return  none
+ */
+extern void LiveStream_linkTerminated(uint16_t connHandle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIVESTREAM_H */
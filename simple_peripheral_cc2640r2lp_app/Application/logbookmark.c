@@ -0,0 +1,178 @@
+/******************************************************************************
+
+ @file  logbookmark.c
+
+ @brief Per-bond log sync bookmarks, kept in SNV.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+#include "gapbondmgr.h"
+
+#include "logbookmark.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// One bookmark per bond the bond manager can hold
+#define LOGBOOKMARK_MAX               GAP_BONDINGS_MAX
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint8_t  addr[B_ADDR_LEN];  // Identity address of the peer
+  uint8_t  used;              // TRUE if the entry holds a bookmark
+  uint8_t  reserved;
+  uint32_t seq;               // First record not acknowledged by the peer
+} logBookmark_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static logBookmark_t bookmarks[LOGBOOKMARK_MAX];
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static uint8_t logBookmark_isBonded(uint8_t *pIdAddr);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LogBookmark_init
+ *
+ * @brief   Load the bookmark table from SNV.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void LogBookmark_init(void)
+{
+  if (osal_snv_read(LOGBOOKMARK_NV_ID, sizeof(bookmarks), bookmarks) != SUCCESS)
+  {
+    // First boot, no bookmarks yet
+    memset(bookmarks, 0, sizeof(bookmarks));
+  }
+}
+
+/*********************************************************************
+ * @fn      LogBookmark_open
+ *
+ * @brief   Find the bookmark of a peer, creating it if the peer is bonded
+ *          and has none yet.
+ *
+ * @param   addrType - address type of the peer
+ * @param   pAddr    - address of the peer as seen on the link
+ * @param   initSeq  - bookmark given to a newly created entry
+ *
+ * @return  bookmark index, LOGBOOKMARK_NONE if the peer is not bonded
+ */
+uint8_t LogBookmark_open(uint8_t addrType, uint8_t *pAddr, uint32_t initSeq)
+{
+  uint8_t idAddr[B_ADDR_LEN];
+  uint8_t i;
+
+  // Only bonded peers have an identity that stays the same across links
+  if (GAPBondMgr_ResolveAddr(addrType, pAddr, idAddr) >= GAP_BONDINGS_MAX)
+  {
+    return LOGBOOKMARK_NONE;
+  }
+
+  for (i = 0; i < LOGBOOKMARK_MAX; i++)
+  {
+    if (bookmarks[i].used && !memcmp(bookmarks[i].addr, idAddr, B_ADDR_LEN))
+    {
+      return i;
+    }
+  }
+
+  // New bond: take a free entry, or one of a peer that is no longer bonded
+  for (i = 0; i < LOGBOOKMARK_MAX; i++)
+  {
+    if (!bookmarks[i].used || !logBookmark_isBonded(bookmarks[i].addr))
+    {
+      memcpy(bookmarks[i].addr, idAddr, B_ADDR_LEN);
+      bookmarks[i].used = TRUE;
+      bookmarks[i].seq = initSeq;
+      osal_snv_write(LOGBOOKMARK_NV_ID, sizeof(bookmarks), bookmarks);
+
+      return i;
+    }
+  }
+
+  return LOGBOOKMARK_NONE;
+}
+
+/*********************************************************************
+ * @fn      LogBookmark_get
+ *
+ * @brief   Get the first record a peer has not yet acknowledged.
+ *
+ * @param   index - bookmark index from LogBookmark_open
+ *
+ * @return  sequence number
+ */
+uint32_t LogBookmark_get(uint8_t index)
+{
+  return (index < LOGBOOKMARK_MAX) ? bookmarks[index].seq : 0;
+}
+
+/*********************************************************************
+ * @fn      LogBookmark_set
+ *
+ * @brief   Move a bookmark and write the table to SNV if it changed.
+ *
+ * @param   index - bookmark index from LogBookmark_open
+ * @param   seq   - first record the peer has not yet acknowledged
+ *
+ * @return  none
+ */
+void LogBookmark_set(uint8_t index, uint32_t seq)
+{
+  if ((index < LOGBOOKMARK_MAX) && (bookmarks[index].seq != seq))
+  {
+    bookmarks[index].seq = seq;
+    osal_snv_write(LOGBOOKMARK_NV_ID, sizeof(bookmarks), bookmarks);
+  }
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      logBookmark_isBonded
+ *
+ * @brief   Check if the bond manager still holds a bond for an identity
+ *          address.
+ *
+ * @param   pIdAddr - identity address
+ *
+ * @return  TRUE if bonded
+ */
+static uint8_t logBookmark_isBonded(uint8_t *pIdAddr)
+{
+  uint8_t idAddr[B_ADDR_LEN];
+
+  // An identity address is looked up as is, whatever its type
+  return (GAPBondMgr_ResolveAddr(ADDRTYPE_PUBLIC, pIdAddr, idAddr) <
+          GAP_BONDINGS_MAX);
+}
+
+/*********************************************************************
+*********************************************************************/
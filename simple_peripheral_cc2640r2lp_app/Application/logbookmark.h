@@ -0,0 +1,100 @@
+/******************************************************************************
+
+ @file  logbookmark.h
+
+ @brief Per-bond log sync bookmarks.
+
+        For every bonded central the watch remembers the sequence number of
+        the first record that central has not yet acknowledged, so the next
+        sync only offers what was logged since. Bookmarks are keyed by the
+        identity address the bond manager stores for the peer (a resolvable
+        private address is resolved first), and kept in SNV so they survive
+        a reset.
+
+        Must be used from the ICall registered application task.
+
+ *****************************************************************************/
+
+#ifndef LOGBOOKMARK_H
+#define LOGBOOKMARK_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include <bcomdef.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// SNV item holding the bookmark table
+#define LOGBOOKMARK_NV_ID             (BLE_NVID_CUST_START)
+
+// Returned when a peer has no bookmark (not bonded)
+#define LOGBOOKMARK_NONE              0xFF
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LogBookmark_init
+ *
+ * @brief   Load the bookmark table from SNV.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void LogBookmark_init(void);
+
+/*********************************************************************
+ * @fn      LogBookmark_open
+ *
+ * @brief   Find the bookmark of a peer, creating it if the peer is bonded
+ *          and has none yet.
+ *
+ * @param   addrType - address type of the peer
+ * @param   pAddr    - address of the peer as seen on the link
+ * @param   initSeq  - bookmark given to a newly created entry
+ *
+ * @return  bookmark index, LOGBOOKMARK_NONE if the peer is not bonded
+ */
+extern uint8_t LogBookmark_open(uint8_t addrType, uint8_t *pAddr,
+                                uint32_t initSeq);
+
+/*********************************************************************
+ * @fn      LogBookmark_get
+ *
+ * @brief   Get the first record a peer has not yet acknowledged.
+ *
+ * @param   index - bookmark index from LogBookmark_open
+ *
+ * @return  sequence number
+ */
+extern uint32_t LogBookmark_get(uint8_t index);
+
+/*********************************************************************
+ * @fn      LogBookmark_set
+ *
+ * @brief   Move a bookmark and write the table to SNV if it changed.
+ *
+ * @param   index - bookmark index from LogBookmark_open
+ * @param   seq   - first record the peer has not yet acknowledged
+ *
+ * @return  none
+ */
+extern void LogBookmark_set(uint8_t index, uint32_t seq);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOGBOOKMARK_H */
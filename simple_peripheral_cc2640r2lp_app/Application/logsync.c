@@ -0,0 +1,958 @@
+/******************************************************************************
+
+ @file  logsync.c
+
+ @brief Resumable, windowed transfer of the flash log over the Log Transfer
+        service. Runs in the context of the application task.
+
+        The transfer walks the log from the start sequence number to the
+        head it had when the transfer started and cuts it into units. A
+        unit covers one or more consecutive records, so the central can
+        tell from the units it received which part of the log it has
+        seen, whether or not the records in it matched the query.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Event.h>
+
+#include <icall.h>
+#include "util.h"
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "services/logxfer.h"
+#include "datalog.h"
+#include "datapump.h"
+#include "logbookmark.h"
+#include "logsync.h"
+#include "timebase.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Most units sent in one notification (fills an ATT_MTU of 247)
+#define LOGSYNC_MAX_UNITS_PER_PKT     12
+
+// Size of the Control read value
+#define LOGSYNC_STATUS_LEN            14
+
+// Rollup periods in seconds
+#define LOGSYNC_SECONDS_PER_HOUR      3600UL
+#define LOGSYNC_SECONDS_PER_DAY       86400UL
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Start of unit i of the window
+#define LOGSYNC_UNIT(i)   (unitStart[(session.firstUnit + (i)) % LOGSYNC_WINDOW_SIZE])
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t startTime;     // First second included
+  uint32_t endTime;       // First second no longer included
+  uint16_t minLevel;      // Lowest amplitude included
+  uint8_t  tier;          // LOGSYNC_TIER_*
+} logSyncQuery_t;
+
+typedef struct
+{
+  uint16_t connHandle;    // Connection the transfer runs on
+  uint8_t  state;         // LOGSYNC_STATE_*
+  uint8_t  bookmark;      // Bookmark of the peer, LOGBOOKMARK_NONE if unbonded
+  uint8_t  peerAddr[B_ADDR_LEN]; // Address of the last peer on the link
+  uint8_t  isQuery;       // TRUE if the transfer is filtered by query
+  uint8_t  firstUnit;     // Ring index of the first unacknowledged unit
+  uint8_t  numUnits;      // Units sent and not acknowledged
+  uint32_t resumeSeq;     // Where a full sync of the peer continues
+  uint32_t ackSeq;        // Every record before this one is acknowledged
+  uint32_t nextSeq;       // Start of the next unit sent for the first time
+  uint32_t endSeq;        // The transfer stops before this record
+  uint32_t retxMask;      // Bit i set: unit i of the window must be resent
+  uint64_t lastAckTime;   // Time of the last progress of ackSeq
+  logSyncQuery_t query;   // Filter of a query transfer
+} logSyncSession_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static logSyncSession_t session =
+{
+  .connHandle = LINKDB_CONNHANDLE_INVALID,
+  .state = LOGSYNC_STATE_IDLE,
+  .bookmark = LOGBOOKMARK_NONE,
+};
+
+// Start of the units in the window
+static uint32_t unitStart[LOGSYNC_WINDOW_SIZE];
+
+// Clock for acknowledgement timeouts and retries
+static Clock_Struct logSyncClock;
+
+static ICall_SyncHandle logSyncEvent;
+
+// Window indices of the units in the notification being sent
+static uint8_t pktUnit[LOGSYNC_MAX_UNITS_PER_PKT];
+static uint8_t pktCount;
+
+// Unit being built
+static datalogRecord_t unitRec;
+
+// Records read ahead from flash while walking the log
+static datalogRecord_t scanCache[DATALOG_RECORDS_PER_FILE];
+static uint32_t scanCacheSeq;
+static uint8_t scanCacheCount;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void logSync_clockHandler(UArg arg);
+static void logSync_start(uint16_t connHandle, uint32_t fromSeq);
+static void logSync_ack(uint32_t nextSeq, uint32_t rxMask);
+static void logSync_stop(void);
+static void logSync_pause(void);
+static void logSync_rewind(void);
+static void logSync_saveBookmark(void);
+static bStatus_t logSync_send(void);
+static uint16_t logSync_encodePkt(uint8_t *pBuf, uint16_t maxLen);
+static uint8_t logSync_buildUnit(uint32_t start, uint8_t maxSpan);
+static bool logSync_matches(const datalogRecord_t *pRec);
+static const datalogRecord_t *logSync_getRecord(uint32_t seq);
+static uint8_t *logSync_encodeUnit(uint8_t *pBuf, uint32_t start,
+                                   uint8_t span, uint8_t flags);
+static uint32_t logSync_getUint32(const uint8_t *pBuf);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LogSync_init
+ *
+ * @brief   Initialize the log transfer.
+ *
+ * @param   syncEvent  - event of the application task
+ * @param   timerEvent - event posted when LogSync_processTimer must run
+ *
+ * @return  none
+ */
+void LogSync_init(ICall_SyncHandle syncEvent, uint32_t timerEvent)
+{
+  logSyncEvent = syncEvent;
+
+  LogBookmark_init();
+
+  DataPump_addStream(DATAPUMP_STREAM_LOG, DATAPUMP_CLASS_BULK, logSync_send);
+
+  Util_constructClock(&logSyncClock, logSync_clockHandler,
+                      LOGSYNC_ACK_TIMEOUT, 0, false, timerEvent);
+
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      LogSync_processControl
+ *
+ * @brief   Process a write of the Control characteristic.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   pData      - written value
+ * @param   len        - length of the written value
+ *
+ * @return  none
+ */
+void LogSync_processControl(uint16_t connHandle, uint8_t *pData, uint16_t len)
+{
+  switch (pData[0])
+  {
+    case LOGSYNC_OP_START:
+      if (len >= 5)
+      {
+        session.isQuery = FALSE;
+        logSync_start(connHandle, logSync_getUint32(&pData[1]));
+      }
+      break;
+
+    case LOGSYNC_OP_QUERY:
+      if ((len >= 16) && (pData[15] <= LOGSYNC_TIER_DAY))
+      {
+        session.isQuery = TRUE;
+        session.query.startTime = logSync_getUint32(&pData[5]);
+        session.query.endTime = logSync_getUint32(&pData[9]);
+        session.query.minLevel = BUILD_UINT16(pData[13], pData[14]);
+        session.query.tier = pData[15];
+        logSync_start(connHandle, logSync_getUint32(&pData[1]));
+      }
+      break;
+
+    case LOGSYNC_OP_ACK:
+      if ((len >= 9) && (session.state == LOGSYNC_STATE_ACTIVE) &&
+          (session.connHandle == connHandle))
+      {
+        logSync_ack(logSync_getUint32(&pData[1]),
+                    logSync_getUint32(&pData[5]));
+      }
+      break;
+
+    case LOGSYNC_OP_STOP:
+      if (session.connHandle == connHandle)
+      {
+        logSync_stop();
+      }
+      break;
+
+    default:
+      // Unknown operation, ignore
+      break;
+  }
+
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      LogSync_processTimer
+ *
+ * @brief   Process the timer event given to LogSync_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void LogSync_processTimer(void)
+{
+  uint32_t elapsed;
+
+  if (session.state != LOGSYNC_STATE_ACTIVE)
+  {
+    return;
+  }
+
+  // Nothing acknowledged for too long, send every outstanding unit again
+  elapsed = Timebase_msSince(session.lastAckTime);
+  if (session.numUnits && (elapsed >= LOGSYNC_ACK_TIMEOUT))
+  {
+    logSync_rewind();
+    session.lastAckTime = Timebase_now();
+  }
+
+  DataPump_kick(DATAPUMP_STREAM_LOG);
+}
+
+/*********************************************************************
+ * @fn      LogSync_processCfg
+ *
+ * @brief   Process a write of the Data CCC. A transfer paused because
+ *          the notifications were off goes on from the acknowledged
+ *          position once they are enabled.
+ *
+ * @param   connHandle - connection the write was received on
+ *
+ * @return  none
+ */
+void LogSync_processCfg(uint16_t connHandle)
+{
+  if ((session.state != LOGSYNC_STATE_PAUSED) ||
+      (session.connHandle != connHandle) ||
+      !LogXfer_IsNotifyEnabled(connHandle))
+  {
+    return;
+  }
+
+  session.state = LOGSYNC_STATE_ACTIVE;
+  session.lastAckTime = Timebase_now();
+  DataPump_start(DATAPUMP_STREAM_LOG);
+
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      LogSync_linkEstablished
+ *
+ * @brief   Look up where the new peer stopped its last sync. A bonded peer
+ *          continues from its bookmark; a peer that is not bonded only
+ *          continues if it is the same device that was connected before.
+ *
+ * @param   connHandle - connection that was established
+ *
+ * @return  none
+ */
+void LogSync_linkEstablished(uint16_t connHandle)
+{
+  linkDBInfo_t linkInfo;
+
+  if (linkDB_GetInfo(connHandle, &linkInfo) != SUCCESS)
+  {
+    return;
+  }
+
+  session.connHandle = connHandle;
+  session.bookmark = LogBookmark_open(linkInfo.addrType, linkInfo.addr,
+                                      Datalog_getOldestSeq());
+
+  if (session.bookmark != LOGBOOKMARK_NONE)
+  {
+    session.resumeSeq = LogBookmark_get(session.bookmark);
+  }
+  else if (memcmp(session.peerAddr, linkInfo.addr, B_ADDR_LEN))
+  {
+    // Unknown device, offer the whole log
+    session.resumeSeq = Datalog_getOldestSeq();
+  }
+
+  memcpy(session.peerAddr, linkInfo.addr, B_ADDR_LEN);
+  session.state = LOGSYNC_STATE_IDLE;
+
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      LogSync_bondSaved
+ *
+ * @brief   Give the peer a bookmark once the bond manager has saved its
+ *          bond, starting from what it acknowledged on this link.
+ *
+ * @param   connHandle - connection of the peer
+ *
+ * @return  none
+ */
+void LogSync_bondSaved(uint16_t connHandle)
+{
+  linkDBInfo_t linkInfo;
+
+  if ((session.connHandle != connHandle) ||
+      (session.bookmark != LOGBOOKMARK_NONE) ||
+      (linkDB_GetInfo(connHandle, &linkInfo) != SUCCESS))
+  {
+    return;
+  }
+
+  session.bookmark = LogBookmark_open(linkInfo.addrType, linkInfo.addr,
+                                      session.resumeSeq);
+}
+
+/*********************************************************************
+ * @fn      LogSync_linkTerminated
+ *
+ * @brief   Suspend the transfer of a connection that was closed. The
+ *          acknowledged position is kept for a later START with
+ *          LOGSYNC_RESUME.
+ *
+ * @param   connHandle - connection that was closed
+ *
+ * @return  none
+ */
+void LogSync_linkTerminated(uint16_t connHandle)
+{
+  if ((session.connHandle != connHandle) &&
+      (connHandle != LINKDB_CONNHANDLE_ALL))
+  {
+    return;
+  }
+
+  if ((session.state == LOGSYNC_STATE_ACTIVE) ||
+      (session.state == LOGSYNC_STATE_PAUSED))
+  {
+    // Whatever was not acknowledged is sent again when resumed
+    session.state = LOGSYNC_STATE_SUSPENDED;
+    logSync_rewind();
+    DataPump_stop(DATAPUMP_STREAM_LOG);
+  }
+
+  logSync_saveBookmark();
+
+  session.connHandle = LINKDB_CONNHANDLE_INVALID;
+  session.bookmark = LOGBOOKMARK_NONE;
+  Util_stopClock(&logSyncClock);
+
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      LogSync_updateStatus
+ *
+ * @brief   Refresh the value returned by a read of the Control
+ *          characteristic.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void LogSync_updateStatus(void)
+{
+  uint8_t status[LOGSYNC_STATUS_LEN];
+  uint32_t oldest = Datalog_getOldestSeq();
+  uint32_t head = Datalog_getSyncedSeq();
+
+  status[0] = session.state;
+  status[1] = BREAK_UINT32(oldest, 0);
+  status[2] = BREAK_UINT32(oldest, 1);
+  status[3] = BREAK_UINT32(oldest, 2);
+  status[4] = BREAK_UINT32(oldest, 3);
+  status[5] = BREAK_UINT32(head, 0);
+  status[6] = BREAK_UINT32(head, 1);
+  status[7] = BREAK_UINT32(head, 2);
+  status[8] = BREAK_UINT32(head, 3);
+  status[9] = BREAK_UINT32(session.resumeSeq, 0);
+  status[10] = BREAK_UINT32(session.resumeSeq, 1);
+  status[11] = BREAK_UINT32(session.resumeSeq, 2);
+  status[12] = BREAK_UINT32(session.resumeSeq, 3);
+  status[13] = Datalog_getStorageState();
+
+  LogXfer_SetParameter(LOGXFER_CONTROL_ID, LOGSYNC_STATUS_LEN, status);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      logSync_clockHandler
+ *
+ * @brief   Clock handler, wakes up the application task.
+ *
+ * @param   arg - event to post
+ *
+ * @return  none
+ */
+static void logSync_clockHandler(UArg arg)
+{
+  Event_post(logSyncEvent, arg);
+}
+
+/*********************************************************************
+ * @fn      logSync_start
+ *
+ * @brief   Start a transfer of the records from fromSeq up to the head
+ *          of the log in flash. A record only in RAM could come back
+ *          under another sequence number after a reset.
+ *
+ * @param   connHandle - connection to send on
+ * @param   fromSeq    - first record, or LOGSYNC_RESUME
+ *
+ * @return  none
+ */
+static void logSync_start(uint16_t connHandle, uint32_t fromSeq)
+{
+  uint32_t oldest = Datalog_getOldestSeq();
+  uint32_t head = Datalog_getSyncedSeq();
+
+  if (fromSeq == LOGSYNC_RESUME)
+  {
+    fromSeq = session.resumeSeq;
+  }
+
+  // Records before the oldest one have been removed from the log
+  if (fromSeq < oldest)
+  {
+    fromSeq = oldest;
+  }
+  else if (fromSeq > head)
+  {
+    fromSeq = head;
+  }
+
+  session.connHandle = connHandle;
+  session.ackSeq = fromSeq;
+  session.endSeq = head;
+  session.lastAckTime = Timebase_now();
+  logSync_rewind();
+
+  if (fromSeq == head)
+  {
+    // Nothing to send, tell the central with an empty last unit
+    uint8_t unit[LOGSYNC_UNIT_LEN];
+
+    session.state = LOGSYNC_STATE_IDLE;
+    memset(&unitRec, 0, sizeof(unitRec));
+    unitRec.type = LOGSYNC_RECORD_SKIP;
+    logSync_encodeUnit(unit, head, 0, LOGSYNC_UNIT_FLAG_LAST);
+    LogXfer_Notify(connHandle, unit, LOGSYNC_UNIT_LEN);
+    return;
+  }
+
+  session.state = LOGSYNC_STATE_ACTIVE;
+  DataPump_start(DATAPUMP_STREAM_LOG);
+}
+
+/*********************************************************************
+ * @fn      logSync_ack
+ *
+ * @brief   Process an acknowledgement from the central.
+ *
+ * @param   nextSeq - every record before this one has been received
+ * @param   rxMask  - bit i: unit i + 1 after nextSeq has been received
+ *
+ * @return  none
+ */
+static void logSync_ack(uint32_t nextSeq, uint32_t rxMask)
+{
+  uint8_t units;
+  uint8_t highest;
+  uint8_t i;
+
+  // The acknowledged position must be the start of a unit in the window
+  for (units = 0;
+       (units < session.numUnits) && (LOGSYNC_UNIT(units) != nextSeq);
+       units++);
+
+  if ((units == session.numUnits) && (nextSeq != session.nextSeq))
+  {
+    // Stale, or from before a rewind
+    return;
+  }
+
+  if (units)
+  {
+    session.firstUnit = (session.firstUnit + units) % LOGSYNC_WINDOW_SIZE;
+    session.numUnits -= units;
+    session.retxMask = (units >= 32) ? 0 : (session.retxMask >> units);
+    session.ackSeq = nextSeq;
+    session.lastAckTime = Timebase_now();
+
+    // A query only delivers part of the log, so it does not count as synced
+    if (!session.isQuery)
+    {
+      session.resumeSeq = nextSeq;
+    }
+  }
+
+  if (session.ackSeq >= session.endSeq)
+  {
+    // Everything has been received
+    session.state = LOGSYNC_STATE_IDLE;
+    session.retxMask = 0;
+    Util_stopClock(&logSyncClock);
+    DataPump_stop(DATAPUMP_STREAM_LOG);
+    logSync_saveBookmark();
+    return;
+  }
+
+  if (rxMask)
+  {
+    // Units missing before the highest received one have been lost
+    for (highest = 31; !(rxMask & (1UL << highest)); highest--);
+
+    for (i = 0; (i <= highest) && (i < session.numUnits); i++)
+    {
+      if ((i == 0) || !(rxMask & (1UL << (i - 1))))
+      {
+        session.retxMask |= (1UL << i);
+      }
+    }
+  }
+
+  DataPump_kick(DATAPUMP_STREAM_LOG);
+}
+
+/*********************************************************************
+ * @fn      logSync_stop
+ *
+ * @brief   Stop the transfer. The acknowledged position is kept.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void logSync_stop(void)
+{
+  session.state = LOGSYNC_STATE_IDLE;
+  logSync_rewind();
+  Util_stopClock(&logSyncClock);
+  DataPump_stop(DATAPUMP_STREAM_LOG);
+  logSync_saveBookmark();
+}
+
+/*********************************************************************
+ * @fn      logSync_pause
+ *
+ * @brief   End the transfer until the central enables the Data
+ *          notifications again, see LogSync_processCfg. The acknowledged
+ *          position is kept.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void logSync_pause(void)
+{
+  session.state = LOGSYNC_STATE_PAUSED;
+  logSync_rewind();
+  Util_stopClock(&logSyncClock);
+  DataPump_stop(DATAPUMP_STREAM_LOG);
+  logSync_saveBookmark();
+  LogSync_updateStatus();
+}
+
+/*********************************************************************
+ * @fn      logSync_rewind
+ *
+ * @brief   Forget the units sent and not acknowledged, so the transfer
+ *          goes on from the acknowledged position.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void logSync_rewind(void)
+{
+  session.nextSeq = session.ackSeq;
+  session.numUnits = 0;
+  session.retxMask = 0;
+}
+
+/*********************************************************************
+ * @fn      logSync_saveBookmark
+ *
+ * @brief   Store how far the peer got in its bookmark. Only done when a
+ *          transfer ends or the link drops, to spare the flash.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void logSync_saveBookmark(void)
+{
+  if (session.bookmark != LOGBOOKMARK_NONE)
+  {
+    LogBookmark_set(session.bookmark, session.resumeSeq);
+  }
+}
+
+/*********************************************************************
+ * @fn      logSync_send
+ *
+ * @brief   Send the next packet of units, units to resend first. Send
+ *          function of DATAPUMP_STREAM_LOG, called by the data pump as
+ *          long as the stack has buffers and the scheduler gives bulk
+ *          traffic its turn.
+ *
+ * @param   none
+ *
+ * @return  SUCCESS when a packet was queued, FAILURE when the window is
+ *          full or everything was sent, else the status of the stack
+ */
+static bStatus_t logSync_send(void)
+{
+  bStatus_t status = FAILURE;
+
+  if (session.state == LOGSYNC_STATE_ACTIVE)
+  {
+    // Units are encoded straight into the notification buffer
+    pktCount = 0;
+    status = LogXfer_NotifyEncode(session.connHandle, logSync_encodePkt);
+    if (status == bleIncorrectMode)
+    {
+      // Data notifications are off, resending would never get through
+      logSync_pause();
+      return status;
+    }
+    else if (status != SUCCESS)
+    {
+      // Send the encoded units again after the next connection event
+      while (pktCount)
+      {
+        session.retxMask |= (1UL << pktUnit[--pktCount]);
+      }
+    }
+    else if (pktCount == 0)
+    {
+      // Window full or everything sent, wait for acknowledgements
+      status = FAILURE;
+    }
+
+    // Watch for a missing acknowledgement
+    if (!Util_isActive(&logSyncClock))
+    {
+      Util_restartClock(&logSyncClock, LOGSYNC_ACK_TIMEOUT);
+    }
+  }
+
+  return status;
+}
+
+/*********************************************************************
+ * @fn      logSync_encodePkt
+ *
+ * @brief   Encode the next packet of the transfer, units to resend first,
+ *          into a notification buffer. The window indices of the units
+ *          are kept in pktUnit so they can be resent if the notification
+ *          is not queued.
+ *
+ * @param   pBuf   - notification payload
+ * @param   maxLen - size of the payload
+ *
+ * @return  length of the packet, 0 if there is nothing to send
+ */
+static uint16_t logSync_encodePkt(uint8_t *pBuf, uint16_t maxLen)
+{
+  uint8_t *pUnit = pBuf;
+  uint32_t start;
+  uint8_t span;
+  uint8_t maxUnits;
+  uint8_t i;
+
+  maxUnits = MIN(maxLen / LOGSYNC_UNIT_LEN, LOGSYNC_MAX_UNITS_PER_PKT);
+
+  while (pktCount < maxUnits)
+  {
+    if (session.retxMask)
+    {
+      // Rebuild a lost unit, it covers the same records as before
+      for (i = 0; !(session.retxMask & (1UL << i)); i++);
+      session.retxMask &= ~(1UL << i);
+
+      start = LOGSYNC_UNIT(i);
+      span = ((i + 1 < session.numUnits) ? LOGSYNC_UNIT(i + 1) :
+                                           session.nextSeq) - start;
+      logSync_buildUnit(start, span);
+    }
+    else if ((session.nextSeq < session.endSeq) &&
+             (session.numUnits < LOGSYNC_WINDOW_SIZE))
+    {
+      i = session.numUnits++;
+      start = session.nextSeq;
+      LOGSYNC_UNIT(i) = start;
+      span = logSync_buildUnit(start, MIN(session.endSeq - start,
+                                          LOGSYNC_MAX_SPAN));
+      session.nextSeq += span;
+    }
+    else
+    {
+      break;
+    }
+
+    pUnit = logSync_encodeUnit(pUnit, start, span,
+                               (start + span == session.endSeq) ?
+                               LOGSYNC_UNIT_FLAG_LAST : 0);
+    pktUnit[pktCount++] = i;
+  }
+
+  return (pktCount) ? (pUnit - pBuf) : 0;
+}
+
+/*********************************************************************
+ * @fn      logSync_buildUnit
+ *
+ * @brief   Build the unit starting at a record into unitRec. With the
+ *          raw tier a unit ends at the first matching record; a rollup
+ *          ends before the first matching record of the next hour or day.
+ *          Either way it ends after maxSpan records.
+ *
+ * @param   start   - first record of the unit
+ * @param   maxSpan - most records the unit may cover
+ *
+ * @return  number of records covered by the unit
+ */
+static uint8_t logSync_buildUnit(uint32_t start, uint8_t maxSpan)
+{
+  const datalogRecord_t *pRec;
+  uint32_t period;
+  uint32_t periodStart = 0;
+  uint64_t pitchSum = 0;
+  uint32_t pitchCount = 0;
+  uint8_t span;
+
+  memset(&unitRec, 0, sizeof(unitRec));
+  unitRec.type = LOGSYNC_RECORD_SKIP;
+
+  period = (session.query.tier == LOGSYNC_TIER_HOUR) ? LOGSYNC_SECONDS_PER_HOUR :
+                                                       LOGSYNC_SECONDS_PER_DAY;
+
+  for (span = 0; span < maxSpan; span++)
+  {
+    pRec = logSync_getRecord(start + span);
+
+    if (!session.isQuery || (session.query.tier == LOGSYNC_TIER_RAW))
+    {
+      if (pRec == NULL)
+      {
+        // A full sync tells the central about records it will never get
+        if (!session.isQuery)
+        {
+          unitRec.type = LOGSYNC_RECORD_LOST;
+          span++;
+          break;
+        }
+      }
+      else if (logSync_matches(pRec))
+      {
+        unitRec = *pRec;
+        span++;
+        break;
+      }
+      continue;
+    }
+
+    if ((pRec == NULL) || !logSync_matches(pRec))
+    {
+      continue;
+    }
+
+    if (unitRec.type != LOGSYNC_RECORD_ROLLUP)
+    {
+      unitRec.type = LOGSYNC_RECORD_ROLLUP;
+      periodStart = pRec->timeStamp - (pRec->timeStamp % period);
+      unitRec.timeStamp = periodStart;
+      unitRec.value[3] = 0xFFFF;
+    }
+    else if (pRec->timeStamp - (pRec->timeStamp % period) != periodStart)
+    {
+      // First record of the next rollup
+      break;
+    }
+
+    if (pRec->type == DATALOG_TYPE_AMPLITUDE)
+    {
+      if (unitRec.value[0] < 0xFFFF)
+      {
+        unitRec.value[0]++;
+      }
+      unitRec.value[1] = MAX(unitRec.value[1], pRec->value[0]);
+    }
+    else if ((pRec->type == DATALOG_TYPE_PITCH_HOUR) && pRec->value[4])
+    {
+      // Quiet hours have no pitch to take the min and max of.
+      // Weigh the hourly averages by their number of samples
+      pitchSum += (uint64_t)pRec->value[0] * pRec->value[4];
+      pitchCount += pRec->value[4];
+      unitRec.value[3] = MIN(unitRec.value[3], pRec->value[1]);
+      unitRec.value[4] = MAX(unitRec.value[4], pRec->value[2]);
+    }
+  }
+
+  if (unitRec.type == LOGSYNC_RECORD_ROLLUP)
+  {
+    if (pitchCount)
+    {
+      unitRec.value[2] = pitchSum / pitchCount;
+    }
+    else
+    {
+      unitRec.value[3] = 0;
+    }
+  }
+
+  return span;
+}
+
+/*********************************************************************
+ * @fn      logSync_matches
+ *
+ * @brief   Check a record against the query of the transfer.
+ *
+ * @param   pRec - record
+ *
+ * @return  TRUE if the record is to be sent
+ */
+static bool logSync_matches(const datalogRecord_t *pRec)
+{
+  if (!session.isQuery)
+  {
+    return TRUE;
+  }
+
+  if ((pRec->timeStamp < session.query.startTime) ||
+      (pRec->timeStamp >= session.query.endTime))
+  {
+    return FALSE;
+  }
+
+  if (pRec->type == DATALOG_TYPE_AMPLITUDE)
+  {
+    return (pRec->value[0] >= session.query.minLevel);
+  }
+
+  // Records without an amplitude only match when there is no minimum
+  return (session.query.minLevel == 0);
+}
+
+/*********************************************************************
+ * @fn      logSync_getRecord
+ *
+ * @brief   Get a record of the log, reading a file ahead so walking the
+ *          log does not read the flash for every record.
+ *
+ * @param   seq - sequence number of the record
+ *
+ * @return  record, NULL if it can not be read
+ */
+static const datalogRecord_t *logSync_getRecord(uint32_t seq)
+{
+  if ((seq < scanCacheSeq) || (seq - scanCacheSeq >= scanCacheCount))
+  {
+    scanCacheSeq = seq;
+    scanCacheCount = Datalog_read(seq, scanCache, DATALOG_RECORDS_PER_FILE);
+    if (scanCacheCount == 0)
+    {
+      return NULL;
+    }
+  }
+
+  return &scanCache[seq - scanCacheSeq];
+}
+
+/*********************************************************************
+ * @fn      logSync_encodeUnit
+ *
+ * @brief   Encode unitRec into a Data packet.
+ *
+ * @param   pBuf  - where to write the unit
+ * @param   start - first record covered by the unit
+ * @param   span  - number of records covered by the unit
+ * @param   flags - LOGSYNC_UNIT_FLAG_*
+ *
+ * @return  position after the unit
+ */
+static uint8_t *logSync_encodeUnit(uint8_t *pBuf, uint32_t start, uint8_t span,
+                                   uint8_t flags)
+{
+  uint8_t i;
+
+  *pBuf++ = BREAK_UINT32(start, 0);
+  *pBuf++ = BREAK_UINT32(start, 1);
+  *pBuf++ = BREAK_UINT32(start, 2);
+  *pBuf++ = BREAK_UINT32(start, 3);
+  *pBuf++ = span;
+  *pBuf++ = BREAK_UINT32(unitRec.timeStamp, 0);
+  *pBuf++ = BREAK_UINT32(unitRec.timeStamp, 1);
+  *pBuf++ = BREAK_UINT32(unitRec.timeStamp, 2);
+  *pBuf++ = BREAK_UINT32(unitRec.timeStamp, 3);
+  *pBuf++ = (unitRec.type & LOGSYNC_UNIT_TYPE_MASK) | flags;
+
+  for (i = 0; i < DATALOG_NUM_VALUES; i++)
+  {
+    *pBuf++ = LO_UINT16(unitRec.value[i]);
+    *pBuf++ = HI_UINT16(unitRec.value[i]);
+  }
+
+  return pBuf;
+}
+
+/*********************************************************************
+ * @fn      logSync_getUint32
+ *
+ * @brief   Read a little endian 32-bit value.
+ *
+ * @param   pBuf - value
+ *
+ * @return  value
+ */
+static uint32_t logSync_getUint32(const uint8_t *pBuf)
+{
+  return BUILD_UINT32(pBuf[0], pBuf[1], pBuf[2], pBuf[3]);
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,232 @@
+/******************************************************************************
+
+ @file  logsync.h
+
+ @brief Resumable, windowed transfer of the flash log over the Log Transfer
+        service.
+
+        Protocol (all values little endian):
+
+        Control write, START:  [0x01][fromSeq u32]
+            Send the records from fromSeq up to the head of the log in
+            flash (see Datalog_getSyncedSeq). fromSeq = LOGSYNC_RESUME continues after the last record
+            the central acknowledged, also across disconnects. For a
+            bonded central this position is its bookmark, kept in SNV
+            (see logbookmark.h), so each central only gets new records.
+        Control write, QUERY:  [0x04][fromSeq u32][startTime u32]
+                               [endTime u32][minLevel u16][tier u8]
+            Like START, but only records with startTime <= time < endTime
+            are sent. Amplitude records must be at least minLevel; hourly
+            pitch records only match when minLevel is 0. With a tier other
+            than LOGSYNC_TIER_RAW the matching records are summed up per
+            hour or day and only the rollups are sent (a long hour or day
+            can take several rollups with the same time). A query does not
+            move the bookmark.
+        Control write, ACK:    [0x02][nextSeq u32][rxMask u32]
+            Every record before nextSeq has been received. Bit i of rxMask
+            tells that unit i + 1 after the one starting at nextSeq has
+            been received as well; units before the highest received one
+            that are missing are sent again.
+        Control write, STOP:   [0x03]
+        Control read:          [state u8][oldestSeq u32][headSeq u32]
+                               [resumeSeq u32][storage u8]
+            storage is DATALOG_STORAGE_*: until it leaves MOUNTING the
+            log looks empty, DEGRADED means no record is kept in flash
+            and none is sent. headSeq is the head of the log in flash,
+            records still in RAM are sent once they are written.
+
+        Data notification:     [unit]...
+            Each unit is [seq u32][span u8][time u32][flags|type u8]
+            [value u16 x 5] and stands for the span records starting at
+            seq: a record of the log (span 1), a rollup of the matching
+            records among them (LOGSYNC_RECORD_ROLLUP) or nothing matching
+            at all (LOGSYNC_RECORD_SKIP). LOGSYNC_RECORD_LOST stands for a
+            record that could not be read back from flash. The type is in
+            the bits of LOGSYNC_UNIT_TYPE_MASK; LOGSYNC_UNIT_FLAG_LAST is
+            set on the last unit of the transfer. When there is nothing to
+            send, a single SKIP unit of span 0 at the head carries it.
+            A unit fits the 20 byte payload of the default ATT_MTU of 23,
+            a larger MTU takes several units per notification.
+
+        At most LOGSYNC_WINDOW_SIZE units are unacknowledged at any time.
+        When no acknowledgement arrives for LOGSYNC_ACK_TIMEOUT ms all
+        unacknowledged units are sent again. When the central has not
+        enabled the Data notifications the transfer is paused
+        (LOGSYNC_STATE_PAUSED) and goes on from the acknowledged position
+        once they are enabled. Units are sent through the data pump (see
+        datapump.h), which keeps the TX buffers filled after every
+        connection event.
+
+ *****************************************************************************/
+
+#ifndef LOGSYNC_H
+#define LOGSYNC_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <icall.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Control operations
+#define LOGSYNC_OP_START              0x01
+#define LOGSYNC_OP_ACK                0x02
+#define LOGSYNC_OP_STOP               0x03
+#define LOGSYNC_OP_QUERY              0x04
+
+// Query resolution tiers
+#define LOGSYNC_TIER_RAW              0x00 // Every matching record
+#define LOGSYNC_TIER_HOUR             0x01 // One rollup per hour
+#define LOGSYNC_TIER_DAY              0x02 // One rollup per day
+
+// Query endTime without upper limit
+#define LOGSYNC_TIME_OPEN             0xFFFFFFFF
+
+// START argument: continue after the last acknowledged record
+#define LOGSYNC_RESUME                0xFFFFFFFF
+
+// Transfer states, reported in the Control read
+#define LOGSYNC_STATE_IDLE            0x00
+#define LOGSYNC_STATE_ACTIVE          0x01
+#define LOGSYNC_STATE_SUSPENDED       0x02 // Link lost during a transfer
+#define LOGSYNC_STATE_PAUSED          0x03 // Data notifications disabled
+                                           // during a transfer
+
+// Unit flags, in the type byte
+#define LOGSYNC_UNIT_FLAG_LAST        0x80 // Last unit of the transfer
+#define LOGSYNC_UNIT_TYPE_MASK        0x7F
+
+// Unit types besides the DATALOG_TYPE_* records
+#define LOGSYNC_RECORD_LOST           0x00 // Record could not be read back
+#define LOGSYNC_RECORD_ROLLUP         0x10 // value[0..4] = alert count, max
+                                           // amplitude, average, min, max pitch
+#define LOGSYNC_RECORD_SKIP           0x7E // No record in the span matched
+
+// Size of a unit in a Data notification
+#define LOGSYNC_UNIT_LEN              20
+
+// Most records a unit can stand for
+#define LOGSYNC_MAX_SPAN              255
+
+// Units sent but not acknowledged (at most 32, the width of the masks)
+#define LOGSYNC_WINDOW_SIZE           32
+
+// Time without acknowledgement before everything unacknowledged is resent
+#define LOGSYNC_ACK_TIMEOUT           3000
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      LogSync_init
+ *
+ * @brief   Initialize the log transfer.
+ *
+ * @param   syncEvent  - event of the application task
+ * @param   timerEvent - event posted when LogSync_processTimer must run
+ *
+ * @return  none
+ */
+extern void LogSync_init(ICall_SyncHandle syncEvent, uint32_t timerEvent);
+
+/*********************************************************************
+ * @fn      LogSync_processControl
+ *
+ * @brief   Process a write of the Control characteristic.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   pData      - written value
+ * @param   len        - length of the written value
+ *
+ * @return  none
+ */
+extern void LogSync_processControl(uint16_t connHandle, uint8_t *pData,
+                                   uint16_t len);
+
+/*********************************************************************
+ * @fn      LogSync_processTimer
+ *
+ * @brief   Process the timer event given to LogSync_init.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void LogSync_processTimer(void);
+
+/*********************************************************************
+ * @fn      LogSync_processCfg
+ *
+ * @brief   Process a write of the Data CCC. A transfer paused because
+ *          the notifications were off goes on once they are enabled.
+ *
+ * @param   connHandle - connection the write was received on
+ *
+ * @return  none
+ */
+extern void LogSync_processCfg(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      LogSync_linkEstablished
+ *
+ * @brief   Look up where the new peer stopped its last sync. A bonded peer
+ *          continues from its bookmark; a peer that is not bonded only
+ *          continues if it is the same device that was connected before.
+ *
+ * @param   connHandle - connection that was established
+ *
+ * @return  none
+ */
+extern void LogSync_linkEstablished(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      LogSync_bondSaved
+ *
+ * @brief   Give the peer a bookmark once the bond manager has saved its
+ *          bond, starting from what it acknowledged on this link.
+ *
+ * @param   connHandle - connection of the peer
+ *
+ * @return  none
+ */
+extern void LogSync_bondSaved(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      LogSync_linkTerminated
+ *
+ * @brief   Suspend the transfer of a connection that was closed. The
+ *          acknowledged position is kept for a later START with
+ *          LOGSYNC_RESUME.
+ *
+ * @param   connHandle - connection that was closed
+ *
+ * @return  none
+ */
+extern void LogSync_linkTerminated(uint16_t connHandle);
+
+/*********************************************************************
+ * @fn      LogSync_updateStatus
+ *
+ * @brief   Refresh the value returned by a read of the Control
+ *          characteristic.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void LogSync_updateStatus(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LOGSYNC_H */
@@ -50,15 +50,31 @@
  * INCLUDES
  */
 
+#include <stdlib.h>
+
 #include <ti/drivers/Power.h>
 #include <ti/drivers/power/PowerCC26XX.h>
 #include <ti/sysbios/knl/Clock.h>
+#include <ti/sysbios/knl/Event.h>
+
+#include <inc/hw_types.h>
+#include <inc/hw_memmap.h>
+#include <inc/hw_aon_rtc.h>
+#include <driverlib/aon_batmon.h>
 
 #include "hci.h"
 
 #include "util.h"
+#include "timebase.h"
 #include "rcosc_calibration.h"
 
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// RTC increment per SCLK_LF period at exactly 32768 Hz
+#define RCOSC_SUBSECINC_NOMINAL               0x800000
+
 /*********************************************************************
  * LOCAL VARIABLES
  */
@@ -71,6 +87,31 @@ Power_NotifyObj injectCalibrationPowerNotifyObj;
 
 static uint8_t isEnabled = FALSE;
 
+// Posted when the measured sleep clock accuracy changes
+static ICall_SyncHandle scaSyncEvent;
+static uint32_t scaUpdateEvent;
+
+// Sleep clock accuracy declared to the stack, written by the application
+// task only
+static uint16_t scaInForce = RCOSC_SCA_WORST;
+
+// Largest drift of the window in progress and of the one before it, in ppm
+static uint16_t windowPeak = 0;
+static uint16_t lastWindowPeak = 0;
+static uint16_t numWindowMeasures = 0;
+static uint8_t isScaMeasured = FALSE;
+
+// Calibration interval in force, in ms
+static uint16_t calibrationPeriod = RCOSC_CALIBRATION_PERIOD;
+
+// Time of the last measurement of the drift
+static uint64_t lastMeasureTime;
+
+// Counters, odd statsGen while they change. Written by the clock Swi and
+// by the wake-up notification, which never preempt each other.
+static rcoscStats_t stats;
+static volatile uint16_t statsGen = 0;
+
 /*********************************************************************
  * LOCAL FUNCTIONS
  */
@@ -80,6 +121,10 @@ static uint8_t rcosc_injectCalibrationPostNotify(uint8_t eventType,
                                                  uint32_t *eventArg,
                                                  uint32_t *clientArg);
 
+static int32_t rcosc_readFreqError(void);
+static void rcosc_measure(void);
+static uint16_t rcosc_scaClass(uint32_t ppm);
+
 /*********************************************************************
  * PUBLIC FUNCTIONS
  */
@@ -89,21 +134,33 @@ static uint8_t rcosc_injectCalibrationPostNotify(uint8_t eventType,
  *
  * @brief   enable calibration.  calibration timer will start immediately.
  *
- * @param   none
+ * @param   syncEvent - event handle of the application task
+ * @param   scaEvent  - event posted when the measured sleep clock accuracy
+ *                      changes
  *
  * @return  none
  */
-void RCOSC_enableCalibration(void)
+void RCOSC_enableCalibration(ICall_SyncHandle syncEvent, uint32_t scaEvent)
 {
   if (!isEnabled)
   {
     isEnabled = TRUE;
 
-    // Set device's Sleep Clock Accuracy
+    scaSyncEvent = syncEvent;
+    scaUpdateEvent = scaEvent;
+
+    // Set device's Sleep Clock Accuracy, the worst case until measured
 #if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
-    HCI_EXT_SetSCACmd(500);
+    HCI_EXT_SetSCACmd(RCOSC_SCA_WORST);
 #endif // (CENTRAL_CFG | PERIPHERAL_CFG)
 
+    // Reference for the first measurement
+    stats.freqError = rcosc_readFreqError();
+    stats.temperature = AONBatMonTemperatureGetDegC();
+    stats.period = calibrationPeriod;
+    stats.sca = RCOSC_SCA_WORST;
+    lastMeasureTime = Timebase_now();
+
     // Create RCOSC clock - one-shot clock for calibration injections.
     Util_constructClock(&injectCalibrationClock,
                         rcosc_injectCalibrationClockHandler,
@@ -116,14 +173,64 @@ void RCOSC_enableCalibration(void)
 
 
     // Start clock for the RCOSC calibration injection.  Calibration must be
-    // done once every second by either the clock or by waking up from StandyBy
-    // Mode. To ensure that the device is always correctly calibrated the clock
-    // is started now but is only allowed to expire when a wake up event does
-    // not occur within the clock's duration.
+    // done once every calibration interval by either the clock or by waking up
+    // from StandyBy Mode. To ensure that the device is always correctly
+    // calibrated the clock is started now but is only allowed to expire when a
+    // wake up event does not occur within the clock's duration.
     Util_startClock(&injectCalibrationClock);
   }
 }
 
+/*********************************************************************
+ * @fn      RCOSC_processScaUpdate
+ *
+ * @brief   Declare the measured sleep clock accuracy to the stack when it
+ *          changed. Called by the application task.
+ *
+ * @param   notConnected - TRUE if no connection is up
+ *
+ * @return  none
+ */
+void RCOSC_processScaUpdate(uint8_t notConnected)
+{
+  uint16_t sca = stats.sca;
+
+  // Done again when the connection ends
+  if (!notConnected || (sca == scaInForce))
+  {
+    return;
+  }
+
+#if ( HOST_CONFIG & ( CENTRAL_CFG | PERIPHERAL_CFG ) )
+  if (HCI_EXT_SetSCACmd(sca) == SUCCESS)
+  {
+    scaInForce = sca;
+  }
+#endif // (CENTRAL_CFG | PERIPHERAL_CFG)
+}
+
+/*********************************************************************
+ * @fn      RCOSC_getStats
+ *
+ * @brief   Get the calibration counters. May be called by any task.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+void RCOSC_getStats(rcoscStats_t *pStats)
+{
+  uint16_t gen;
+
+  do
+  {
+    gen = statsGen;
+    *pStats = stats;
+  } while ((gen & 1) || (gen != statsGen));
+
+  pStats->scaInForce = scaInForce;
+}
+
 /*********************************************************************
  * @fn      rcosc_injectCalibrationClockHandler
  *
@@ -136,8 +243,14 @@ void RCOSC_enableCalibration(void)
  */
 static void rcosc_injectCalibrationClockHandler(UArg arg)
 {
+  statsGen++;
+  stats.numInjected++;
+  statsGen++;
+
+  rcosc_measure();
+
   // Restart clock.
-  Util_startClock(&injectCalibrationClock);
+  Util_restartClock(&injectCalibrationClock, calibrationPeriod);
 
   // Inject calibration.
   PowerCC26XX_injectCalibration();
@@ -157,17 +270,150 @@ static uint8_t rcosc_injectCalibrationPostNotify(uint8_t eventType,
                                                  uint32_t *eventArg,
                                                  uint32_t *clientArg)
 {
-  // If clock is active at time of wake up,
-  if (Util_isActive(&injectCalibrationClock))
-  {
-    // Stop injection of calibration - the wakeup has automatically done this.
-    Util_stopClock(&injectCalibrationClock);
-  }
+  statsGen++;
+  stats.numWakeups++;
+  statsGen++;
 
+  rcosc_measure();
+
+  // Stop injection of calibration - the wakeup has automatically done this.
   // Restart the clock in case delta between now and next wake up is greater
-  // than one second.
-  Util_startClock(&injectCalibrationClock);
+  // than the calibration interval.
+  Util_restartClock(&injectCalibrationClock, calibrationPeriod);
 
   return Power_NOTIFYDONE;
 }
+
+/*********************************************************************
+ * @fn      rcosc_readFreqError
+ *
+ * @brief   Frequency error of the RCOSC_LF found by the last calibration,
+ *          from the RTC increment the power driver set to make up for it.
+ *
+ * @param   none
+ *
+ * @return  error in ppm, positive when the oscillator is fast
+ */
+static int32_t rcosc_readFreqError(void)
+{
+  int32_t subSecInc = HWREG(AON_RTC_BASE + AON_RTC_O_SUBSECINC) &
+                      AON_RTC_SUBSECINC_VALUEINC_M;
+
+  // A fast oscillator needs a smaller increment
+  return (int32_t)(((int64_t)(RCOSC_SUBSECINC_NOMINAL - subSecInc) * 1000000) /
+                   RCOSC_SUBSECINC_NOMINAL);
+}
+
+/*********************************************************************
+ * @fn      rcosc_measure
+ *
+ * @brief   Measure the drift of the oscillator once per calibration
+ *          interval and adapt the interval to it. Runs in the clock Swi
+ *          or in the wake-up notification.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+static void rcosc_measure(void)
+{
+  int32_t freqError;
+  int32_t temperature;
+  uint32_t drift;
+  uint32_t tempStep;
+  uint16_t peakDrift;
+  uint16_t sca;
+
+  // Calibrations of a busy device lie too close together to see a drift;
+  // the clock may expire a little short of a full interval of the RTC
+  if (Timebase_msSince(lastMeasureTime) < calibrationPeriod / 2)
+  {
+    return;
+  }
+  lastMeasureTime = Timebase_now();
+
+  freqError = rcosc_readFreqError();
+  temperature = AONBatMonTemperatureGetDegC();
+  drift = abs(freqError - stats.freqError);
+  tempStep = abs(temperature - stats.temperature);
+
+  statsGen++;
+
+  if ((drift > RCOSC_DRIFT_TARGET) || (tempStep >= RCOSC_TEMP_STEP))
+  {
+    if (calibrationPeriod > RCOSC_CALIBRATION_PERIOD)
+    {
+      calibrationPeriod = RCOSC_CALIBRATION_PERIOD;
+      stats.numShortened++;
+    }
+  }
+  else if ((drift * 2 <= RCOSC_DRIFT_TARGET) &&
+           (calibrationPeriod < RCOSC_CALIBRATION_PERIOD_MAX))
+  {
+    // The drift of twice the interval is still below the target
+    calibrationPeriod *= 2;
+    stats.numLengthened++;
+  }
+
+  stats.freqError = freqError;
+  stats.drift = (drift > 0xFFFF) ? 0xFFFF : drift;
+  stats.temperature = temperature;
+  stats.period = calibrationPeriod;
+
+  // Largest drift of the last one or two windows, an old excursion is
+  // forgotten after two windows
+  if (stats.drift > windowPeak)
+  {
+    windowPeak = stats.drift;
+  }
+  if (++numWindowMeasures >= RCOSC_SCA_WINDOW)
+  {
+    lastWindowPeak = windowPeak;
+    windowPeak = 0;
+    numWindowMeasures = 0;
+    isScaMeasured = TRUE;
+  }
+  peakDrift = MAX(windowPeak, lastWindowPeak);
+  stats.peakDrift = peakDrift;
+
+  sca = stats.sca;
+  if (isScaMeasured)
+  {
+    stats.sca = rcosc_scaClass((uint32_t)peakDrift + RCOSC_SCA_MARGIN);
+  }
+
+  statsGen++;
+
+  // An accuracy that changes in a connection is declared when it ends
+  if (stats.sca != sca)
+  {
+    Event_post(scaSyncEvent, scaUpdateEvent);
+  }
+}
+
+/*********************************************************************
+ * @fn      rcosc_scaClass
+ *
+ * @brief   Round a sleep clock accuracy up to the Bluetooth class that
+ *          covers it.
+ *
+ * @param   ppm - accuracy needed, in ppm
+ *
+ * @return  accuracy of the class, in ppm
+ */
+static uint16_t rcosc_scaClass(uint32_t ppm)
+{
+  static const uint16_t scaClasses[] = { 20, 30, 50, 75, 100, 150, 250 };
+  uint8_t i;
+
+  for (i = 0; i < sizeof(scaClasses) / sizeof(scaClasses[0]); i++)
+  {
+    if (ppm <= scaClasses[i])
+    {
+      return scaClasses[i];
+    }
+  }
+
+  return RCOSC_SCA_WORST;
+}
 #endif //USE_RCOSC
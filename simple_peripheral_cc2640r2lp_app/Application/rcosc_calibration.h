@@ -5,6 +5,26 @@
  @brief This file contains the RCOSC calibration routines definitions
         and prototypes.
 
+        A wake-up from standby calibrates the RCOSC_LF; the calibration
+        clock only injects one when the device sleeps for longer than the
+        calibration interval. The interval starts at
+        RCOSC_CALIBRATION_PERIOD and doubles, up to
+        RCOSC_CALIBRATION_PERIOD_MAX, while the oscillator drifts less than
+        RCOSC_DRIFT_TARGET / 2 between two measurements. More drift than
+        RCOSC_DRIFT_TARGET, or a temperature change of RCOSC_TEMP_STEP,
+        brings the shortest interval back.
+
+        The drift is read from the RTC increment the power driver sets from
+        each calibration, the frequency of the RCOSC_LF it measured.
+
+        The sleep clock accuracy declared to the stack starts at the worst
+        case of 500 ppm. Once RCOSC_SCA_WINDOW measurements are in, it is
+        the largest drift of the last one or two windows plus
+        RCOSC_SCA_MARGIN, rounded up to a Bluetooth accuracy class. The
+        stack only takes a new accuracy outside a connection, so a change
+        is handed to the application task, which applies it with
+        RCOSC_processScaUpdate while no link is up.
+
  Group: WCS, BTS
  Target Device: cc2640r2
 
@@ -56,15 +76,60 @@ extern "C"
 /*********************************************************************
  * INCLUDES
  */
+#include <stdint.h>
+
+#include <icall.h>
 
 
 /*********************************************************************
  * CONSTANTS
  */
 
-// 1000 ms
+// 1000 ms, the shortest interval
 #define RCOSC_CALIBRATION_PERIOD              1000
 
+// 16000 ms, the longest interval
+#define RCOSC_CALIBRATION_PERIOD_MAX          16000
+
+// Drift of the RCOSC_LF between two measurements the interval keeps under,
+// in ppm
+#define RCOSC_DRIFT_TARGET                    10
+
+// Temperature change that brings the shortest interval back, in degC
+#define RCOSC_TEMP_STEP                       2
+
+// Measurements the largest drift is taken over
+#define RCOSC_SCA_WINDOW                      64
+
+// Accuracy declared on top of the largest drift, in ppm
+#define RCOSC_SCA_MARGIN                      100
+
+// Accuracy before anything is measured, in ppm
+#define RCOSC_SCA_WORST                       500
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t numInjected;   // Calibrations injected by the calibration clock
+  uint32_t numWakeups;    // Calibrations done by wake-ups from standby
+  uint32_t numLengthened; // Interval doubled, the oscillator was stable
+  uint32_t numShortened;  // Interval cut back on drift or temperature
+  int32_t  freqError;     // RCOSC_LF frequency error of the last
+                          // calibration, in ppm (positive when fast)
+  uint16_t drift;         // Change of freqError at the last measurement,
+                          // in ppm
+  uint16_t period;        // Calibration interval in force, in ms
+  uint16_t peakDrift;     // Largest drift of the last one or two windows,
+                          // in ppm
+  uint16_t sca;           // Sleep clock accuracy the drift supports, in ppm
+  uint16_t scaInForce;    // Sleep clock accuracy declared to the stack,
+                          // in ppm
+  int8_t   temperature;   // Temperature at the last measurement, in degC
+} rcoscStats_t;
+
 /*********************************************************************
  * FUNCTIONS
  */
@@ -74,11 +139,39 @@ extern "C"
  *
  * @brief   enable calibration.  calibration timer will start immediately.
  *
- * @param   none
+ * @param   syncEvent - event handle of the application task
+ * @param   scaEvent  - event posted when the measured sleep clock accuracy
+ *                      changes
+ *
+ * @return  none
+ */
+extern void RCOSC_enableCalibration(ICall_SyncHandle syncEvent,
+                                    uint32_t scaEvent);
+
+/*********************************************************************
+ * @fn      RCOSC_processScaUpdate
+ *
+ * @brief   Declare the measured sleep clock accuracy to the stack when it
+ *          changed. Called by the application task on the event given to
+ *          RCOSC_enableCalibration and when a connection ends.
+ *
+ * @param   notConnected - TRUE if no connection is up, the stack refuses
+ *                         a new accuracy in a connection
+ *
+ * @return  none
+ */
+extern void RCOSC_processScaUpdate(uint8_t notConnected);
+
+/*********************************************************************
+ * @fn      RCOSC_getStats
+ *
+ * @brief   Get the calibration counters. May be called by any task.
+ *
+ * @param   pStats - filled with the counters
  *
  * @return  none
  */
-extern void RCOSC_enableCalibration(void);
+extern void RCOSC_getStats(rcoscStats_t *pStats);
 
 
 #ifdef __cplusplus
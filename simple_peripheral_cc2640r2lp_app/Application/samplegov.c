@@ -0,0 +1,266 @@
+/******************************************************************************
+
+ @file  samplegov.c
+
+ @brief Sampling rate governor of the sensor task.
+
+        The counters are written by the sensor task and read by the
+        others: the writer bumps statsGen before and after changing stats,
+        a reader copies them again when statsGen was odd or moved during
+        its copy. A reset is only requested by the other tasks and carried
+        out by the sensor task at its next sample.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <driverlib/aon_batmon.h>
+
+#include "timebase.h"
+#include "samplegov.h"
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// SAMPLEGOV_STATE_*
+static uint8_t state = SAMPLEGOV_STATE_ACTIVE;
+
+// TRUE while the battery cap is in force
+static uint8_t lowBattery = FALSE;
+
+// Time of the last sample above the noise threshold
+static uint64_t lastSoundTime;
+
+// Time of the last update, the time since then is counted to state
+static uint64_t lastUpdateTime;
+
+// Counters, odd statsGen while they change
+static sampleGovStats_t stats;
+static volatile uint16_t statsGen = 0;
+static volatile uint8_t resetRequested = FALSE;
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      SampleGov_init
+ *
+ * @brief   Start in the active state. Called by the sensor task.
+ *
+ * @param   pConfig - configuration in force
+ *
+ * @return  sample period to start with, in ms
+ */
+uint16_t SampleGov_init(const devConfig_t *pConfig)
+{
+  state = SAMPLEGOV_STATE_ACTIVE;
+  lastSoundTime = Timebase_now();
+  lastUpdateTime = lastSoundTime;
+
+  statsGen++;
+  memset(&stats, 0, sizeof(stats));
+  stats.period = pConfig->samplePeriod;
+  statsGen++;
+
+  return stats.period;
+}
+
+/*********************************************************************
+ * @fn      SampleGov_update
+ *
+ * @brief   Account for a level sample and choose the period until the
+ *          next one. Called by the sensor task after every sample.
+ *
+ * @param   level   - amplitude of the sample
+ * @param   pConfig - configuration in force
+ * @param   live    - TRUE while a central is subscribed to the live stream
+ *
+ * @return  sample period, in ms
+ */
+uint16_t SampleGov_update(uint16_t level, const devConfig_t *pConfig,
+                          uint8_t live)
+{
+  uint64_t now = Timebase_now();
+  uint16_t battery = AONBatMonBatteryVoltageGet();
+  uint16_t period;
+
+  statsGen++;
+
+  if (resetRequested)
+  {
+    memset(&stats, 0, sizeof(stats));
+    resetRequested = FALSE;
+  }
+
+  stats.stateTime[state] += Timebase_toMs(now - lastUpdateTime);
+  stats.stateSamples[state]++;
+  lastUpdateTime = now;
+
+  // Hysteresis so the cap does not toggle with the load of the radio
+  if (battery < SAMPLEGOV_LOW_BATTERY)
+  {
+    lowBattery = TRUE;
+  }
+  else if (battery > SAMPLEGOV_BATTERY_OK)
+  {
+    lowBattery = FALSE;
+  }
+
+  if (level > pConfig->noiseThreshold)
+  {
+    lastSoundTime = now;
+  }
+
+  // A central watching the live level gets the configured period
+  if ((level > pConfig->noiseThreshold) || live)
+  {
+    if (state == SAMPLEGOV_STATE_QUIET)
+    {
+      state = SAMPLEGOV_STATE_ACTIVE;
+      stats.numRampUps++;
+    }
+  }
+  else if ((state == SAMPLEGOV_STATE_ACTIVE) &&
+           (Timebase_msSince(lastSoundTime) >= SAMPLEGOV_QUIET_AFTER))
+  {
+    state = SAMPLEGOV_STATE_QUIET;
+    stats.numRampDowns++;
+  }
+
+  period = pConfig->samplePeriod;
+  if ((state == SAMPLEGOV_STATE_QUIET) && (period < SAMPLEGOV_QUIET_PERIOD))
+  {
+    period = SAMPLEGOV_QUIET_PERIOD;
+  }
+  if (lowBattery && (period < SAMPLEGOV_LOW_BATTERY_PERIOD))
+  {
+    period = SAMPLEGOV_LOW_BATTERY_PERIOD;
+    stats.numCapped++;
+  }
+  stats.period = period;
+
+  statsGen++;
+
+  return period;
+}
+
+/*********************************************************************
+ * @fn      SampleGov_getSilence
+ *
+ * @brief   Time since the last sample above the noise threshold. Called
+ *          by the sensor task.
+ *
+ * @param   none
+ *
+ * @return  time in ms, 0xFFFFFFFF if longer than that
+ */
+uint32_t SampleGov_getSilence(void)
+{
+  return Timebase_msSince(lastSoundTime);
+}
+
+/*********************************************************************
+ * @fn      SampleGov_sleep
+ *
+ * @brief   Enter the idle state, sampling has stopped. Called by the
+ *          sensor task.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void SampleGov_sleep(void)
+{
+  uint64_t now = Timebase_now();
+
+  statsGen++;
+  stats.stateTime[state] += Timebase_toMs(now - lastUpdateTime);
+  stats.period = 0;
+  statsGen++;
+
+  lastUpdateTime = now;
+  state = SAMPLEGOV_STATE_IDLE;
+}
+
+/*********************************************************************
+ * @fn      SampleGov_wake
+ *
+ * @brief   Leave the idle state for the active one. Called by the sensor
+ *          task before sampling again.
+ *
+ * @param   pConfig - configuration in force
+ *
+ * @return  sample period to start with, in ms
+ */
+uint16_t SampleGov_wake(const devConfig_t *pConfig)
+{
+  uint64_t now = Timebase_now();
+
+  statsGen++;
+  stats.stateTime[state] += Timebase_toMs(now - lastUpdateTime);
+  stats.period = pConfig->samplePeriod;
+  statsGen++;
+
+  // Woken by a sound, or by the wearer: hear what follows at full rate
+  lastUpdateTime = now;
+  lastSoundTime = now;
+  state = SAMPLEGOV_STATE_ACTIVE;
+
+  return pConfig->samplePeriod;
+}
+
+/*********************************************************************
+ * @fn      SampleGov_getStats
+ *
+ * @brief   Get the rate transition and duty cycle counters. May be called
+ *          by any task.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+void SampleGov_getStats(sampleGovStats_t *pStats)
+{
+  uint16_t gen;
+  uint64_t totalTime;
+  uint64_t totalSamples;
+  uint8_t i;
+
+  do
+  {
+    gen = statsGen;
+    *pStats = stats;
+  } while ((gen & 1) || (gen != statsGen));
+
+  totalTime = 0;
+  totalSamples = 0;
+  for (i = 0; i < SAMPLEGOV_NUM_STATES; i++)
+  {
+    totalTime += pStats->stateTime[i];
+    totalSamples += pStats->stateSamples[i];
+  }
+
+  pStats->samplesPerMin = totalTime ? (uint16_t)(totalSamples * 60000 / totalTime) : 0;
+}
+
+/*********************************************************************
+ * @fn      SampleGov_resetStats
+ *
+ * @brief   Clear the counters. May be called by any task.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void SampleGov_resetStats(void)
+{
+  resetRequested = TRUE;
+}
+
+/*********************************************************************
+*********************************************************************/
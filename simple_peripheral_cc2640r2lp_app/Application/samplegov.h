@@ -0,0 +1,177 @@
+/******************************************************************************
+
+ @file  samplegov.h
+
+ @brief Sampling rate governor of the sensor task.
+
+        The level is sampled at the period of the device configuration
+        while there is sound. After SAMPLEGOV_QUIET_AFTER ms without a
+        sample above the noise threshold the governor drops to
+        SAMPLEGOV_QUIET_PERIOD; the first sample above the threshold brings
+        the configured period back, the next sample is taken one configured
+        period later. While the level is streamed live the configured
+        period is held: a central watching the level sees it at the rate
+        it asked for.
+
+        While the battery is below SAMPLEGOV_LOW_BATTERY the period is never
+        shorter than SAMPLEGOV_LOW_BATTERY_PERIOD. The cap is lifted once
+        the battery is back above SAMPLEGOV_BATTERY_OK.
+
+        When the sensor task stops sampling for the wake-on-sound idle
+        (wake.h) the governor is put to sleep; the time until it is woken
+        is counted to the idle state.
+
+        The governor counts the time spent and the samples taken at each
+        rate, so the sampling cost can be compared with the activity.
+
+ *****************************************************************************/
+
+#ifndef SAMPLEGOV_H
+#define SAMPLEGOV_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include "devconfig.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Governor states
+#define SAMPLEGOV_STATE_ACTIVE        0 // Configured period
+#define SAMPLEGOV_STATE_QUIET         1 // SAMPLEGOV_QUIET_PERIOD
+#define SAMPLEGOV_STATE_IDLE          2 // Not sampling, waiting for a sound
+#define SAMPLEGOV_NUM_STATES          3
+
+// Silence before the quiet rate, in ms
+#define SAMPLEGOV_QUIET_AFTER         30000
+
+// Sample period in silence, in ms (a multiple of 10 the live stream can
+// carry)
+#define SAMPLEGOV_QUIET_PERIOD        2000
+
+// Battery voltages of the cap, in 1/256 V (2.7 V and 2.8 V)
+#define SAMPLEGOV_LOW_BATTERY         0x2B3
+#define SAMPLEGOV_BATTERY_OK          0x2CD
+
+// Shortest sample period while the battery is low, in ms
+#define SAMPLEGOV_LOW_BATTERY_PERIOD  500
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint32_t stateTime[SAMPLEGOV_NUM_STATES];    // ms spent in each state
+  uint32_t stateSamples[SAMPLEGOV_NUM_STATES]; // Samples taken in each state
+  uint32_t numRampUps;    // Quiet to active transitions
+  uint32_t numRampDowns;  // Active to quiet transitions
+  uint32_t numCapped;     // Samples taken with the battery cap in force
+  uint16_t samplesPerMin; // Samples per minute since the counters were
+                          // cleared, the duty cycle of the sensor task
+  uint16_t period;        // Sample period in force, in ms
+} sampleGovStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      SampleGov_init
+ *
+ * @brief   Start in the active state. Called by the sensor task.
+ *
+ * @param   pConfig - configuration in force
+ *
+ * @return  sample period to start with, in ms
+ */
+extern uint16_t SampleGov_init(const devConfig_t *pConfig);
+
+/*********************************************************************
+ * @fn      SampleGov_update
+ *
+ * @brief   Account for a level sample and choose the period until the
+ *          next one. Called by the sensor task after every sample.
+ *
+ * @param   level   - amplitude of the sample
+ * @param   pConfig - configuration in force
+ * @param   live    - TRUE while a central is subscribed to the live stream
+ *
+ * @return  sample period, in ms
+ */
+extern uint16_t SampleGov_update(uint16_t level, const devConfig_t *pConfig,
+                                 uint8_t live);
+
+/*********************************************************************
+ * @fn      SampleGov_getSilence
+ *
+ * @brief   Time since the last sample above the noise threshold. Called
+ *          by the sensor task.
+ *
+ * @param   none
+ *
+ * @return  time in ms, 0xFFFFFFFF if longer than that
+ */
+extern uint32_t SampleGov_getSilence(void);
+
+/*********************************************************************
+ * @fn      SampleGov_sleep
+ *
+ * @brief   Enter the idle state, sampling has stopped. Called by the
+ *          sensor task.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void SampleGov_sleep(void);
+
+/*********************************************************************
+ * @fn      SampleGov_wake
+ *
+ * @brief   Leave the idle state for the active one. Called by the sensor
+ *          task before sampling again.
+ *
+ * @param   pConfig - configuration in force
+ *
+ * @return  sample period to start with, in ms
+ */
+extern uint16_t SampleGov_wake(const devConfig_t *pConfig);
+
+/*********************************************************************
+ * @fn      SampleGov_getStats
+ *
+ * @brief   Get the rate transition and duty cycle counters. May be called
+ *          by any task.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+extern void SampleGov_getStats(sampleGovStats_t *pStats);
+
+/*********************************************************************
+ * @fn      SampleGov_resetStats
+ *
+ * @brief   Clear the counters. May be called by any task.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void SampleGov_resetStats(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SAMPLEGOV_H */
@@ -0,0 +1,241 @@
+/**********************************************************************************************
+ * Filename:       currentTime.c
+ *
+ * Description:    This file contains the implementation of the Current Time
+ *                 service.
+ *
+ *************************************************************************************************/
+
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <icall.h>
+
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "currenttime.h"
+#include "gatt_decl.h"
+#include "gattdb.h"
+#include "walltime.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+#if CURRENTTIME_TIME_LEN != WALLTIME_CTS_LEN
+#error "CURRENTTIME_TIME_LEN must be the length of the walltime.h value"
+#endif
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Position of the characteristic value in the attribute table
+#define CURRENTTIME_TIME_VALUE_IDX  2
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+* GLOBAL VARIABLES
+*/
+
+// currentTime Service UUID
+CONST uint8_t currentTimeUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16(CURRENTTIME_SERV_UUID), HI_UINT16(CURRENTTIME_SERV_UUID)
+};
+
+// Current Time UUID
+CONST uint8_t currentTime_TimeUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16(CURRENTTIME_TIME_UUID), HI_UINT16(CURRENTTIME_TIME_UUID)
+};
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static currentTimeCBs_t *pAppCBs = NULL;
+
+/*********************************************************************
+* Profile Attributes - variables
+*/
+
+// Service declaration
+static CONST gattAttrType_t currentTimeDecl = { ATT_BT_UUID_SIZE, currentTimeUUID };
+
+// Characteristic "Current Time" Properties (for declaration)
+static CONST uint8_t currentTime_TimeProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Characteristic "Current Time" Value variable, built again for every read
+static uint8_t currentTime_TimeVal[CURRENTTIME_TIME_LEN] = {0};
+
+/*********************************************************************
+* Profile Attributes - Table
+*/
+
+static gattAttribute_t currentTimeAttrTbl[] =
+{
+  // currentTime Service Declaration
+  GATT_DECL_PRIMARY_SERVICE( &currentTimeDecl ),
+    // Current Time Characteristic Declaration
+    GATT_DECL_CHAR( &currentTime_TimeProps ),
+      // Current Time Characteristic Value
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, currentTime_TimeUUID,
+                       GATT_PERMIT_READ | GATT_PERMIT_WRITE, currentTime_TimeVal ),
+};
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static bStatus_t currentTime_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                         uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                         uint16_t maxLen, uint8_t method );
+static bStatus_t currentTime_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                          uint8_t *pValue, uint16_t len, uint16_t offset,
+                                          uint8_t method );
+
+/*********************************************************************
+ * PROFILE CALLBACKS
+ */
+// Current Time Service Callbacks
+CONST gattServiceCBs_t currentTimeCBs =
+{
+  currentTime_ReadAttrCB,  // Read callback function pointer
+  currentTime_WriteAttrCB, // Write callback function pointer
+  NULL                     // Authorization callback function pointer
+};
+
+/*********************************************************************
+* PUBLIC FUNCTIONS
+*/
+
+/*
+ * CurrentTime_AddService- Initializes the CurrentTime service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+bStatus_t CurrentTime_AddService( uint8_t rspTaskId )
+{
+  uint8_t status;
+
+  // Register GATT attribute list and CBs with GATT Server Application
+  status = GATTServApp_RegisterService( currentTimeAttrTbl,
+                                        GATT_NUM_ATTRS( currentTimeAttrTbl ),
+                                        GATT_MAX_ENCRYPT_KEY_SIZE,
+                                        &currentTimeCBs );
+  if ( status == SUCCESS )
+  {
+    // Part of the layout bonded centrals cache
+    GattDb_addService( currentTimeAttrTbl, GATT_NUM_ATTRS( currentTimeAttrTbl ) );
+  }
+
+  return ( status );
+}
+
+/*
+ * CurrentTime_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+bStatus_t CurrentTime_RegisterAppCBs( currentTimeCBs_t *appCallbacks )
+{
+  if ( appCallbacks )
+  {
+    pAppCBs = appCallbacks;
+
+    return ( SUCCESS );
+  }
+  else
+  {
+    return ( bleAlreadyInRequestedMode );
+  }
+}
+
+
+/*********************************************************************
+ * @fn          currentTime_ReadAttrCB
+ *
+ * @brief       Read an attribute.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       pValue - pointer to data to be read
+ * @param       pLen - length of data to be read
+ * @param       offset - offset of the first octet to be read
+ * @param       maxLen - maximum length of data to be read
+ * @param       method - type of read message
+ *
+ * @return      SUCCESS, blePending or Failure
+ */
+static bStatus_t currentTime_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                         uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                         uint16_t maxLen, uint8_t method )
+{
+  if ( GATT_ATTR_IDX( pAttr, currentTimeAttrTbl ) != CURRENTTIME_TIME_VALUE_IDX )
+  {
+    *pLen = 0;
+    return ( ATT_ERR_ATTR_NOT_FOUND );
+  }
+
+  if ( offset > 0 )
+  {
+    // The value fits in the smallest ATT_MTU, a blob read would mix two times
+    return ( ATT_ERR_ATTR_NOT_LONG );
+  }
+
+  WallTime_build( currentTime_TimeVal );
+
+  *pLen = MIN(maxLen, CURRENTTIME_TIME_LEN);
+  memcpy(pValue, currentTime_TimeVal, *pLen);
+
+  return ( SUCCESS );
+}
+
+
+/*********************************************************************
+ * @fn      currentTime_WriteAttrCB
+ *
+ * @brief   Validate attribute data prior to a write operation
+ *
+ * @param   connHandle - connection message was received on
+ * @param   pAttr - pointer to attribute
+ * @param   pValue - pointer to data to be written
+ * @param   len - length of data
+ * @param   offset - offset of the first octet to be written
+ * @param   method - type of write message
+ *
+ * @return  SUCCESS, blePending or Failure
+ */
+static bStatus_t currentTime_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                          uint8_t *pValue, uint16_t len, uint16_t offset,
+                                          uint8_t method )
+{
+  if ( GATT_ATTR_IDX( pAttr, currentTimeAttrTbl ) != CURRENTTIME_TIME_VALUE_IDX )
+  {
+    return ( ATT_ERR_ATTR_NOT_FOUND );
+  }
+
+  if ( offset > 0 )
+  {
+    return ( ATT_ERR_ATTR_NOT_LONG );
+  }
+
+  // Data field ignored: the time of the watch stays as it was
+  if ( ! WallTime_validate( pValue, len ) )
+  {
+    return ( ATT_ERR_INVALID_VALUE );
+  }
+
+  if ( pAppCBs && pAppCBs->pfnChangeCb )
+    pAppCBs->pfnChangeCb(connHandle, CURRENTTIME_TIME_ID, len, pValue); // Call app function from stack task context.
+
+  return ( SUCCESS );
+}
@@ -0,0 +1,86 @@
+/**********************************************************************************************
+ * Filename:       currentTime.h
+ *
+ * Description:    This file contains the Current Time service definitions and
+ *                 prototypes.
+ *
+ *                 The service carries the wall clock time of the watch:
+ *                   Current Time - read gives the time of the watch, write
+ *                                  sets it (value defined in walltime.h)
+ *
+ *************************************************************************************************/
+
+
+#ifndef _CURRENTTIME_H_
+#define _CURRENTTIME_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+
+#include <bcomdef.h>
+
+/*********************************************************************
+* CONSTANTS
+*/
+// Service UUID, Bluetooth SIG Current Time Service
+#define CURRENTTIME_SERV_UUID 0x1805
+
+//  Characteristic defines
+#define CURRENTTIME_TIME_ID   0
+#define CURRENTTIME_TIME_UUID 0x2A2B
+#define CURRENTTIME_TIME_LEN  10
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * Profile Callbacks
+ */
+
+// Callback when a characteristic value has changed
+typedef void (*currentTimeChange_t)(uint16_t connHandle, uint8_t paramID, uint16_t len, uint8_t *pValue);
+
+typedef struct
+{
+  currentTimeChange_t    pfnChangeCb;     // Called when the Current Time is written
+} currentTimeCBs_t;
+
+/*********************************************************************
+ * API FUNCTIONS
+ */
+
+
+/*
+ * CurrentTime_AddService- Initializes the CurrentTime service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+extern bStatus_t CurrentTime_AddService( uint8_t rspTaskId);
+
+/*
+ * CurrentTime_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+extern bStatus_t CurrentTime_RegisterAppCBs( currentTimeCBs_t *appCallbacks );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _CURRENTTIME_H_ */
@@ -0,0 +1,101 @@
+/**********************************************************************************************
+ * Filename:       gatt_decl.h
+ *
+ * Description:    Declarative attribute table entries for the services of the
+ *                 application.
+ *
+ *                 A service is written as a list of the entries below. Their
+ *                 types, permissions and the pointers to the properties,
+ *                 descriptions and service declaration are fixed at compile
+ *                 time, those can point to CONST data kept in flash; only the
+ *                 characteristic values and the CCC tables stay in RAM. The
+ *                 attribute table itself is in RAM because the GATT server
+ *                 fills in the handles when the service is registered.
+ *
+ *                 The GATT server hands the read and write callbacks a
+ *                 pointer into the registered table, so the position of the
+ *                 attribute, GATT_ATTR_IDX, identifies the characteristic
+ *                 without looking at its UUID. Services name the positions
+ *                 of their entries with <SERVICE>_<CHAR>_VALUE_IDX defines and
+ *                 dispatch on them with a switch.
+ *
+ *************************************************************************************************/
+
+#ifndef _GATT_DECL_H_
+#define _GATT_DECL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+
+#include <bcomdef.h>
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*
+ * GATT_DECL_PRIMARY_SERVICE - Primary service declaration.
+ *
+ *    pDecl - pointer to the CONST gattAttrType_t of the service UUID
+ */
+#define GATT_DECL_PRIMARY_SERVICE( pDecl ) \
+  { { ATT_BT_UUID_SIZE, primaryServiceUUID }, GATT_PERMIT_READ, 0, (uint8 *)(pDecl) }
+
+/*
+ * GATT_DECL_CHAR - Characteristic declaration.
+ *
+ *    pProps - pointer to the CONST properties byte
+ */
+#define GATT_DECL_CHAR( pProps ) \
+  { { ATT_BT_UUID_SIZE, characterUUID }, GATT_PERMIT_READ, 0, (uint8 *)(pProps) }
+
+/*
+ * GATT_DECL_VALUE - Characteristic value.
+ *
+ *    uuidLen - ATT_BT_UUID_SIZE or ATT_UUID_SIZE
+ *    pUUID   - pointer to the UUID
+ *    perms   - GATT_PERMIT_* permissions
+ *    pValue  - pointer to the value
+ */
+#define GATT_DECL_VALUE( uuidLen, pUUID, perms, pValue ) \
+  { { (uuidLen), (pUUID) }, (perms), 0, (uint8 *)(pValue) }
+
+/*
+ * GATT_DECL_CCC - Client Characteristic Configuration.
+ *
+ *    ppCfg - pointer to the pointer of the gattCharCfg_t table
+ */
+#define GATT_DECL_CCC( ppCfg ) \
+  { { ATT_BT_UUID_SIZE, clientCharCfgUUID }, GATT_PERMIT_READ | GATT_PERMIT_WRITE, 0, (uint8 *)(ppCfg) }
+
+/*
+ * GATT_DECL_USER_DESC - Characteristic User Description.
+ *
+ *    pDesc - pointer to the CONST, null terminated description
+ */
+#define GATT_DECL_USER_DESC( pDesc ) \
+  { { ATT_BT_UUID_SIZE, charUserDescUUID }, GATT_PERMIT_READ, 0, (uint8 *)(pDesc) }
+
+/*
+ * GATT_ATTR_IDX - Position of an attribute in the registered table of its
+ *                 service; also its handle minus the handle of the service.
+ *
+ *    pAttr    - attribute passed to a read or write callback
+ *    attrTbl  - attribute table of the service
+ */
+#define GATT_ATTR_IDX( pAttr, attrTbl )  ( (uint16_t)( (pAttr) - (attrTbl) ) )
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _GATT_DECL_H_ */
@@ -0,0 +1,324 @@
+/**********************************************************************************************
+ * Filename:       liveLevel.c
+ *
+ * Description:    This file contains the implementation of the Live Level
+ *                 service.
+ *
+ *************************************************************************************************/
+
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <icall.h>
+
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "livelevel.h"
+#include "gatt_decl.h"
+#include "gattdb.h"
+#include "gattservapp_util.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Position of the attributes in the attribute table
+#define LIVELEVEL_LEVEL_VALUE_IDX  2
+#define LIVELEVEL_LEVEL_CCC_IDX    3
+#define LIVELEVEL_ALERT_VALUE_IDX  5
+#define LIVELEVEL_ALERT_CCC_IDX    6
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+* GLOBAL VARIABLES
+*/
+
+// liveLevel Service UUID
+CONST uint8_t liveLevelUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16(LIVELEVEL_SERV_UUID), HI_UINT16(LIVELEVEL_SERV_UUID)
+};
+
+// Level UUID
+CONST uint8_t liveLevel_LevelUUID[ATT_UUID_SIZE] =
+{
+  TI_BASE_UUID_128(LIVELEVEL_LEVEL_UUID)
+};
+
+// Alert UUID
+CONST uint8_t liveLevel_AlertUUID[ATT_UUID_SIZE] =
+{
+  TI_BASE_UUID_128(LIVELEVEL_ALERT_UUID)
+};
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static liveLevelCBs_t *pAppCBs = NULL;
+
+/*********************************************************************
+* Profile Attributes - variables
+*/
+
+// Service declaration
+static CONST gattAttrType_t liveLevelDecl = { ATT_BT_UUID_SIZE, liveLevelUUID };
+
+// Characteristic "Level" Properties (for declaration)
+static CONST uint8_t liveLevel_LevelProps = GATT_PROP_NOTIFY;
+
+// Characteristic "Level" Value variable, samples are only sent as notifications
+static uint8_t liveLevel_LevelVal = 0;
+
+// Characteristic "Level" CCC
+static gattCharCfg_t *liveLevel_LevelConfig;
+
+// Characteristic "Alert" Properties (for declaration)
+static CONST uint8_t liveLevel_AlertProps = GATT_PROP_NOTIFY;
+
+// Characteristic "Alert" Value variable, alerts are only sent as notifications
+static uint8_t liveLevel_AlertVal = 0;
+
+// Characteristic "Alert" CCC
+static gattCharCfg_t *liveLevel_AlertConfig;
+
+/*********************************************************************
+* Profile Attributes - Table
+*/
+
+static gattAttribute_t liveLevelAttrTbl[] =
+{
+  // liveLevel Service Declaration
+  GATT_DECL_PRIMARY_SERVICE( &liveLevelDecl ),
+    // Level Characteristic Declaration
+    GATT_DECL_CHAR( &liveLevel_LevelProps ),
+      // Level Characteristic Value
+      GATT_DECL_VALUE( ATT_UUID_SIZE, liveLevel_LevelUUID, 0, &liveLevel_LevelVal ),
+      // Level CCCD
+      GATT_DECL_CCC( &liveLevel_LevelConfig ),
+    // Alert Characteristic Declaration
+    GATT_DECL_CHAR( &liveLevel_AlertProps ),
+      // Alert Characteristic Value
+      GATT_DECL_VALUE( ATT_UUID_SIZE, liveLevel_AlertUUID, 0, &liveLevel_AlertVal ),
+      // Alert CCCD
+      GATT_DECL_CCC( &liveLevel_AlertConfig ),
+};
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static bStatus_t liveLevel_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                       uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                       uint16_t maxLen, uint8_t method );
+static bStatus_t liveLevel_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                        uint8_t *pValue, uint16_t len, uint16_t offset,
+                                        uint8_t method );
+
+/*********************************************************************
+ * PROFILE CALLBACKS
+ */
+// Live Level Service Callbacks
+CONST gattServiceCBs_t liveLevelCBs =
+{
+  liveLevel_ReadAttrCB,  // Read callback function pointer
+  liveLevel_WriteAttrCB, // Write callback function pointer
+  NULL                   // Authorization callback function pointer
+};
+
+/*********************************************************************
+* PUBLIC FUNCTIONS
+*/
+
+/*
+ * LiveLevel_AddService- Initializes the LiveLevel service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+bStatus_t LiveLevel_AddService( uint8_t rspTaskId )
+{
+  uint8_t status;
+
+  // Allocate Client Characteristic Configuration tables
+  liveLevel_LevelConfig = (gattCharCfg_t *)ICall_malloc( sizeof(gattCharCfg_t) * linkDBNumConns );
+  if ( liveLevel_LevelConfig == NULL )
+  {
+    return ( bleMemAllocError );
+  }
+
+  liveLevel_AlertConfig = (gattCharCfg_t *)ICall_malloc( sizeof(gattCharCfg_t) * linkDBNumConns );
+  if ( liveLevel_AlertConfig == NULL )
+  {
+    ICall_free( liveLevel_LevelConfig );
+    return ( bleMemAllocError );
+  }
+
+  // Initialize Client Characteristic Configuration attributes
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, liveLevel_LevelConfig );
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, liveLevel_AlertConfig );
+
+  // Register GATT attribute list and CBs with GATT Server Application
+  status = GATTServApp_RegisterService( liveLevelAttrTbl,
+                                        GATT_NUM_ATTRS( liveLevelAttrTbl ),
+                                        GATT_MAX_ENCRYPT_KEY_SIZE,
+                                        &liveLevelCBs );
+  if ( status == SUCCESS )
+  {
+    // Part of the layout bonded centrals cache
+    GattDb_addService( liveLevelAttrTbl, GATT_NUM_ATTRS( liveLevelAttrTbl ) );
+  }
+
+  return ( status );
+}
+
+/*
+ * LiveLevel_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+bStatus_t LiveLevel_RegisterAppCBs( liveLevelCBs_t *appCallbacks )
+{
+  if ( appCallbacks )
+  {
+    pAppCBs = appCallbacks;
+
+    return ( SUCCESS );
+  }
+  else
+  {
+    return ( bleAlreadyInRequestedMode );
+  }
+}
+
+/*
+ * LiveLevel_IsNotifyEnabled - Check if a central has enabled notifications
+ *          of the Level characteristic.
+ *
+ *    connHandle - connection handle of the central
+ */
+uint8_t LiveLevel_IsNotifyEnabled( uint16_t connHandle )
+{
+  return ( (GATTServApp_ReadCharCfg( connHandle, liveLevel_LevelConfig ) &
+            GATT_CLIENT_CFG_NOTIFY) != 0 );
+}
+
+/*
+ * LiveLevel_NotifyEncode - Send a Level notification encoded straight into
+ *          the stack buffer.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes
+ */
+bStatus_t LiveLevel_NotifyEncode( uint16_t connHandle, liveLevelEncode_t pfnEncode )
+{
+  return ( GATTServApp_NotifyEncode( connHandle, liveLevel_LevelConfig,
+                                     &liveLevelAttrTbl[LIVELEVEL_LEVEL_VALUE_IDX],
+                                     pfnEncode ) );
+}
+
+/*
+ * LiveLevel_AlertEncode - Send an Alert notification encoded straight into
+ *          the stack buffer.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes
+ */
+bStatus_t LiveLevel_AlertEncode( uint16_t connHandle, liveLevelEncode_t pfnEncode )
+{
+  return ( GATTServApp_NotifyEncode( connHandle, liveLevel_AlertConfig,
+                                     &liveLevelAttrTbl[LIVELEVEL_ALERT_VALUE_IDX],
+                                     pfnEncode ) );
+}
+
+
+/*********************************************************************
+ * @fn          liveLevel_ReadAttrCB
+ *
+ * @brief       Read an attribute.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       pValue - pointer to data to be read
+ * @param       pLen - length of data to be read
+ * @param       offset - offset of the first octet to be read
+ * @param       maxLen - maximum length of data to be read
+ * @param       method - type of read message
+ *
+ * @return      SUCCESS, blePending or Failure
+ */
+static bStatus_t liveLevel_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                       uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                       uint16_t maxLen, uint8_t method )
+{
+  // The Level and Alert characteristics are notify only
+  *pLen = 0;
+
+  return ( ATT_ERR_ATTR_NOT_FOUND );
+}
+
+
+/*********************************************************************
+ * @fn      liveLevel_WriteAttrCB
+ *
+ * @brief   Validate attribute data prior to a write operation
+ *
+ * @param   connHandle - connection message was received on
+ * @param   pAttr - pointer to attribute
+ * @param   pValue - pointer to data to be written
+ * @param   len - length of data
+ * @param   offset - offset of the first octet to be written
+ * @param   method - type of write message
+ *
+ * @return  SUCCESS, blePending or Failure
+ */
+static bStatus_t liveLevel_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                        uint8_t *pValue, uint16_t len, uint16_t offset,
+                                        uint8_t method )
+{
+  bStatus_t status = SUCCESS;
+  uint8_t paramID = 0xFF;
+
+  // See if request is regarding a Client Characterisic Configuration
+  switch ( GATT_ATTR_IDX( pAttr, liveLevelAttrTbl ) )
+  {
+    case LIVELEVEL_LEVEL_CCC_IDX:
+      paramID = LIVELEVEL_LEVEL_ID;
+      break;
+
+    case LIVELEVEL_ALERT_CCC_IDX:
+      paramID = LIVELEVEL_ALERT_ID;
+      break;
+
+    default:
+      break;
+  }
+
+  if ( paramID != 0xFF )
+  {
+    // Allow only notifications.
+    status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
+                                             offset, GATT_CLIENT_CFG_NOTIFY);
+    if ( status == SUCCESS && pAppCBs && pAppCBs->pfnCfgChangeCb )
+    {
+      pAppCBs->pfnCfgChangeCb(connHandle, paramID, len, pValue); // Call app function from stack task context.
+    }
+  }
+  else
+  {
+    // The Level and Alert characteristics have no writable value
+    status = ATT_ERR_ATTR_NOT_FOUND;
+  }
+
+  return status;
+}
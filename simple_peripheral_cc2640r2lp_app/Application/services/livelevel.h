@@ -0,0 +1,130 @@
+/**********************************************************************************************
+ * Filename:       liveLevel.h
+ *
+ * Description:    This file contains the Live Level service definitions and
+ *                 prototypes.
+ *
+ *                 The service streams the sound level as it is measured:
+ *                   Level - notifications carrying packed level samples,
+ *                           sent while the central is subscribed
+ *                   Alert - a notification [time u32][level u16] when the
+ *                           level exceeds the doctor threshold, time in
+ *                           seconds as in the log
+ *
+ *************************************************************************************************/
+
+
+#ifndef _LIVELEVEL_H_
+#define _LIVELEVEL_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+
+#include <bcomdef.h>
+
+/*********************************************************************
+* CONSTANTS
+*/
+// Service UUID
+#define LIVELEVEL_SERV_UUID 0xAC00
+
+//  Characteristic defines
+#define LIVELEVEL_LEVEL_ID   0
+#define LIVELEVEL_LEVEL_UUID 0xAC01
+#define LIVELEVEL_ALERT_ID   1
+#define LIVELEVEL_ALERT_UUID 0xAC02
+#define LIVELEVEL_ALERT_LEN  6
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * Profile Callbacks
+ */
+
+// Callback when a characteristic configuration has changed
+typedef void (*liveLevelChange_t)(uint16_t connHandle, uint8_t paramID, uint16_t len, uint8_t *pValue);
+
+typedef struct
+{
+  liveLevelChange_t      pfnCfgChangeCb;  // Called when the Level or Alert CCC is written
+} liveLevelCBs_t;
+
+// Encoder writing a Level or Alert notification in place, returns the length written
+// (0 to send nothing)
+typedef uint16_t (*liveLevelEncode_t)(uint8_t *pBuf, uint16_t maxLen);
+
+/*********************************************************************
+ * API FUNCTIONS
+ */
+
+
+/*
+ * LiveLevel_AddService- Initializes the LiveLevel service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+extern bStatus_t LiveLevel_AddService( uint8_t rspTaskId);
+
+/*
+ * LiveLevel_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+extern bStatus_t LiveLevel_RegisterAppCBs( liveLevelCBs_t *appCallbacks );
+
+/*
+ * LiveLevel_IsNotifyEnabled - Check if a central has enabled notifications
+ *          of the Level characteristic.
+ *
+ *    connHandle - connection handle of the central
+ */
+extern uint8_t LiveLevel_IsNotifyEnabled(uint16_t connHandle);
+
+/*
+ * LiveLevel_NotifyEncode - Send a Level notification encoded straight into
+ *          the stack buffer.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes. It is not
+ *                called when no buffer could be allocated.
+ *
+ *    Returns SUCCESS, or the GATT status (e.g. blePending,
+ *    MSG_BUFFER_NOT_AVAIL) when the payload could not be queued.
+ */
+extern bStatus_t LiveLevel_NotifyEncode(uint16_t connHandle, liveLevelEncode_t pfnEncode);
+
+/*
+ * LiveLevel_AlertEncode - Send an Alert notification encoded straight into
+ *          the stack buffer.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes. It is not
+ *                called when no buffer could be allocated.
+ *
+ *    Returns SUCCESS, bleIncorrectMode when the central has not enabled
+ *    the notifications, or the GATT status (e.g. blePending,
+ *    MSG_BUFFER_NOT_AVAIL) when the payload could not be queued.
+ */
+extern bStatus_t LiveLevel_AlertEncode(uint16_t connHandle, liveLevelEncode_t pfnEncode);
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LIVELEVEL_H_ */
@@ -0,0 +1,397 @@
+/**********************************************************************************************
+ * Filename:       logXfer.c
+ *
+ * Description:    This file contains the implementation of the Log Transfer
+ *                 service.
+ *
+ *************************************************************************************************/
+
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <icall.h>
+
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "logxfer.h"
+#include "gatt_decl.h"
+#include "gattdb.h"
+#include "gattservapp_util.h"
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Position of the attributes in the attribute table
+#define LOGXFER_DATA_VALUE_IDX     2
+#define LOGXFER_DATA_CCC_IDX       3
+#define LOGXFER_CONTROL_VALUE_IDX  5
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+* GLOBAL VARIABLES
+*/
+
+// logXfer Service UUID
+CONST uint8_t logXferUUID[ATT_BT_UUID_SIZE] =
+{
+  LO_UINT16(LOGXFER_SERV_UUID), HI_UINT16(LOGXFER_SERV_UUID)
+};
+
+// Data UUID
+CONST uint8_t logXfer_DataUUID[ATT_UUID_SIZE] =
+{
+  TI_BASE_UUID_128(LOGXFER_DATA_UUID)
+};
+
+// Control UUID
+CONST uint8_t logXfer_ControlUUID[ATT_UUID_SIZE] =
+{
+  TI_BASE_UUID_128(LOGXFER_CONTROL_UUID)
+};
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static logXferCBs_t *pAppCBs = NULL;
+
+/*********************************************************************
+* Profile Attributes - variables
+*/
+
+// Service declaration
+static CONST gattAttrType_t logXferDecl = { ATT_BT_UUID_SIZE, logXferUUID };
+
+// Characteristic "Data" Properties (for declaration)
+static CONST uint8_t logXfer_DataProps = GATT_PROP_NOTIFY;
+
+// Characteristic "Data" Value variable, records are only sent as notifications
+static uint8_t logXfer_DataVal = 0;
+
+// Characteristic "Data" CCC
+static gattCharCfg_t *logXfer_DataConfig;
+
+// Characteristic "Control" Properties (for declaration)
+static CONST uint8_t logXfer_ControlProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Characteristic "Control" Value variable, holds the log state for reads
+static uint8_t logXfer_ControlVal[LOGXFER_CONTROL_LEN] = {0};
+
+// Length of the "Control" value
+static uint16_t logXfer_ControlValLen = 0;
+
+/*********************************************************************
+* Profile Attributes - Table
+*/
+
+static gattAttribute_t logXferAttrTbl[] =
+{
+  // logXfer Service Declaration
+  GATT_DECL_PRIMARY_SERVICE( &logXferDecl ),
+    // Data Characteristic Declaration
+    GATT_DECL_CHAR( &logXfer_DataProps ),
+      // Data Characteristic Value
+      GATT_DECL_VALUE( ATT_UUID_SIZE, logXfer_DataUUID, 0, &logXfer_DataVal ),
+      // Data CCCD
+      GATT_DECL_CCC( &logXfer_DataConfig ),
+    // Control Characteristic Declaration
+    GATT_DECL_CHAR( &logXfer_ControlProps ),
+      // Control Characteristic Value
+      GATT_DECL_VALUE( ATT_UUID_SIZE, logXfer_ControlUUID,
+                       GATT_PERMIT_READ | GATT_PERMIT_WRITE, logXfer_ControlVal ),
+};
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static bStatus_t logXfer_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                     uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                     uint16_t maxLen, uint8_t method );
+static bStatus_t logXfer_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                      uint8_t *pValue, uint16_t len, uint16_t offset,
+                                      uint8_t method );
+
+/*********************************************************************
+ * PROFILE CALLBACKS
+ */
+// Log Transfer Service Callbacks
+CONST gattServiceCBs_t logXferCBs =
+{
+  logXfer_ReadAttrCB,  // Read callback function pointer
+  logXfer_WriteAttrCB, // Write callback function pointer
+  NULL                 // Authorization callback function pointer
+};
+
+/*********************************************************************
+* PUBLIC FUNCTIONS
+*/
+
+/*
+ * LogXfer_AddService- Initializes the LogXfer service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+bStatus_t LogXfer_AddService( uint8_t rspTaskId )
+{
+  uint8_t status;
+
+  // Allocate Client Characteristic Configuration table
+  logXfer_DataConfig = (gattCharCfg_t *)ICall_malloc( sizeof(gattCharCfg_t) * linkDBNumConns );
+  if ( logXfer_DataConfig == NULL )
+  {
+    return ( bleMemAllocError );
+  }
+
+  // Initialize Client Characteristic Configuration attributes
+  GATTServApp_InitCharCfg( INVALID_CONNHANDLE, logXfer_DataConfig );
+
+  // Register GATT attribute list and CBs with GATT Server Application
+  status = GATTServApp_RegisterService( logXferAttrTbl,
+                                        GATT_NUM_ATTRS( logXferAttrTbl ),
+                                        GATT_MAX_ENCRYPT_KEY_SIZE,
+                                        &logXferCBs );
+  if ( status == SUCCESS )
+  {
+    // Part of the layout bonded centrals cache
+    GattDb_addService( logXferAttrTbl, GATT_NUM_ATTRS( logXferAttrTbl ) );
+  }
+
+  return ( status );
+}
+
+/*
+ * LogXfer_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+bStatus_t LogXfer_RegisterAppCBs( logXferCBs_t *appCallbacks )
+{
+  if ( appCallbacks )
+  {
+    pAppCBs = appCallbacks;
+
+    return ( SUCCESS );
+  }
+  else
+  {
+    return ( bleAlreadyInRequestedMode );
+  }
+}
+
+/*
+ * LogXfer_SetParameter - Set a LogXfer parameter.
+ *
+ *    param - Profile parameter ID
+ *    len - length of data to write
+ *    value - pointer to data to write.
+ */
+bStatus_t LogXfer_SetParameter( uint8_t param, uint16_t len, void *value )
+{
+  bStatus_t ret = SUCCESS;
+  switch ( param )
+  {
+    case LOGXFER_CONTROL_ID:
+      if ( len <= LOGXFER_CONTROL_LEN )
+      {
+        memcpy(logXfer_ControlVal, value, len);
+        logXfer_ControlValLen = len;
+      }
+      else
+      {
+        ret = bleInvalidRange;
+      }
+      break;
+
+    default:
+      ret = INVALIDPARAMETER;
+      break;
+  }
+  return ret;
+}
+
+/*
+ * LogXfer_IsNotifyEnabled - Check if a central has enabled notifications
+ *          of the Data characteristic.
+ *
+ *    connHandle - connection handle of the central
+ */
+uint8_t LogXfer_IsNotifyEnabled( uint16_t connHandle )
+{
+  return ( (GATTServApp_ReadCharCfg( connHandle, logXfer_DataConfig ) &
+            GATT_CLIENT_CFG_NOTIFY) != 0 );
+}
+
+/*
+ * LogXfer_Notify - Send a Data notification.
+ *
+ *    connHandle - connection handle of the central
+ *    pData - payload, at most ATT_MTU - 3 bytes
+ *    len - length of the payload
+ */
+bStatus_t LogXfer_Notify( uint16_t connHandle, uint8_t *pData, uint16_t len )
+{
+  attHandleValueNoti_t noti;
+  bStatus_t status;
+
+  if ( !LogXfer_IsNotifyEnabled( connHandle ) )
+  {
+    return ( bleIncorrectMode );
+  }
+
+  noti.pValue = (uint8 *)GATT_bm_alloc( connHandle, ATT_HANDLE_VALUE_NOTI,
+                                        len, NULL );
+  if ( noti.pValue == NULL )
+  {
+    return ( MSG_BUFFER_NOT_AVAIL );
+  }
+
+  memcpy( noti.pValue, pData, len );
+  noti.len = len;
+  noti.handle = logXferAttrTbl[LOGXFER_DATA_VALUE_IDX].handle;
+
+  status = GATT_Notification( connHandle, &noti, FALSE );
+  if ( status != SUCCESS )
+  {
+    GATT_bm_free( (gattMsg_t *)&noti, ATT_HANDLE_VALUE_NOTI );
+  }
+
+  return ( status );
+}
+
+/*
+ * LogXfer_NotifyEncode - Send a Data notification encoded straight into
+ *          the stack buffer, without an intermediate copy.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes
+ */
+bStatus_t LogXfer_NotifyEncode( uint16_t connHandle, logXferEncode_t pfnEncode )
+{
+  return ( GATTServApp_NotifyEncode( connHandle, logXfer_DataConfig,
+                                     &logXferAttrTbl[LOGXFER_DATA_VALUE_IDX],
+                                     pfnEncode ) );
+}
+
+
+/*********************************************************************
+ * @fn          logXfer_ReadAttrCB
+ *
+ * @brief       Read an attribute.
+ *
+ * @param       connHandle - connection message was received on
+ * @param       pAttr - pointer to attribute
+ * @param       pValue - pointer to data to be read
+ * @param       pLen - length of data to be read
+ * @param       offset - offset of the first octet to be read
+ * @param       maxLen - maximum length of data to be read
+ * @param       method - type of read message
+ *
+ * @return      SUCCESS, blePending or Failure
+ */
+static bStatus_t logXfer_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                     uint8_t *pValue, uint16_t *pLen, uint16_t offset,
+                                     uint16_t maxLen, uint8_t method )
+{
+  bStatus_t status = SUCCESS;
+
+  // See if request is regarding the Control Characteristic Value
+  if ( GATT_ATTR_IDX( pAttr, logXferAttrTbl ) == LOGXFER_CONTROL_VALUE_IDX )
+  {
+    if ( offset > logXfer_ControlValLen )  // Prevent malicious ATT ReadBlob offsets.
+    {
+      status = ATT_ERR_INVALID_OFFSET;
+    }
+    else
+    {
+      *pLen = MIN(maxLen, logXfer_ControlValLen - offset);  // Transmit as much as possible
+      memcpy(pValue, pAttr->pValue + offset, *pLen);
+    }
+  }
+  else
+  {
+    // The Data characteristic is notify only
+    *pLen = 0;
+    status = ATT_ERR_ATTR_NOT_FOUND;
+  }
+
+  return status;
+}
+
+
+/*********************************************************************
+ * @fn      logXfer_WriteAttrCB
+ *
+ * @brief   Validate attribute data prior to a write operation
+ *
+ * @param   connHandle - connection message was received on
+ * @param   pAttr - pointer to attribute
+ * @param   pValue - pointer to data to be written
+ * @param   len - length of data
+ * @param   offset - offset of the first octet to be written
+ * @param   method - type of write message
+ *
+ * @return  SUCCESS, blePending or Failure
+ */
+static bStatus_t logXfer_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
+                                      uint8_t *pValue, uint16_t len, uint16_t offset,
+                                      uint8_t method )
+{
+  bStatus_t status  = SUCCESS;
+  uint8_t   paramID = 0xFF;
+
+  // See if request is regarding the Data Client Characterisic Configuration
+  if ( GATT_ATTR_IDX( pAttr, logXferAttrTbl ) == LOGXFER_DATA_CCC_IDX )
+  {
+    // Allow only notifications.
+    status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
+                                             offset, GATT_CLIENT_CFG_NOTIFY);
+    if ( status == SUCCESS && pAppCBs && pAppCBs->pfnCfgChangeCb )
+    {
+      pAppCBs->pfnCfgChangeCb(connHandle, LOGXFER_DATA_ID, len, pValue);
+    }
+  }
+  // See if request is regarding the Control Characteristic Value
+  else if ( GATT_ATTR_IDX( pAttr, logXferAttrTbl ) == LOGXFER_CONTROL_VALUE_IDX )
+  {
+    // Control operations are short, they are handled as one write
+    if ( offset != 0 )
+    {
+      status = ATT_ERR_ATTR_NOT_LONG;
+    }
+    else if ( len == 0 || len > LOGXFER_CONTROL_LEN )
+    {
+      status = ATT_ERR_INVALID_VALUE_SIZE;
+    }
+    else
+    {
+      paramID = LOGXFER_CONTROL_ID;
+    }
+  }
+  else
+  {
+    // If we get here, that means you've forgotten to add an if clause for a
+    // characteristic value attribute in the attribute table that has WRITE permissions.
+    status = ATT_ERR_ATTR_NOT_FOUND;
+  }
+
+  // Let the application know something changed (if it did) by using the
+  // callback it registered earlier (if it did).
+  if (paramID != 0xFF)
+    if ( pAppCBs && pAppCBs->pfnChangeCb )
+      pAppCBs->pfnChangeCb(connHandle, paramID, len, pValue); // Call app function from stack task context.
+
+  return status;
+}
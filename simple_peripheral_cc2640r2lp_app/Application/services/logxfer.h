@@ -0,0 +1,141 @@
+/**********************************************************************************************
+ * Filename:       logXfer.h
+ *
+ * Description:    This file contains the Log Transfer service definitions and
+ *                 prototypes.
+ *
+ *                 The service carries the flash log to a central:
+ *                   Data    - notifications carrying log records
+ *                   Control - written by the central to start, acknowledge
+ *                             and stop a transfer, read to get the log state
+ *
+ *************************************************************************************************/
+
+
+#ifndef _LOGXFER_H_
+#define _LOGXFER_H_
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+
+#include <bcomdef.h>
+
+/*********************************************************************
+* CONSTANTS
+*/
+// Service UUID
+#define LOGXFER_SERV_UUID 0xAB00
+
+//  Characteristic defines
+#define LOGXFER_DATA_ID   0
+#define LOGXFER_DATA_UUID 0xAB01
+
+//  Characteristic defines
+#define LOGXFER_CONTROL_ID   1
+#define LOGXFER_CONTROL_UUID 0xAB02
+#define LOGXFER_CONTROL_LEN  20
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+/*********************************************************************
+ * MACROS
+ */
+
+/*********************************************************************
+ * Profile Callbacks
+ */
+
+// Callback when a characteristic value has changed
+typedef void (*logXferChange_t)(uint16_t connHandle, uint8_t paramID, uint16_t len, uint8_t *pValue);
+
+typedef struct
+{
+  logXferChange_t        pfnChangeCb;     // Called when the Control characteristic is written
+  logXferChange_t        pfnCfgChangeCb;  // Called when the Data CCC is written
+} logXferCBs_t;
+
+// Encoder writing a Data notification in place, returns the length written
+// (0 to send nothing)
+typedef uint16_t (*logXferEncode_t)(uint8_t *pBuf, uint16_t maxLen);
+
+
+/*********************************************************************
+ * API FUNCTIONS
+ */
+
+
+/*
+ * LogXfer_AddService- Initializes the LogXfer service by registering
+ *          GATT attributes with the GATT server.
+ *
+ */
+extern bStatus_t LogXfer_AddService( uint8_t rspTaskId);
+
+/*
+ * LogXfer_RegisterAppCBs - Registers the application callback function.
+ *                    Only call this function once.
+ *
+ *    appCallbacks - pointer to application callbacks.
+ */
+extern bStatus_t LogXfer_RegisterAppCBs( logXferCBs_t *appCallbacks );
+
+/*
+ * LogXfer_SetParameter - Set a LogXfer parameter.
+ *
+ *    param - Profile parameter ID (only LOGXFER_CONTROL_ID, the value
+ *            returned when the central reads the Control characteristic)
+ *    len - length of data to write, at most LOGXFER_CONTROL_LEN
+ *    value - pointer to data to write.
+ */
+extern bStatus_t LogXfer_SetParameter(uint8_t param, uint16_t len, void *value);
+
+/*
+ * LogXfer_IsNotifyEnabled - Check if a central has enabled notifications
+ *          of the Data characteristic.
+ *
+ *    connHandle - connection handle of the central
+ */
+extern uint8_t LogXfer_IsNotifyEnabled(uint16_t connHandle);
+
+/*
+ * LogXfer_Notify - Send a Data notification.
+ *
+ *    connHandle - connection handle of the central
+ *    pData - payload, at most ATT_MTU - 3 bytes
+ *    len - length of the payload
+ *
+ *    Returns SUCCESS, or the GATT status (e.g. blePending,
+ *    MSG_BUFFER_NOT_AVAIL) when the payload could not be queued.
+ */
+extern bStatus_t LogXfer_Notify(uint16_t connHandle, uint8_t *pData, uint16_t len);
+
+/*
+ * LogXfer_NotifyEncode - Send a Data notification encoded straight into
+ *          the stack buffer, without an intermediate copy.
+ *
+ *    connHandle - connection handle of the central
+ *    pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes. It is not
+ *                called when no buffer could be allocated.
+ *
+ *    Returns SUCCESS, or the GATT status (e.g. blePending,
+ *    MSG_BUFFER_NOT_AVAIL) when the payload could not be queued. The
+ *    encoded payload is then dropped and has to be encoded again.
+ */
+extern bStatus_t LogXfer_NotifyEncode(uint16_t connHandle, logXferEncode_t pfnEncode);
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _LOGXFER_H_ */
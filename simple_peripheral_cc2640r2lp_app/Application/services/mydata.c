@@ -47,15 +47,26 @@
 #include "icall_ble_api.h"
 
 #include "myData.h"
+#include "gatt_decl.h"
+#include "gattdb.h"
+#include "devconfig.h"
 
 /*********************************************************************
  * MACROS
  */
 
+#if MYDATA_CONFIG_LEN != DEVCONFIG_LEN
+#error "MYDATA_CONFIG_LEN must be the length of the devconfig.h record"
+#endif
+
 /*********************************************************************
  * CONSTANTS
  */
 
+// Position of the characteristic values in the attribute table
+#define MYDATA_DATA_VALUE_IDX       2
+#define MYDATA_CONFIG_VALUE_IDX     4
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -70,10 +81,10 @@ CONST uint8_t myDataUUID[ATT_BT_UUID_SIZE] =
   LO_UINT16(MYDATA_SERV_UUID), HI_UINT16(MYDATA_SERV_UUID)
 };
 
-// threshold UUID
-CONST uint8_t myData_ThresholdUUID[ATT_UUID_SIZE] =
+// config UUID
+CONST uint8_t myData_ConfigUUID[ATT_UUID_SIZE] =
 {
-  TI_BASE_UUID_128(MYDATA_THRESHOLD_UUID)
+  TI_BASE_UUID_128(MYDATA_CONFIG_UUID)
 };
 
 // data UUID
@@ -95,14 +106,17 @@ static myDataCBs_t *pAppCBs = NULL;
 // Service declaration
 static CONST gattAttrType_t myDataDecl = { ATT_BT_UUID_SIZE, myDataUUID };
 
-// Characteristic "Threshold" Properties (for declaration)
-static uint8_t myData_ThresholdProps = GATT_PROP_WRITE;
+// Characteristic "Config" Properties (for declaration)
+static CONST uint8_t myData_ConfigProps = GATT_PROP_READ | GATT_PROP_WRITE;
+
+// Characteristic "Config" Value variable, the record in force
+static uint8_t myData_ConfigVal[MYDATA_CONFIG_LEN] = {0};
 
-// Characteristic "Threshold" Value variable
-static uint8_t myData_ThresholdVal[MYDATA_THRESHOLD_LEN] = {0};
+// Characteristic "Config" record being written, until it is complete
+static uint8_t myData_ConfigStage[MYDATA_CONFIG_LEN] = {0};
 
 // Characteristic "Data" Properties (for declaration)
-static uint8_t myData_DataProps = GATT_PROP_READ;
+static CONST uint8_t myData_DataProps = GATT_PROP_READ;
 
 // Characteristic "Data" Value variable
 static uint8_t myData_DataVal[MYDATA_DATA_LEN] = {0};
@@ -115,40 +129,17 @@ static uint8_t myData_DataVal[MYDATA_DATA_LEN] = {0};
 static gattAttribute_t myDataAttrTbl[] =
 {
   // myData Service Declaration
-  {
-    { ATT_BT_UUID_SIZE, primaryServiceUUID },
-    GATT_PERMIT_READ,
-    0,
-    (uint8_t *)&myDataDecl
-  },
+  GATT_DECL_PRIMARY_SERVICE( &myDataDecl ),
     // Data Characteristic Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &myData_DataProps
-    },
+    GATT_DECL_CHAR( &myData_DataProps ),
       // Data Characteristic Value
-      {
-        { ATT_UUID_SIZE, myData_DataUUID },
-        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-        0,
-        myData_DataVal
-      },
-      // Threshold Characteristic Declaration
-       {
-         { ATT_BT_UUID_SIZE, characterUUID },
-          GATT_PERMIT_READ,
-          0,
-          &myData_ThresholdProps
-        },
-         // Threshold Characteristic Value
-         {
-           { ATT_UUID_SIZE, myData_ThresholdUUID },
-           GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-            0,
-            myData_ThresholdVal
-         },
+      GATT_DECL_VALUE( ATT_UUID_SIZE, myData_DataUUID,
+                       GATT_PERMIT_READ | GATT_PERMIT_WRITE, myData_DataVal ),
+    // Config Characteristic Declaration
+    GATT_DECL_CHAR( &myData_ConfigProps ),
+      // Config Characteristic Value
+      GATT_DECL_VALUE( ATT_UUID_SIZE, myData_ConfigUUID,
+                       GATT_PERMIT_READ | GATT_PERMIT_WRITE, myData_ConfigVal ),
 };
 
 /*********************************************************************
@@ -160,6 +151,8 @@ static bStatus_t myData_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
 static bStatus_t myData_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
                                             uint8_t *pValue, uint16_t len, uint16_t offset,
                                             uint8_t method );
+static bStatus_t myData_WriteConfig( uint16_t connHandle, uint8_t *pValue,
+                                     uint16_t len, uint16_t offset, uint8_t method );
 
 /*********************************************************************
  * PROFILE CALLBACKS
@@ -197,6 +190,11 @@ extern bStatus_t MyData_AddService( uint8_t rspTaskId )
                                         GATT_NUM_ATTRS( myDataAttrTbl ),
                                         GATT_MAX_ENCRYPT_KEY_SIZE,
                                         &myDataCBs );
+  if ( status == SUCCESS )
+  {
+    // Part of the layout bonded centrals cache
+    GattDb_addService( myDataAttrTbl, GATT_NUM_ATTRS( myDataAttrTbl ) );
+  }
 
   return ( status );
 }
@@ -247,10 +245,10 @@ bStatus_t MyData_SetParameter( uint8_t param, uint16_t len, void *value )
       }
       break;
 
-    case MYDATA_THRESHOLD_ID:
-      if ( len == MYDATA_THRESHOLD_LEN )
+    case MYDATA_CONFIG_ID:
+      if ( len == MYDATA_CONFIG_LEN )
       {
-         memcpy(myData_ThresholdVal, value, len);
+         memcpy(myData_ConfigVal, value, len);
        }
        else
        {
@@ -280,8 +278,8 @@ bStatus_t MyData_GetParameter( uint8_t param, void *value )
   bStatus_t ret = SUCCESS;
   switch ( param )
   {
-  case MYDATA_THRESHOLD_ID:
-          memcpy(value, myData_ThresholdVal, MYDATA_THRESHOLD_LEN);
+  case MYDATA_CONFIG_ID:
+          memcpy(value, myData_ConfigVal, MYDATA_CONFIG_LEN);
           break;
   case MYDATA_DATA_ID:
       memcpy(value, myData_DataVal, MYDATA_DATA_LEN);
@@ -314,38 +312,33 @@ static bStatus_t myData_ReadAttrCB( uint16_t connHandle, gattAttribute_t *pAttr,
                                        uint16_t maxLen, uint8_t method )
 {
   bStatus_t status = SUCCESS;
+  uint16_t  valueLen;
 
-  // See if request is regarding the Data Characteristic Value
-if ( ! memcmp(pAttr->type.uuid, myData_DataUUID, pAttr->type.len) )
+  switch ( GATT_ATTR_IDX( pAttr, myDataAttrTbl ) )
   {
-    if ( offset > MYDATA_DATA_LEN )  // Prevent malicious ATT ReadBlob offsets.
-    {
-      status = ATT_ERR_INVALID_OFFSET;
-    }
-    else
-    {
-      *pLen = MIN(maxLen, MYDATA_DATA_LEN - offset);  // Transmit as much as possible
-      memcpy(pValue, pAttr->pValue + offset, *pLen);
-    }
+    case MYDATA_DATA_VALUE_IDX:
+      valueLen = MYDATA_DATA_LEN;
+      break;
+
+    case MYDATA_CONFIG_VALUE_IDX:
+      valueLen = MYDATA_CONFIG_LEN;
+      break;
+
+    default:
+      // If we get here, that means you've forgotten to add a case for a
+      // characteristic value attribute in the attribute table that has READ permissions.
+      *pLen = 0;
+      return ( ATT_ERR_ATTR_NOT_FOUND );
   }
-else if ( ! memcmp(pAttr->type.uuid, myData_ThresholdUUID, pAttr->type.len) )
+
+  if ( offset > valueLen )  // Prevent malicious ATT ReadBlob offsets.
   {
-    if ( offset > MYDATA_THRESHOLD_LEN )  // Prevent malicious ATT ReadBlob offsets.
-    {
-      status = ATT_ERR_INVALID_OFFSET;
-    }
-    else
-    {
-      *pLen = MIN(maxLen, MYDATA_THRESHOLD_LEN - offset);  // Transmit as much as possible
-      memcpy(pValue, pAttr->pValue + offset, *pLen);
-    }
+    status = ATT_ERR_INVALID_OFFSET;
   }
   else
   {
-    // If we get here, that means you've forgotten to add an if clause for a
-    // characteristic value attribute in the attribute table that has READ permissions.
-    *pLen = 0;
-    status = ATT_ERR_ATTR_NOT_FOUND;
+    *pLen = MIN(maxLen, valueLen - offset);  // Transmit as much as possible
+    memcpy(pValue, pAttr->pValue + offset, *pLen);
   }
 
   return status;
@@ -372,52 +365,33 @@ static bStatus_t myData_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr
 {
   bStatus_t status  = SUCCESS;
   uint8_t   paramID = 0xFF;
+  uint16_t  valueLen;
+
+  switch ( GATT_ATTR_IDX( pAttr, myDataAttrTbl ) )
+  {
+    case MYDATA_DATA_VALUE_IDX:
+      valueLen = MYDATA_DATA_LEN;
+      paramID  = MYDATA_DATA_ID;
+      break;
+
+    case MYDATA_CONFIG_VALUE_IDX:
+      return ( myData_WriteConfig( connHandle, pValue, len, offset, method ) );
 
-  // See if request is regarding a Client Characterisic Configuration
-  if ( ! memcmp(pAttr->type.uuid, clientCharCfgUUID, pAttr->type.len) )
+    default:
+      // If we get here, that means you've forgotten to add a case for a
+      // characteristic value attribute in the attribute table that has WRITE permissions.
+      return ( ATT_ERR_ATTR_NOT_FOUND );
+  }
+
+  if ( offset + len > valueLen )
   {
-    // Allow only notifications.
-    status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
-                                             offset, GATT_CLIENT_CFG_NOTIFY);
-    // See if request is regarding the Threshold Characteristic Value
-  }else if ( ! memcmp(pAttr->type.uuid, myData_ThresholdUUID, pAttr->type.len) )
-        {
-          if ( offset + len > MYDATA_THRESHOLD_LEN )
-          {
-            status = ATT_ERR_INVALID_OFFSET;
-          }
-          else
-          {
-            // Copy pValue into the variable we point to from the attribute table.
-            memcpy(pAttr->pValue + offset, pValue, len);
-
-            // Only notify application if entire expected value is written
-            if ( offset + len <= MYDATA_THRESHOLD_LEN)
-              paramID = MYDATA_THRESHOLD_ID;
-          }
-        }
-  else if (! memcmp(pAttr->type.uuid, myData_DataUUID, pAttr->type.len)) {
-      if ( offset + len > MYDATA_DATA_LEN )
-          {
-            status = ATT_ERR_INVALID_OFFSET;
-          }
-          else
-          {
-            // Copy pValue into the variable we point to from the attribute table.
-            memcpy(pAttr->pValue + offset, pValue, len);
-
-            // Only notify application if entire expected value is written
-            //if ( offset + len == MYDATA_DATA_LEN)
-            if (offset + len <= MYDATA_DATA_LEN){
-              paramID = MYDATA_DATA_ID;
-          }
-          }
+    status  = ATT_ERR_INVALID_OFFSET;
+    paramID = 0xFF;
   }
   else
   {
-    // If we get here, that means you've forgotten to add an if clause for a
-    // characteristic value attribute in the attribute table that has WRITE permissions.
-    status = ATT_ERR_ATTR_NOT_FOUND;
+    // Copy pValue into the variable we point to from the attribute table.
+    memcpy(pAttr->pValue + offset, pValue, len);
   }
 
   // Let the application know something changed (if it did) by using the
@@ -428,3 +402,49 @@ static bStatus_t myData_WriteAttrCB( uint16_t connHandle, gattAttribute_t *pAttr
 
   return status;
 }
+
+
+/*********************************************************************
+ * @fn      myData_WriteConfig
+ *
+ * @brief   Validate a write of the Config characteristic. The parts of a
+ *          long write are collected until the record is complete; a
+ *          complete record replaces the value and is passed on to the
+ *          application only if it is valid.
+ *
+ * @param   connHandle - connection message was received on
+ * @param   pValue - pointer to data to be written
+ * @param   len - length of data
+ * @param   offset - offset of the first octet to be written
+ * @param   method - type of write message
+ *
+ * @return  SUCCESS or Failure
+ */
+static bStatus_t myData_WriteConfig( uint16_t connHandle, uint8_t *pValue,
+                                     uint16_t len, uint16_t offset, uint8_t method )
+{
+  if ( offset + len > MYDATA_CONFIG_LEN )
+  {
+    return ( ATT_ERR_INVALID_OFFSET );
+  }
+
+  memcpy(myData_ConfigStage + offset, pValue, len);
+
+  if ( offset + len < MYDATA_CONFIG_LEN )
+  {
+    // Only the parts of a long write may be shorter than the record
+    return ( method == ATT_EXECUTE_WRITE_REQ ) ? SUCCESS : ATT_ERR_INVALID_VALUE_SIZE;
+  }
+
+  if ( ! DevConfig_validate( myData_ConfigStage, MYDATA_CONFIG_LEN ) )
+  {
+    return ( ATT_ERR_INVALID_VALUE );
+  }
+
+  memcpy(myData_ConfigVal, myData_ConfigStage, MYDATA_CONFIG_LEN);
+
+  if ( pAppCBs && pAppCBs->pfnChangeCb )
+    pAppCBs->pfnChangeCb(connHandle, MYDATA_CONFIG_ID, MYDATA_CONFIG_LEN, myData_ConfigVal); // Call app function from stack task context.
+
+  return ( SUCCESS );
+}
@@ -62,10 +62,11 @@ extern "C"
 #define MYDATA_DATA_UUID 0xAA01
 #define MYDATA_DATA_LEN  8
 
-//  Characteristic defines
-#define MYDATA_THRESHOLD_ID   1
-#define MYDATA_THRESHOLD_UUID 0xAA02
-#define MYDATA_THRESHOLD_LEN  8
+//  Characteristic defines, the value is the device configuration record
+//  of devconfig.h
+#define MYDATA_CONFIG_ID   1
+#define MYDATA_CONFIG_UUID 0xAA02
+#define MYDATA_CONFIG_LEN  10
 
 /*********************************************************************
  * TYPEDEFS
@@ -84,14 +84,23 @@
 #include "simple_peripheral.h"
 
 #include "services/mydata.h"
+#include "services/logxfer.h"
+#include "services/livelevel.h"
+#include "services/currenttime.h"
+#include "logsync.h"
+#include "datapump.h"
+#include "livestream.h"
+#include "adv_ctrl.h"
+#include "gattdb.h"
+#include "devconfig.h"
+#include "checkpoint.h"
+#include "timebase.h"
+#include "walltime.h"
 
 /*********************************************************************
  * CONSTANTS
  */
 
-// Advertising interval when device is discoverable (units of 625us, 160=100ms)
-#define DEFAULT_ADVERTISING_INTERVAL          160
-
 // General discoverable mode: advertise indefinitely
 #define DEFAULT_DISCOVERABLE_MODE             GAP_ADTYPE_FLAGS_GENERAL
 
@@ -150,16 +159,29 @@
 #define SBP_PASSCODE_NEEDED_EVT               0x0008
 #define SBP_CONN_EVT                          0x0010
 #define MY_DATA_EVT                           0x0012
+#define SBP_LOG_XFER_EVT                      0x0020
+#define SBP_LIVE_CFG_EVT                      0x0040
+#define SBP_CURRENT_TIME_EVT                  0x0080
 
 // Internal Events for RTOS application
 #define SBP_ICALL_EVT                         ICALL_MSG_EVENT_ID // Event_Id_31
 #define SBP_QUEUE_EVT                         UTIL_QUEUE_EVENT_ID // Event_Id_30
 #define SBP_PERIODIC_EVT                      Event_Id_00
+#define SBP_LOG_SYNC_EVT                      Event_Id_01
+#define SBP_LIVE_DATA_EVT                     Event_Id_02
+#define SBP_ADV_CTRL_EVT                      Event_Id_03
+#define SBP_CHECKPOINT_EVT                    Event_Id_04
+#define SBP_SCA_EVT                           Event_Id_05
 
 // Bitwise OR of all events to pend on
 #define SBP_ALL_EVENTS                        (SBP_ICALL_EVT        | \
                                                SBP_QUEUE_EVT        | \
-                                               SBP_PERIODIC_EVT)
+                                               SBP_PERIODIC_EVT     | \
+                                               SBP_LOG_SYNC_EVT     | \
+                                               SBP_LIVE_DATA_EVT    | \
+                                               SBP_ADV_CTRL_EVT     | \
+                                               SBP_CHECKPOINT_EVT   | \
+                                               SBP_SCA_EVT)
 
 
 // Set the register cause to the registration bit-mask
@@ -182,6 +204,13 @@ typedef struct
   uint8_t *pData;  // event data
 } sbpEvt_t;
 
+// Data of the pairing state and passcode events
+typedef struct
+{
+  uint16_t connHandle;  // Connection being paired
+  uint8_t  value;       // Pairing status, or passcode UI outputs
+} sbpPairData_t;
+
 /*********************************************************************
  * GLOBAL VARIABLES
  */
@@ -256,6 +285,7 @@ static uint8_t scanRspData[] =
 typedef struct
 {
   Queue_Elem _elem;
+  uint16_t connHandle;
   uint16_t svcUUID;
   uint16_t dataLen;
   uint8_t  paramID;
@@ -278,7 +308,11 @@ static uint8_t advertData[] =
   0x03,   // length of this data
   GAP_ADTYPE_16BIT_MORE,      // some of the UUID's, but not all
   LO_UINT16(SIMPLEPROFILE_SERV_UUID),
-  HI_UINT16(SIMPLEPROFILE_SERV_UUID)
+  HI_UINT16(SIMPLEPROFILE_SERV_UUID),
+
+  // status summary (level, last alert, battery) for scanners that do not
+  // connect, kept current by adv_ctrl
+  ADVCTRL_SUMMARY_AD
 };
 
 // GAP GATT Attributes
@@ -306,8 +340,10 @@ static void SimplePeripheral_passcodeCB(uint8_t *deviceAddr,
                                         uint32_t numComparison);
 static void SimplePeripheral_pairStateCB(uint16_t connHandle, uint8_t state,
                                          uint8_t status);
-static void SimplePeripheral_processPairState(uint8_t state, uint8_t status);
-static void SimplePeripheral_processPasscode(uint8_t uiOutputs);
+static void SimplePeripheral_processPairState(uint16_t connHandle,
+                                              uint8_t state, uint8_t status);
+static void SimplePeripheral_processPasscode(uint16_t connHandle,
+                                             uint8_t uiOutputs);
 
 static void SimplePeripheral_stateChangeCB(gaprole_States_t newState);
 static void SimplePeripheral_charValueChangeCB(uint8_t paramID);
@@ -319,11 +355,26 @@ static void SimplePeripheral_processConnEvt(Gap_ConnEventRpt_t *pReport);
 
 // Declaration of service callback handlers
 static void user_myDataValueChangeCB(uint16_t connHandle,
-                                     uint16_t svcUuid,
                                      uint8_t paramID,
                                      uint16_t len,
                                      uint8_t *pValue); // Callback from the service.
 static void user_myData_ValueChangeHandler(sbpEvt_t *pMsg); // Local handler called from the Task context of this task.
+static void user_logXferValueChangeCB(uint16_t connHandle,
+                                      uint8_t paramID,
+                                      uint16_t len,
+                                      uint8_t *pValue); // Callback from the service.
+static void user_logXferCfgChangeCB(uint16_t connHandle,
+                                    uint8_t paramID,
+                                    uint16_t len,
+                                    uint8_t *pValue); // Callback from the service.
+static void user_liveLevelCfgChangeCB(uint16_t connHandle,
+                                      uint8_t paramID,
+                                      uint16_t len,
+                                      uint8_t *pValue); // Callback from the service.
+static void user_currentTimeChangeCB(uint16_t connHandle,
+                                     uint8_t paramID,
+                                     uint16_t len,
+                                     uint8_t *pValue); // Callback from the service.
 //}
 
 
@@ -336,13 +387,32 @@ static myDataCBs_t user_myDataCBs =
  .pfnCfgChangeCb  = NULL,
 };
 
+// LogXfer callback handler. The type logXferCBs_t is defined in logxfer.h
+static logXferCBs_t user_logXferCBs =
+{
+ .pfnChangeCb = user_logXferValueChangeCB, // Control characteristic written
+ .pfnCfgChangeCb  = user_logXferCfgChangeCB, // Data CCC written
+};
+
+// LiveLevel callback handler. The type liveLevelCBs_t is defined in livelevel.h
+static liveLevelCBs_t user_liveLevelCBs =
+{
+ .pfnCfgChangeCb  = user_liveLevelCfgChangeCB, // Level or Alert CCC written
+};
+
+// CurrentTime callback handler. The type currentTimeCBs_t is defined in currenttime.h
+static currentTimeCBs_t user_currentTimeCBs =
+{
+ .pfnChangeCb = user_currentTimeChangeCB, // Current Time written
+};
+
 /*********************************************************************
  * EXTERN FUNCTIONS
  */
 extern void AssertHandler(uint8 assertCause, uint8 assertSubcause);
+extern void timeSetFxn(void);
 //uint16_t adc_value_spl;
 extern uint16_t adc_values[4];
-extern uint16_t doctor_threshold;
 extern uint16_t adc_value_spl;
 extern uint16_t adc_value_pitch;
 
@@ -384,12 +454,39 @@ typedef enum
    FOR_AOA_SCAN       = 1,
    FOR_ATT_RSP        = 2,
    FOR_AOA_SEND       = 4,
-   FOR_TOF_SEND       = 8
+   FOR_TOF_SEND       = 8,
+   FOR_DATA_PUMP      = 16
 }connectionEventRegisterCause_u;
 
 // Handle the registration and un-registration for the connection event, since only one can be registered.
 uint32_t       connectionEventRegisterCauseBitMap = NOT_REGISTER; //see connectionEventRegisterCause_u
 
+// Connections registered on their own to retry pending ATT responses (bit per connection handle)
+static uint8_t attRspConnEvtMask = 0;
+
+/*********************************************************************
+ * @fn      SimplePeripheral_retryAttRspNow()
+ *
+ * @brief   The connection events of a connection could not be registered
+ *          to retry its pending ATT responses: retry them at once, and
+ *          give up on those the stack still has no buffer for
+ *
+ * @param connHandle connection with pending ATT responses
+ *
+ * @return none
+ *
+ */
+static void SimplePeripheral_retryAttRspNow(uint16_t connHandle)
+{
+  attRspConnEvtMask &= ~(1 << connHandle);
+
+  if (attRsp_sendAttRsp(connHandle) != SUCCESS)
+  {
+    // Nothing would retry them, they are counted (attRsp_getNumDropped)
+    attRsp_dropAttRsp(connHandle);
+  }
+}
+
 /*********************************************************************
  * @fn      SimplePeripheral_RegistertToAllConnectionEvent()
  *
@@ -436,12 +533,107 @@ bStatus_t SimplePeripheral_UnRegistertToAllConnectionEvent (connectionEventRegis
   // in case  there is no more registration for the connection event than unregister
   if (!CONNECTION_EVENT_IS_REGISTERED)
   {
+    uint8_t i;
+
     GAP_RegisterConnEventCb(SimplePeripheral_connEvtCB, GAP_CB_UNREGISTER, LINKDB_CONNHANDLE_ALL);
+
+    // Keep the connections that still have ATT responses pending
+    for (i = 0; i < MAX_NUM_BLE_CONNS; i++)
+    {
+      if ((attRspConnEvtMask & (1 << i)) &&
+          (GAP_RegisterConnEventCb(SimplePeripheral_connEvtCB, GAP_CB_REGISTER, i) != SUCCESS))
+      {
+        SimplePeripheral_retryAttRspNow(i);
+      }
+    }
   }
 
   return(status);
 }
 
+/*********************************************************************
+ * @fn      SimplePeripheral_RegisterAttRspConnEvt()
+ *
+ * @brief   register to receive the connection events of one connection,
+ *          to retry its pending ATT responses
+ *
+ * @param connHandle connection with pending ATT responses
+ *
+ * @return @ref SUCCESS
+ *
+ */
+static bStatus_t SimplePeripheral_RegisterAttRspConnEvt(uint16_t connHandle)
+{
+  bStatus_t status = SUCCESS;
+
+  if (!(attRspConnEvtMask & (1 << connHandle)))
+  {
+    // the events of all the connections may already be received
+    if (!CONNECTION_EVENT_IS_REGISTERED)
+    {
+      status = GAP_RegisterConnEventCb(SimplePeripheral_connEvtCB, GAP_CB_REGISTER, connHandle);
+    }
+    if (status == SUCCESS)
+    {
+      attRspConnEvtMask |= (1 << connHandle);
+    }
+  }
+
+  return(status);
+}
+
+/*********************************************************************
+ * @fn      SimplePeripheral_UnRegisterAttRspConnEvt()
+ *
+ * @brief   Unregister the connection events of a connection that has no
+ *          ATT response pending anymore
+ *
+ * @param connHandle connection handle, LINKDB_CONNHANDLE_ALL for all
+ *
+ * @return none
+ *
+ */
+static void SimplePeripheral_UnRegisterAttRspConnEvt(uint16_t connHandle)
+{
+  if (connHandle == LINKDB_CONNHANDLE_ALL)
+  {
+    attRspConnEvtMask = 0;
+  }
+  else
+  {
+    attRspConnEvtMask &= ~(1 << connHandle);
+  }
+
+  // the events stay registered while an other cause needs all of them
+  if (!CONNECTION_EVENT_IS_REGISTERED)
+  {
+    GAP_RegisterConnEventCb(SimplePeripheral_connEvtCB, GAP_CB_UNREGISTER, connHandle);
+  }
+}
+
+/*********************************************************************
+ * @fn      SimplePeripheral_dataPumpRegister()
+ *
+ * @brief   Data pump callback, (un)register to the connection events
+ *          while a notification stream is active
+ *
+ * @param enable TRUE when the data pump needs the connection events
+ *
+ * @return none
+ *
+ */
+static void SimplePeripheral_dataPumpRegister(uint8_t enable)
+{
+  if (enable)
+  {
+    SimplePeripheral_RegistertToAllConnectionEvent(FOR_DATA_PUMP);
+  }
+  else
+  {
+    SimplePeripheral_UnRegistertToAllConnectionEvent(FOR_DATA_PUMP);
+  }
+}
+
  /*********************************************************************
  * @fn      SimplePeripheral_createTask
  *
@@ -486,7 +678,7 @@ static void SimplePeripheral_init(void)
   ICall_registerApp(&selfEntity, &syncEvent);
 
 #ifdef USE_RCOSC
-  RCOSC_enableCalibration();
+  RCOSC_enableCalibration(syncEvent, SBP_SCA_EVT);
 #endif // USE_RCOSC
 
 #if defined( USE_FPGA )
@@ -557,6 +749,7 @@ static void SimplePeripheral_init(void)
     GAPRole_SetParameter(GAPROLE_SCAN_RSP_DATA, sizeof(scanRspData),
                          scanRspData);
     GAPRole_SetParameter(GAPROLE_ADVERT_DATA, sizeof(advertData), advertData);
+    AdvCtrl_init(syncEvent, SBP_ADV_CTRL_EVT, advertData, sizeof(advertData));
 
     GAPRole_SetParameter(GAPROLE_PARAM_UPDATE_ENABLE, sizeof(uint8_t),
                          &enableUpdateRequest);
@@ -579,14 +772,12 @@ static void SimplePeripheral_init(void)
   // For more information, see the GAP section of the User's Guide:
   // http://software-dl.ti.com/lprf/sdg-latest/html
   {
-    // Use the same interval for general and limited advertising.
-    // Note that only general advertising will occur based on the above configuration
-    uint16_t advInt = DEFAULT_ADVERTISING_INTERVAL;
+    // Only general advertising will occur based on the above configuration.
+    // Its interval steps down from the fast one, see adv_ctrl.h.
+    uint16_t advInt = ADVCTRL_FAST_INTERVAL;
 
     GAP_SetParamValue(TGAP_LIM_DISC_ADV_INT_MIN, advInt);
     GAP_SetParamValue(TGAP_LIM_DISC_ADV_INT_MAX, advInt);
-    GAP_SetParamValue(TGAP_GEN_DISC_ADV_INT_MIN, advInt);
-    GAP_SetParamValue(TGAP_GEN_DISC_ADV_INT_MAX, advInt);
   }
 
   // Setup the GAP Bond Manager. For more information see the section in the
@@ -610,15 +801,21 @@ static void SimplePeripheral_init(void)
     // Alternative is pairing succeeds but bonding fails, unless application has
     // manually erased at least one bond.
     uint8_t replaceBonds = FALSE;
+    // Keep the whitelist in sync with the bonded devices, used to only let
+    // them reconnect after a link loss
+    uint8_t autoSyncWL = TRUE;
 
     GAPBondMgr_SetParameter(GAPBOND_PAIRING_MODE, sizeof(uint8_t), &pairMode);
     GAPBondMgr_SetParameter(GAPBOND_MITM_PROTECTION, sizeof(uint8_t), &mitm);
     GAPBondMgr_SetParameter(GAPBOND_IO_CAPABILITIES, sizeof(uint8_t), &ioCap);
     GAPBondMgr_SetParameter(GAPBOND_BONDING_ENABLED, sizeof(uint8_t), &bonding);
     GAPBondMgr_SetParameter(GAPBOND_LRU_BOND_REPLACEMENT, sizeof(uint8_t), &replaceBonds);
+    GAPBondMgr_SetParameter(GAPBOND_AUTO_SYNC_WL, sizeof(uint8_t), &autoSyncWL);
   }
 
   // Initialize GATT attributes
+  // Keep the order of the services, new ones at the end: bonded centrals
+  // cache the handles (see gattdb.h)
   GGS_AddService(GATT_ALL_SERVICES);           // GAP GATT Service
   GATTServApp_AddService(GATT_ALL_SERVICES);   // GATT Service
   DevInfo_AddService();                        // Device Information Service
@@ -628,6 +825,22 @@ static void SimplePeripheral_init(void)
 
   MyData_AddService(selfEntity);
   MyData_RegisterAppCBs(&user_myDataCBs);
+  DevConfig_init();
+  Checkpoint_load(syncEvent, SBP_CHECKPOINT_EVT);
+  WallTime_init();
+
+  LogXfer_AddService(selfEntity);
+  LogXfer_RegisterAppCBs(&user_logXferCBs);
+  DataPump_init(SimplePeripheral_dataPumpRegister);
+  LogSync_init(syncEvent, SBP_LOG_SYNC_EVT);
+  LiveLevel_AddService(selfEntity);
+  LiveLevel_RegisterAppCBs(&user_liveLevelCBs);
+  LiveStream_init(syncEvent, SBP_LIVE_DATA_EVT);
+  CurrentTime_AddService(selfEntity);
+  CurrentTime_RegisterAppCBs(&user_currentTimeCBs);
+
+  // All services added, check if the layout changed since the last boot
+  GattDb_init();
 
   // Setup the SimpleProfile Characteristic Values
   // For more information, see the sections in the User's Guide:
@@ -651,7 +864,10 @@ static void SimplePeripheral_init(void)
                                charValue5);
     /* Add your new characteristic to the service. These names may vary */
     uint8_t myData_data_initVal[MYDATA_DATA_LEN] = {0};
+    uint8_t myData_config_initVal[MYDATA_CONFIG_LEN];
     MyData_SetParameter(MYDATA_DATA_ID, MYDATA_DATA_LEN, myData_data_initVal);
+    DevConfig_build(myData_config_initVal);
+    MyData_SetParameter(MYDATA_CONFIG_ID, MYDATA_CONFIG_LEN, myData_config_initVal);
   }
 
   // Register callback with SimpleGATTprofile
@@ -767,19 +983,53 @@ static void SimplePeripheral_taskFxn(UArg a0, UArg a1)
         // Perform periodic application task
         SimplePeripheral_performPeriodicTask();
       }
+
+      if (events & SBP_LOG_SYNC_EVT)
+      {
+        // Log transfer acknowledgement timeout
+        LogSync_processTimer();
+      }
+
+      if (events & SBP_LIVE_DATA_EVT)
+      {
+        // Level samples are waiting to be streamed
+        LiveStream_processData();
+      }
+
+      if (events & SBP_ADV_CTRL_EVT)
+      {
+        // Status summary in the advertising data changed
+        AdvCtrl_processUpdate();
+      }
+
+      if (events & SBP_CHECKPOINT_EVT)
+      {
+        // The sensor task handed over the hour in progress
+        Checkpoint_process();
+      }
+
+#ifdef USE_RCOSC
+      if (events & SBP_SCA_EVT)
+      {
+        // The measured sleep clock accuracy changed
+        RCOSC_processScaUpdate(linkDB_NumActive() == 0);
+      }
+#endif // USE_RCOSC
     }
   }
 }
 
 void user_myData_ValueChangeHandler(sbpEvt_t *pMsg)
 {
+    char_data_t *pCharData = (char_data_t *)pMsg->pData;
+
     switch (pMsg->hdr.state)
       {
-            case MYDATA_THRESHOLD_ID:
+            case MYDATA_CONFIG_ID:
             {
-            Display_print0(dispHandle, 18, 0, "Value Change msg for myData :: threshold received");
-            MyData_GetParameter( MYDATA_THRESHOLD_ID, &doctor_threshold );
-            // -------------------------
+            Display_print0(dispHandle, 18, 0, "Value Change msg for myData :: config received");
+            // Validated by the service, saved and handed to the sensor task here
+            DevConfig_set(pCharData->data, pCharData->dataLen);
             break;
             }
 //            case MYDATA_DATA_ID:
@@ -794,10 +1044,184 @@ void user_myData_ValueChangeHandler(sbpEvt_t *pMsg)
           }
 }
 
-static void user_myDataValueChangeCB(uint16_t connHandle, uint16_t svcUuid, uint8_t paramID, uint16_t len, uint8_t *pValue)
+/*********************************************************************
+ * @fn      user_myDataValueChangeCB
+ *
+ * @brief   Callback from the MyData service when a characteristic is
+ *          written. Runs in the stack context, so the written value is
+ *          copied and handed over to the application task.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   paramID    - characteristic that was written
+ * @param   len        - length of the written value
+ * @param   pValue     - written value
+ *
+ * @return  None.
+ */
+static void user_myDataValueChangeCB(uint16_t connHandle, uint8_t paramID,
+                                     uint16_t len, uint8_t *pValue)
+{
+  char_data_t *pCharData = ICall_malloc(sizeof(char_data_t) + len);
+
+  if (pCharData)
+  {
+    pCharData->connHandle = connHandle;
+    pCharData->svcUUID = MYDATA_SERV_UUID;
+    pCharData->dataLen = len;
+    pCharData->paramID = paramID;
+    memcpy(pCharData->data, pValue, len);
+
+    if (SimplePeripheral_enqueueMsg(MY_DATA_EVT, paramID,
+                                    (uint8_t *)pCharData) == FALSE)
+    {
+      ICall_free(pCharData);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      user_logXferValueChangeCB
+ *
+ * @brief   Callback from the LogXfer service when the Control
+ *          characteristic is written. Runs in the stack context, so the
+ *          written value is copied and handed over to the application task.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   paramID    - characteristic that was written
+ * @param   len        - length of the written value
+ * @param   pValue     - written value
+ *
+ * @return  None.
+ */
+static void user_logXferValueChangeCB(uint16_t connHandle, uint8_t paramID,
+                                      uint16_t len, uint8_t *pValue)
+{
+  char_data_t *pCharData = ICall_malloc(sizeof(char_data_t) + len);
+
+  if (pCharData)
+  {
+    pCharData->connHandle = connHandle;
+    pCharData->svcUUID = LOGXFER_SERV_UUID;
+    pCharData->dataLen = len;
+    pCharData->paramID = paramID;
+    memcpy(pCharData->data, pValue, len);
+
+    if (SimplePeripheral_enqueueMsg(SBP_LOG_XFER_EVT, paramID,
+                                    (uint8_t *)pCharData) == FALSE)
+    {
+      ICall_free(pCharData);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      user_logXferCfgChangeCB
+ *
+ * @brief   Callback from the LogXfer service when the Data CCC is
+ *          written. Runs in the stack context, so the change is handed
+ *          over to the application task.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   paramID    - characteristic whose CCC was written
+ * @param   len        - length of the written value
+ * @param   pValue     - written value
+ *
+ * @return  None.
+ */
+static void user_logXferCfgChangeCB(uint16_t connHandle, uint8_t paramID,
+                                    uint16_t len, uint8_t *pValue)
+{
+  char_data_t *pCharData = ICall_malloc(sizeof(char_data_t));
+
+  if (pCharData)
+  {
+    pCharData->connHandle = connHandle;
+    pCharData->svcUUID = LOGXFER_SERV_UUID;
+    pCharData->dataLen = 0;
+    pCharData->paramID = paramID;
+
+    if (SimplePeripheral_enqueueMsg(SBP_LOG_XFER_EVT, paramID,
+                                    (uint8_t *)pCharData) == FALSE)
+    {
+      ICall_free(pCharData);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      user_liveLevelCfgChangeCB
+ *
+ * @brief   Callback from the LiveLevel service when the Level or Alert
+ *          CCC is written. Runs in the stack context, so the change is
+ *          handed over to the application task.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   paramID    - characteristic whose CCC was written
+ * @param   len        - length of the written value
+ * @param   pValue     - written value
+ *
+ * @return  None.
+ */
+static void user_liveLevelCfgChangeCB(uint16_t connHandle, uint8_t paramID,
+                                      uint16_t len, uint8_t *pValue)
 {
-    SimplePeripheral_enqueueMsg(MY_DATA_EVT, paramID, pValue);
+  char_data_t *pCharData = ICall_malloc(sizeof(char_data_t));
+
+  if (pCharData)
+  {
+    pCharData->connHandle = connHandle;
+    pCharData->svcUUID = LIVELEVEL_SERV_UUID;
+    pCharData->dataLen = 0;
+    pCharData->paramID = paramID;
+
+    if (SimplePeripheral_enqueueMsg(SBP_LIVE_CFG_EVT, paramID,
+                                    (uint8_t *)pCharData) == FALSE)
+    {
+      ICall_free(pCharData);
+    }
+  }
+}
+
+/*********************************************************************
+ * @fn      user_currentTimeChangeCB
+ *
+ * @brief   Callback from the CurrentTime service when the Current Time
+ *          characteristic is written. Runs in the stack context, so the
+ *          time of reception is taken here and handed over to the
+ *          application task with the written value.
+ *
+ * @param   connHandle - connection the write was received on
+ * @param   paramID    - characteristic that was written
+ * @param   len        - length of the written value
+ * @param   pValue     - written value
+ *
+ * @return  None.
+ */
+static void user_currentTimeChangeCB(uint16_t connHandle, uint8_t paramID,
+                                     uint16_t len, uint8_t *pValue)
+{
+  char_data_t *pCharData = ICall_malloc(sizeof(char_data_t) +
+                                        sizeof(wallTimeSample_t));
+  wallTimeSample_t sample;
+
+  if (pCharData)
+  {
+    sample.rxTime = Timebase_now();
+    memcpy(sample.value, pValue, WALLTIME_CTS_LEN);
+
+    pCharData->connHandle = connHandle;
+    pCharData->svcUUID = CURRENTTIME_SERV_UUID;
+    pCharData->dataLen = sizeof(wallTimeSample_t);
+    pCharData->paramID = paramID;
+    memcpy(pCharData->data, &sample, sizeof(wallTimeSample_t));
+
+    if (SimplePeripheral_enqueueMsg(SBP_CURRENT_TIME_EVT, paramID,
+                                    (uint8_t *)pCharData) == FALSE)
+    {
+      ICall_free(pCharData);
+    }
   }
+}
 
 /*********************************************************************
  * @fn      SimplePeripheral_processStackMsg
@@ -907,12 +1331,14 @@ static uint8_t SimplePeripheral_processGATTMsg(gattMsgEvent_t *pMsg)
   if (attRsp_isAttRsp(pMsg))
   {
     // No HCI buffer was available. Let's try to retransmit the response
-    // on the next connection event.
-    if( SimplePeripheral_RegistertToAllConnectionEvent(FOR_ATT_RSP) == SUCCESS)
+    // on the next connection event of this connection.
+    if (SimplePeripheral_RegisterAttRspConnEvt(pMsg->connHandle) != SUCCESS)
     {
-      // Don't free the response message yet
-      return (FALSE);
+      SimplePeripheral_retryAttRspNow(pMsg->connHandle);
     }
+
+    // Don't free the response message yet, it is queued
+    return (FALSE);
   }
   else if (pMsg->method == ATT_FLOW_CTRL_VIOLATED_EVENT)
   {
@@ -946,20 +1372,25 @@ static uint8_t SimplePeripheral_processGATTMsg(gattMsgEvent_t *pMsg)
 static void SimplePeripheral_processConnEvt(Gap_ConnEventRpt_t *pReport)
 {
 
-  if( CONNECTION_EVENT_REGISTRATION_CAUSE(FOR_ATT_RSP))
+  if (attRspConnEvtMask & (1 << pReport->handle))
   {
     // The GATT server might have returned a blePending as it was trying
     // to process an ATT Response. Now that we finished with this
-    // connection event, let's try sending any remaining ATT Responses
-    // on the next connection event.
-    // Try to retransmit pending ATT Response (if any)
-    if (attRsp_sendAttRsp() == SUCCESS)
+    // connection event, let's try sending the remaining ATT Responses
+    // of this connection, in order.
+    if (attRsp_sendAttRsp(pReport->handle) == SUCCESS)
     {
         // Disable connection event end notice
-        SimplePeripheral_UnRegistertToAllConnectionEvent (FOR_ATT_RSP);
+        SimplePeripheral_UnRegisterAttRspConnEvt(pReport->handle);
     }
   }
 
+  if (CONNECTION_EVENT_REGISTRATION_CAUSE(FOR_DATA_PUMP))
+  {
+    // Refill the TX buffers this connection event has emptied
+    DataPump_processConnEvt(pReport);
+  }
+
 }
 
 /*********************************************************************
@@ -991,7 +1422,10 @@ static void SimplePeripheral_processAppMsg(sbpEvt_t *pMsg)
     // Pairing event
     case SBP_PAIRING_STATE_EVT:
       {
-        SimplePeripheral_processPairState(pMsg->hdr.state, *pMsg->pData);
+        sbpPairData_t *pPair = (sbpPairData_t *)pMsg->pData;
+
+        SimplePeripheral_processPairState(pPair->connHandle, pMsg->hdr.state,
+                                          pPair->value);
 
         ICall_free(pMsg->pData);
         break;
@@ -1000,7 +1434,9 @@ static void SimplePeripheral_processAppMsg(sbpEvt_t *pMsg)
     // Passcode event
     case SBP_PASSCODE_NEEDED_EVT:
       {
-        SimplePeripheral_processPasscode(*pMsg->pData);
+        sbpPairData_t *pPair = (sbpPairData_t *)pMsg->pData;
+
+        SimplePeripheral_processPasscode(pPair->connHandle, pPair->value);
 
         ICall_free(pMsg->pData);
         break;
@@ -1016,9 +1452,58 @@ static void SimplePeripheral_processAppMsg(sbpEvt_t *pMsg)
 	case MY_DATA_EVT:
 	{
 	   user_myData_ValueChangeHandler(pMsg);
-	   ICall_free(pMsg);
+	   ICall_free(pMsg->pData);
 	   break;
 	 }
+
+    case SBP_LOG_XFER_EVT:
+      {
+        char_data_t *pCharData = (char_data_t *)pMsg->pData;
+
+        if (pCharData->paramID == LOGXFER_DATA_ID)
+        {
+          LogSync_processCfg(pCharData->connHandle);
+        }
+        else
+        {
+          LogSync_processControl(pCharData->connHandle, pCharData->data,
+                                 pCharData->dataLen);
+        }
+
+        ICall_free(pMsg->pData);
+        break;
+      }
+
+    case SBP_LIVE_CFG_EVT:
+      {
+        char_data_t *pCharData = (char_data_t *)pMsg->pData;
+
+        // Alerts are sent to whoever is subscribed when they are raised
+        if (pCharData->paramID == LIVELEVEL_LEVEL_ID)
+        {
+          LiveStream_processCfg(pCharData->connHandle);
+        }
+
+        ICall_free(pMsg->pData);
+        break;
+      }
+
+    case SBP_CURRENT_TIME_EVT:
+      {
+        char_data_t *pCharData = (char_data_t *)pMsg->pData;
+        wallTimeSample_t sample;
+
+        // data[] is not aligned for the 64 bit reception time
+        memcpy(&sample, pCharData->data, sizeof(wallTimeSample_t));
+        WallTime_set(&sample);
+
+        // The sensor task starts its hour clock again on the new time
+        timeSetFxn();
+
+        ICall_free(pMsg->pData);
+        break;
+      }
+
     default:
       // Do nothing.
       break;
@@ -1054,6 +1539,16 @@ static void SimplePeripheral_processStateChangeEvt(gaprole_States_t newState)
   static bool firstConnFlag = false;
 #endif // PLUS_BROADCASTER
 
+  AdvCtrl_processStateChange(newState);
+
+#ifdef USE_RCOSC
+  // A sleep clock accuracy measured during the connection is declared now
+  if ((newState == GAPROLE_WAITING) || (newState == GAPROLE_WAITING_AFTER_TIMEOUT))
+  {
+    RCOSC_processScaUpdate(TRUE);
+  }
+#endif // USE_RCOSC
+
   switch ( newState )
   {
     case GAPROLE_STARTED:
@@ -1098,20 +1593,25 @@ static void SimplePeripheral_processStateChangeEvt(gaprole_States_t newState)
       {
         uint8_t advertEnabled = FALSE;
 
-        // Disable non-connectable advertising.
-        GAPRole_SetParameter(GAPROLE_ADV_NONCONN_ENABLED, sizeof(uint8_t),
-                           &advertEnabled);
+        // An alert burst goes back to connectable advertising by itself
+        if (!AdvCtrl_isBursting())
+        {
+          // Disable non-connectable advertising.
+          GAPRole_SetParameter(GAPROLE_ADV_NONCONN_ENABLED, sizeof(uint8_t),
+                             &advertEnabled);
 
-        advertEnabled = TRUE;
+          advertEnabled = TRUE;
 
-        // Enabled connectable advertising.
-        GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
-                             &advertEnabled);
+          // Enabled connectable advertising.
+          GAPRole_SetParameter(GAPROLE_ADVERT_ENABLED, sizeof(uint8_t),
+                               &advertEnabled);
+        }
 
         // Reset flag for next connection.
         firstConnFlag = false;
 
-        attRsp_freeAttRsp(bleNotConnected);
+        attRsp_freeAttRsp(LINKDB_CONNHANDLE_ALL, bleNotConnected);
+        SimplePeripheral_UnRegisterAttRspConnEvt(LINKDB_CONNHANDLE_ALL);
       }
       break;
 #endif //PLUS_BROADCASTER
@@ -1142,6 +1642,14 @@ static void SimplePeripheral_processStateChangeEvt(gaprole_States_t newState)
           Display_print0(dispHandle, 3, 0, Util_convertBdAddr2Str(peerAddress));
         }
 
+        // Offer the new peer only what it has not synced yet
+        {
+          uint16_t connHandle;
+
+          GAPRole_GetParameter(GAPROLE_CONNHANDLE, &connHandle);
+          LogSync_linkEstablished(connHandle);
+        }
+
         #ifdef PLUS_BROADCASTER
           // Only turn advertising on for this state when we first connect
           // otherwise, when we go from connected_advertising back to this state
@@ -1172,7 +1680,10 @@ static void SimplePeripheral_processStateChangeEvt(gaprole_States_t newState)
 
     case GAPROLE_WAITING:
       Util_stopClock(&periodicClock);
-      attRsp_freeAttRsp(bleNotConnected);
+      attRsp_freeAttRsp(LINKDB_CONNHANDLE_ALL, bleNotConnected);
+      SimplePeripheral_UnRegisterAttRspConnEvt(LINKDB_CONNHANDLE_ALL);
+      LogSync_linkTerminated(LINKDB_CONNHANDLE_ALL);
+      LiveStream_linkTerminated(LINKDB_CONNHANDLE_ALL);
 
       Display_print0(dispHandle, 2, 0, "Disconnected");
 
@@ -1181,7 +1692,10 @@ static void SimplePeripheral_processStateChangeEvt(gaprole_States_t newState)
       break;
 
     case GAPROLE_WAITING_AFTER_TIMEOUT:
-      attRsp_freeAttRsp(bleNotConnected);
+      attRsp_freeAttRsp(LINKDB_CONNHANDLE_ALL, bleNotConnected);
+      SimplePeripheral_UnRegisterAttRspConnEvt(LINKDB_CONNHANDLE_ALL);
+      LogSync_linkTerminated(LINKDB_CONNHANDLE_ALL);
+      LiveStream_linkTerminated(LINKDB_CONNHANDLE_ALL);
 
       Display_print0(dispHandle, 2, 0, "Timed Out");
 
@@ -1279,6 +1793,9 @@ static void SimplePeripheral_performPeriodicTask(void)
                                &valueToCopy);
   }
   MyData_SetParameter(MYDATA_DATA_ID, MYDATA_DATA_LEN, (void*)adc_values);
+
+  // Keep the log range reported by the Control characteristic current
+  LogSync_updateStatus();
 }
 
 /*********************************************************************
@@ -1291,15 +1808,17 @@ static void SimplePeripheral_performPeriodicTask(void)
 static void SimplePeripheral_pairStateCB(uint16_t connHandle, uint8_t state,
                                             uint8_t status)
 {
-  uint8_t *pData;
+  sbpPairData_t *pData;
 
   // Allocate space for the event data.
-  if ((pData = ICall_malloc(sizeof(uint8_t))))
+  if ((pData = ICall_malloc(sizeof(sbpPairData_t))))
   {
-    *pData = status;
+    pData->connHandle = connHandle;
+    pData->value = status;
 
     // Queue the event.
-    SimplePeripheral_enqueueMsg(SBP_PAIRING_STATE_EVT, state, pData);
+    SimplePeripheral_enqueueMsg(SBP_PAIRING_STATE_EVT, state,
+                                (uint8_t *)pData);
   }
 }
 
@@ -1308,9 +1827,14 @@ static void SimplePeripheral_pairStateCB(uint16_t connHandle, uint8_t state,
  *
  * @brief   Process the new paring state.
  *
+ * @param   connHandle - connection being paired
+ * @param   state      - new pairing state
+ * @param   status     - pairing status
+ *
  * @return  none
  */
-static void SimplePeripheral_processPairState(uint8_t state, uint8_t status)
+static void SimplePeripheral_processPairState(uint16_t connHandle,
+                                              uint8_t state, uint8_t status)
 {
   if (state == GAPBOND_PAIRING_STATE_STARTED)
   {
@@ -1332,6 +1856,9 @@ static void SimplePeripheral_processPairState(uint8_t state, uint8_t status)
     if (status == SUCCESS)
     {
       Display_print0(dispHandle, 2, 0, "Bonding success");
+
+      // Tell the peer if its cached layout is out of date
+      GattDb_linkEncrypted(connHandle, selfEntity);
     }
   }
   else if (state == GAPBOND_PAIRING_STATE_BOND_SAVED)
@@ -1339,6 +1866,10 @@ static void SimplePeripheral_processPairState(uint8_t state, uint8_t status)
     if (status == SUCCESS)
     {
       Display_print0(dispHandle, 2, 0, "Bond save success");
+
+      // The peer now has an identity its sync bookmark can be kept under
+      LogSync_bondSaved(connHandle);
+      GattDb_bondSaved(connHandle);
     }
     else
     {
@@ -1360,15 +1891,17 @@ static void SimplePeripheral_passcodeCB(uint8_t *deviceAddr,
                                         uint8_t uiOutputs,
                                         uint32_t numComparison)
 {
-  uint8_t *pData;
+  sbpPairData_t *pData;
 
   // Allocate space for the passcode event.
-  if ((pData = ICall_malloc(sizeof(uint8_t))))
+  if ((pData = ICall_malloc(sizeof(sbpPairData_t))))
   {
-    *pData = uiOutputs;
+    pData->connHandle = connHandle;
+    pData->value = uiOutputs;
 
     // Enqueue the event.
-    SimplePeripheral_enqueueMsg(SBP_PASSCODE_NEEDED_EVT, 0, pData);
+    SimplePeripheral_enqueueMsg(SBP_PASSCODE_NEEDED_EVT, 0,
+                                (uint8_t *)pData);
   }
 }
 
@@ -1377,9 +1910,13 @@ static void SimplePeripheral_passcodeCB(uint8_t *deviceAddr,
  *
  * @brief   Process the Passcode request.
  *
+ * @param   connHandle - connection being paired
+ * @param   uiOutputs  - TRUE if the passcode must be displayed
+ *
  * @return  none
  */
-static void SimplePeripheral_processPasscode(uint8_t uiOutputs)
+static void SimplePeripheral_processPasscode(uint16_t connHandle,
+                                             uint8_t uiOutputs)
 {
   // This app uses a default passcode. A real-life scenario would handle all
   // pairing scenarios and likely generate this randomly.
@@ -1391,11 +1928,8 @@ static void SimplePeripheral_processPasscode(uint8_t uiOutputs)
     Display_print1(dispHandle, 4, 0, "Passcode: %d", passcode);
   }
 
-  uint16_t connectionHandle;
-  GAPRole_GetParameter(GAPROLE_CONNHANDLE, &connectionHandle);
-
   // Send passcode response
-  GAPBondMgr_PasscodeRsp(connectionHandle, SUCCESS, passcode);
+  GAPBondMgr_PasscodeRsp(connHandle, SUCCESS, passcode);
 }
 
 /*********************************************************************
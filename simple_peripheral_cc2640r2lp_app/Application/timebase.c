@@ -0,0 +1,85 @@
+/******************************************************************************
+
+ @file  timebase.c
+
+ @brief Monotonic timebase shared by all tasks, read from the AON RTC.
+
+        The RTC is started by the power driver before the BIOS and is
+        never reset while the device runs, the RF driver schedules its
+        radio events on it.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <driverlib/aon_rtc.h>
+
+#include "timebase.h"
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Timebase_now
+ *
+ * @brief   Current time.
+ *
+ * @param   none
+ *
+ * @return  time since the RTC was started, in 1/65536 s
+ */
+uint64_t Timebase_now(void)
+{
+  // Reads SEC and SUBSEC again if the seconds moved in between, no
+  // locking needed
+  return (AONRTCCurrent64BitValueGet() >> 16);
+}
+
+/*********************************************************************
+ * @fn      Timebase_toMs
+ *
+ * @brief   Convert a time or a duration to ms.
+ *
+ * @param   time - time in 1/65536 s
+ *
+ * @return  time in ms
+ */
+uint64_t Timebase_toMs(uint64_t time)
+{
+  return ((time >> 16) * 1000 + (((time & 0xFFFF) * 1000) >> 16));
+}
+
+/*********************************************************************
+ * @fn      Timebase_toSeconds
+ *
+ * @brief   Convert a time to the encoding of stored timestamps.
+ *
+ * @param   time - time in 1/65536 s
+ *
+ * @return  whole seconds
+ */
+uint32_t Timebase_toSeconds(uint64_t time)
+{
+  return ((uint32_t)(time >> 16));
+}
+
+/*********************************************************************
+ * @fn      Timebase_msSince
+ *
+ * @brief   Time elapsed since an earlier reading.
+ *
+ * @param   since - earlier result of Timebase_now
+ *
+ * @return  elapsed time in ms, 0xFFFFFFFF if longer than that
+ */
+uint32_t Timebase_msSince(uint64_t since)
+{
+  uint64_t ms = Timebase_toMs(Timebase_now() - since);
+
+  return ((ms > 0xFFFFFFFF) ? 0xFFFFFFFF : (uint32_t)ms);
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,102 @@
+/******************************************************************************
+
+ @file  timebase.h
+
+ @brief Monotonic timebase shared by all tasks, read from the AON RTC.
+
+        The TI-RTOS Clock counts 10 us ticks in 32 bits and wraps after
+        about 11.9 hours. The AON RTC keeps running in standby and counts
+        seconds and fractions of a second in 32.32 bits; the timebase
+        keeps its 48.16 part, in 1/65536 s units. It does not wrap in the
+        lifetime of the device, so differences of two readings are always
+        right.
+
+        A reading does not wait for the AON bus and does not keep the
+        device out of standby; it may be taken from any task, Swi or Hwi.
+
+        Stored timestamps are 32 bit seconds, enough for 136 years; they
+        are converted to wall clock time by walltime.h.
+
+ *****************************************************************************/
+
+#ifndef TIMEBASE_H
+#define TIMEBASE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Timebase units in a second
+#define TIMEBASE_TICKS_PER_SEC        65536UL
+
+/*********************************************************************
+ * MACROS
+ */
+
+// Duration in timebase units
+#define TIMEBASE_FROM_SEC(s)          ((uint64_t)(s) << 16)
+#define TIMEBASE_FROM_MS(ms)          (((uint64_t)(ms) << 16) / 1000)
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Timebase_now
+ *
+ * @brief   Current time.
+ *
+ * @param   none
+ *
+ * @return  time since the RTC was started, in 1/65536 s
+ */
+extern uint64_t Timebase_now(void);
+
+/*********************************************************************
+ * @fn      Timebase_toMs
+ *
+ * @brief   Convert a time or a duration to ms.
+ *
+ * @param   time - time in 1/65536 s
+ *
+ * @return  time in ms
+ */
+extern uint64_t Timebase_toMs(uint64_t time);
+
+/*********************************************************************
+ * @fn      Timebase_toSeconds
+ *
+ * @brief   Convert a time to the encoding of stored timestamps.
+ *
+ * @param   time - time in 1/65536 s
+ *
+ * @return  whole seconds
+ */
+extern uint32_t Timebase_toSeconds(uint64_t time);
+
+/*********************************************************************
+ * @fn      Timebase_msSince
+ *
+ * @brief   Time elapsed since an earlier reading.
+ *
+ * @param   since - earlier result of Timebase_now
+ *
+ * @return  elapsed time in ms, 0xFFFFFFFF if longer than that
+ */
+extern uint32_t Timebase_msSince(uint64_t since);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TIMEBASE_H */
@@ -0,0 +1,193 @@
+/******************************************************************************
+
+ @file  wake.c
+
+ @brief Wake-on-sound idle of the sensor task.
+
+        Everything but Wake_getStats runs in the sensor task, so nothing
+        needs a lock.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include "wake_hal.h"
+#include "wake.h"
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Noise floor scaled by 2^WAKE_FLOOR_SHIFT, 0 until the first quiet sample
+static uint32_t floorAcc = 0;
+
+// Wake threshold of the idle in progress
+static uint16_t wakeThreshold;
+
+// Readings in a row above wakeThreshold
+static uint8_t numAbove;
+
+static wakeStats_t stats = {0};
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Wake_init
+ *
+ * @brief   Set up the wake-on-sound hardware. Called by the sensor task.
+ *
+ * @param   pSource - source of the level, passed to WakeHal_init
+ * @param   pfnDue  - called while idle when a reading is due
+ *
+ * @return  none
+ */
+void Wake_init(void *pSource, wakeCb_t pfnDue)
+{
+  WakeHal_init(pSource, pfnDue);
+}
+
+/*********************************************************************
+ * @fn      Wake_track
+ *
+ * @brief   Account for a level sample in the noise floor. Called by the
+ *          sensor task after every sample.
+ *
+ * @param   level          - amplitude of the sample
+ * @param   noiseThreshold - speech threshold of the configuration
+ *
+ * @return  none
+ */
+void Wake_track(uint16_t level, uint16_t noiseThreshold)
+{
+  // Speech is not part of the floor
+  if (level > noiseThreshold)
+  {
+    return;
+  }
+
+  if (floorAcc == 0)
+  {
+    floorAcc = (uint32_t)level << WAKE_FLOOR_SHIFT;
+  }
+  else
+  {
+    floorAcc = floorAcc - (floorAcc >> WAKE_FLOOR_SHIFT) + level;
+  }
+
+  stats.noiseFloor = floorAcc >> WAKE_FLOOR_SHIFT;
+}
+
+/*********************************************************************
+ * @fn      Wake_enter
+ *
+ * @brief   Start the idle: set the wake threshold and arm the hardware.
+ *          Called by the sensor task once sampling has stopped.
+ *
+ * @param   noiseThreshold - speech threshold of the configuration
+ *
+ * @return  none
+ */
+void Wake_enter(uint16_t noiseThreshold)
+{
+  uint32_t threshold = noiseThreshold;
+
+  // Below the noise threshold the governor would take the task back to
+  // the idle, only raise it for a loud room
+  if ((floorAcc != 0) && ((uint32_t)stats.noiseFloor + WAKE_MARGIN > threshold))
+  {
+    threshold = stats.noiseFloor + WAKE_MARGIN;
+  }
+
+  wakeThreshold = (threshold > 0xFFFF) ? 0xFFFF : threshold;
+  numAbove = 0;
+
+  stats.threshold = wakeThreshold;
+  stats.numIdles++;
+
+  WakeHal_arm();
+}
+
+/*********************************************************************
+ * @fn      Wake_exit
+ *
+ * @brief   End the idle, whatever woke the task. Called by the sensor task
+ *          before sampling again.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void Wake_exit(void)
+{
+  WakeHal_disarm();
+}
+
+/*********************************************************************
+ * @fn      Wake_poll
+ *
+ * @brief   Take the reading that is due and check it. Called by the
+ *          sensor task when woken by the callback given to Wake_init.
+ *
+ * @param   none
+ *
+ * @return  true when a sound ends the idle
+ */
+bool Wake_poll(void)
+{
+  uint16_t level;
+
+  // The ADC is busy, try again at the next reading
+  if (!WakeHal_read(&level))
+  {
+    return false;
+  }
+
+  return Wake_check(level);
+}
+
+/*********************************************************************
+ * @fn      Wake_check
+ *
+ * @brief   Decide whether a reading taken in the idle is a sound.
+ *
+ * @param   level - amplitude read by the hardware
+ *
+ * @return  true when the idle is over
+ */
+bool Wake_check(uint16_t level)
+{
+  if (level <= wakeThreshold)
+  {
+    numAbove = 0;
+    return false;
+  }
+
+  if (++numAbove < WAKE_CONFIRM)
+  {
+    return false;
+  }
+
+  stats.numSoundWakes++;
+
+  return true;
+}
+
+/*********************************************************************
+ * @fn      Wake_getStats
+ *
+ * @brief   Get the idle counters. May be called by any task.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+void Wake_getStats(wakeStats_t *pStats)
+{
+  *pStats = stats;
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,167 @@
+/******************************************************************************
+
+ @file  wake.h
+
+ @brief Wake-on-sound idle of the sensor task.
+
+        After WAKE_IDLE_AFTER ms of silence, or when the wearer presses the
+        button, the sensor task stops its sampling clock and sleeps. The
+        level is then read every WAKE_HAL_CHECK_PERIOD ms (see wake_hal.h):
+        the hardware wakes the task, which reads the level with Wake_poll
+        and leaves the idle once WAKE_CONFIRM readings in a row are above
+        the wake threshold. The readings are no closer together than the
+        samples of the quiet rate, so the idle only saves the work of a
+        sample; speech is caught within WAKE_CONFIRM periods.
+
+        The wake threshold follows the room: the sensor task passes every
+        sample at or below the noise threshold to Wake_track, which keeps a
+        running mean of them, the noise floor. The threshold is the noise
+        threshold, or WAKE_MARGIN above the floor in a room that loud: a
+        level the governor would not count as sound does not wake the task,
+        nor does the hum of a noisy room.
+
+        The module only depends on wake_hal.h.
+
+ *****************************************************************************/
+
+#ifndef WAKE_H
+#define WAKE_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Silence before the idle, in ms, counting the SAMPLEGOV_QUIET_AFTER ms
+// already spent at the quiet rate
+#define WAKE_IDLE_AFTER               60000
+
+// Weight of a sample in the noise floor, 1/2^WAKE_FLOOR_SHIFT
+#define WAKE_FLOOR_SHIFT              4
+
+// Wake threshold above the noise floor, in ADC counts
+#define WAKE_MARGIN                   32
+
+// Readings in a row above the threshold that wake the task, a single
+// knock does not
+#define WAKE_CONFIRM                  2
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Called while idle when a reading is due, from a Swi on the device. Only
+// to wake the sensor task, which then calls Wake_poll.
+typedef void (*wakeCb_t)(void);
+
+typedef struct
+{
+  uint32_t numIdles;      // Idles entered
+  uint32_t numSoundWakes; // Idles ended by a sound
+  uint16_t noiseFloor;    // Running mean of the quiet samples
+  uint16_t threshold;     // Wake threshold of the last idle
+} wakeStats_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      Wake_init
+ *
+ * @brief   Set up the wake-on-sound hardware. Called by the sensor task.
+ *
+ * @param   pSource - source of the level, passed to WakeHal_init
+ * @param   pfnDue  - called while idle when a reading is due
+ *
+ * @return  none
+ */
+extern void Wake_init(void *pSource, wakeCb_t pfnDue);
+
+/*********************************************************************
+ * @fn      Wake_track
+ *
+ * @brief   Account for a level sample in the noise floor. Called by the
+ *          sensor task after every sample.
+ *
+ * @param   level          - amplitude of the sample
+ * @param   noiseThreshold - speech threshold of the configuration
+ *
+ * @return  none
+ */
+extern void Wake_track(uint16_t level, uint16_t noiseThreshold);
+
+/*********************************************************************
+ * @fn      Wake_enter
+ *
+ * @brief   Start the idle: set the wake threshold and arm the hardware.
+ *          Called by the sensor task once sampling has stopped.
+ *
+ * @param   noiseThreshold - speech threshold of the configuration
+ *
+ * @return  none
+ */
+extern void Wake_enter(uint16_t noiseThreshold);
+
+/*********************************************************************
+ * @fn      Wake_exit
+ *
+ * @brief   End the idle, whatever woke the task. Called by the sensor task
+ *          before sampling again.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void Wake_exit(void);
+
+/*********************************************************************
+ * @fn      Wake_poll
+ *
+ * @brief   Take the reading that is due and check it. Called by the
+ *          sensor task when woken by the callback given to Wake_init.
+ *
+ * @param   none
+ *
+ * @return  true when a sound ends the idle
+ */
+extern bool Wake_poll(void);
+
+/*********************************************************************
+ * @fn      Wake_check
+ *
+ * @brief   Decide whether a reading taken in the idle is a sound.
+ *
+ * @param   level - amplitude read by the hardware
+ *
+ * @return  true when the idle is over
+ */
+extern bool Wake_check(uint16_t level);
+
+/*********************************************************************
+ * @fn      Wake_getStats
+ *
+ * @brief   Get the idle counters. May be called by any task; each counter
+ *          is read whole, the set may be one wake apart.
+ *
+ * @param   pStats - filled with the counters
+ *
+ * @return  none
+ */
+extern void Wake_getStats(wakeStats_t *pStats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAKE_H */
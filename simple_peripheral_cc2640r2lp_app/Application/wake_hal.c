@@ -0,0 +1,132 @@
+/******************************************************************************
+
+ @file  wake_hal.c
+
+ @brief Wake-on-sound hardware of the CC2640R2: a clock marks the
+        readings due, the sensor task reads the level ADC.
+
+        The ADC driver takes a semaphore for the AUX ADC and may block, so
+        it is not called from the clock Swi. The sensor task wakes for a
+        few us per reading and the device stays in standby in between.
+
+        The AUX comparator would wake the device without any reading, but
+        needs a Sensor Controller image this project does not build; it
+        would replace this file behind the same wake_hal.h.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <ti/sysbios/knl/Clock.h>
+#include <ti/drivers/ADC.h>
+
+#include "wake_hal.h"
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static ADC_Handle levelAdc = NULL;
+static wakeHalDue_t pfnReadingDue = NULL;
+
+// Periodic, started while armed
+static Clock_Struct checkClkStruct;
+static Clock_Handle checkClkHandle;
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void wakeHal_checkClkFxn(UArg arg0);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      WakeHal_init
+ *
+ * @brief   Set up the watch of the level, disarmed.
+ *
+ * @param   pSource - ADC_Handle of the level channel
+ * @param   pfnDue  - called while armed when a reading is due
+ *
+ * @return  none
+ */
+void WakeHal_init(void *pSource, wakeHalDue_t pfnDue)
+{
+  Clock_Params clkParams;
+
+  levelAdc = (ADC_Handle)pSource;
+  pfnReadingDue = pfnDue;
+
+  Clock_Params_init(&clkParams);
+  clkParams.period = WAKE_HAL_CHECK_PERIOD * 1000 / Clock_tickPeriod;
+  clkParams.startFlag = FALSE;
+  Clock_construct(&checkClkStruct, (Clock_FuncPtr)wakeHal_checkClkFxn,
+                  clkParams.period, &clkParams);
+  checkClkHandle = Clock_handle(&checkClkStruct);
+}
+
+/*********************************************************************
+ * @fn      WakeHal_arm
+ *
+ * @brief   Start watching the level.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void WakeHal_arm(void)
+{
+  Clock_start(checkClkHandle);
+}
+
+/*********************************************************************
+ * @fn      WakeHal_disarm
+ *
+ * @brief   Stop watching the level. Does nothing when not armed.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void WakeHal_disarm(void)
+{
+  Clock_stop(checkClkHandle);
+}
+
+/*********************************************************************
+ * @fn      WakeHal_read
+ *
+ * @brief   Read the level ADC. Called by the sensor task.
+ *
+ * @param   pLevel - filled with the level
+ *
+ * @return  false when the AUX ADC is busy
+ */
+bool WakeHal_read(uint16_t *pLevel)
+{
+  return (ADC_convert(levelAdc, pLevel) == ADC_STATUS_SUCCESS);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      wakeHal_checkClkFxn
+ *
+ * @brief   Tell that a reading is due. Runs in a Swi.
+ *
+ * @param   arg0 - not used
+ *
+ * @return  none
+ */
+static void wakeHal_checkClkFxn(UArg arg0)
+{
+  pfnReadingDue();
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,100 @@
+/******************************************************************************
+
+ @file  wake_hal.h
+
+ @brief Hardware of the wake-on-sound idle, below wake.c.
+
+        While armed the hardware tells every WAKE_HAL_CHECK_PERIOD ms that a
+        reading of the sound level is due; the sensor task then takes it
+        with WakeHal_read and decides whether it is a sound. The device
+        build (wake_hal.c) runs a clock and reads the level ADC; another
+        build may link a stand-in that plays back recorded levels.
+
+ *****************************************************************************/
+
+#ifndef WAKE_HAL_H
+#define WAKE_HAL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+#include <stdbool.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Time between two readings of the level while armed, in ms. Never shorter
+// than the quiet sample period (SAMPLEGOV_QUIET_PERIOD): the idle must not
+// wake the device more often than sampling in silence would.
+#define WAKE_HAL_CHECK_PERIOD         2000
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Called while armed when a reading is due, from a Swi on the device. Only
+// to wake the task that calls WakeHal_read.
+typedef void (*wakeHalDue_t)(void);
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      WakeHal_init
+ *
+ * @brief   Set up the watch of the level, disarmed.
+ *
+ * @param   pSource - source of the level (ADC_Handle on the device)
+ * @param   pfnDue  - called while armed when a reading is due
+ *
+ * @return  none
+ */
+extern void WakeHal_init(void *pSource, wakeHalDue_t pfnDue);
+
+/*********************************************************************
+ * @fn      WakeHal_arm
+ *
+ * @brief   Start watching the level.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void WakeHal_arm(void);
+
+/*********************************************************************
+ * @fn      WakeHal_disarm
+ *
+ * @brief   Stop watching the level. Does nothing when not armed.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void WakeHal_disarm(void);
+
+/*********************************************************************
+ * @fn      WakeHal_read
+ *
+ * @brief   Read the level. Called by the task woken by the due callback,
+ *          never from a Swi or Hwi.
+ *
+ * @param   pLevel - filled with the level
+ *
+ * @return  false when no reading could be taken
+ */
+extern bool WakeHal_read(uint16_t *pLevel);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WAKE_HAL_H */
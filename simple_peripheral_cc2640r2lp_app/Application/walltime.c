@@ -0,0 +1,485 @@
+/******************************************************************************
+
+ @file  walltime.c
+
+ @brief Wall clock time, set by the phone over the Current Time
+        characteristic and kept from the timebase with a drift correction.
+
+        The reference is written by the application task and read by every
+        task and by the stack, most of them at a higher priority. Both
+        copy activeRef with the interrupts disabled: a reader retrying
+        until the writer is done would never let the writer finish.
+
+        The drift is a signed fraction in units of 2^-32, the correction
+        of an interval is computed in two halves so the products stay
+        within 64 bits for any interval the timebase can hold.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <string.h>
+
+#include <ti/sysbios/hal/Hwi.h>
+
+#include <icall.h>
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+#include "timebase.h"
+#include "walltime.h"
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// Offsets in the Current Time value
+#define WALLTIME_YEAR_POS             0
+#define WALLTIME_MONTH_POS            2
+#define WALLTIME_DAY_POS              3
+#define WALLTIME_HOURS_POS            4
+#define WALLTIME_MINUTES_POS          5
+#define WALLTIME_SECONDS_POS          6
+#define WALLTIME_DAY_OF_WEEK_POS      7
+#define WALLTIME_FRACTIONS_POS        8
+#define WALLTIME_REASON_POS           9
+
+// Years that fit in the 32 bit stored timestamps
+#define WALLTIME_MIN_YEAR             2000
+#define WALLTIME_MAX_YEAR             2105
+
+#define WALLTIME_ADJUST_ALL           (WALLTIME_ADJUST_MANUAL    | \
+                                       WALLTIME_ADJUST_EXTERNAL  | \
+                                       WALLTIME_ADJUST_TIME_ZONE | \
+                                       WALLTIME_ADJUST_DST)
+
+// Writes that do not count as a drift measurement
+#define WALLTIME_ADJUST_JUMP          (WALLTIME_ADJUST_MANUAL    | \
+                                       WALLTIME_ADJUST_TIME_ZONE | \
+                                       WALLTIME_ADJUST_DST)
+
+// 1 ppm in units of 2^-32
+#define WALLTIME_PPM                  4295
+
+// Largest drift accepted, in units of 2^-32
+#define WALLTIME_MAX_DRIFT            ((int32_t)WALLTIME_MAX_DRIFT_PPM * WALLTIME_PPM)
+
+// The drift estimate is the running mean of the first measurements,
+// then moves by 1/WALLTIME_DRIFT_WEIGHT of each new one
+#define WALLTIME_DRIFT_WEIGHT         4
+
+#define WALLTIME_SECONDS_PER_DAY      86400UL
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+typedef struct
+{
+  uint64_t refLocal;  // Timebase reading of the last write
+  uint64_t refWall;   // Time written then, in 1/65536 s since 1970-01-01
+  int32_t  drift;     // (wall - local) / local, in 2^-32
+  uint8_t  synced;    // TRUE once written since boot
+} wallTimeRef_t;
+
+// SNV item
+typedef struct
+{
+  int32_t drift;           // Drift estimate, in 2^-32
+  uint8_t numMeasurements; // Measurements in the estimate, at most
+                           // WALLTIME_DRIFT_WEIGHT
+  uint8_t reserved[3];
+} wallTimeNv_t;
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+// Reference in force
+static wallTimeRef_t activeRef = { 0, 0, 0, FALSE };
+
+// Start of the drift measurement in progress, application task only
+static uint64_t anchorLocal;
+static uint64_t anchorWall;
+static uint8_t anchorValid = FALSE;
+
+// Drift estimate, application task only
+static wallTimeNv_t driftNv = { 0, 0, { 0 } };
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+static void wallTime_getRef(wallTimeRef_t *pRef);
+static void wallTime_publish(const wallTimeRef_t *pRef);
+static int64_t wallTime_scale(int64_t elapsed, int32_t drift);
+static uint32_t wallTime_daysFromDate(uint16_t year, uint8_t month, uint8_t day);
+static void wallTime_dateFromDays(uint32_t days, uint8_t *pValue);
+static uint8_t wallTime_daysInMonth(uint16_t year, uint8_t month);
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      WallTime_init
+ *
+ * @brief   Load the drift estimate of SNV. To be called by the
+ *          application task once it is registered with ICall.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+void WallTime_init(void)
+{
+  wallTimeNv_t nv;
+  wallTimeRef_t ref;
+
+  if ((osal_snv_read(WALLTIME_NV_ID, sizeof(wallTimeNv_t), &nv) == SUCCESS) &&
+      (nv.numMeasurements >= 1) &&
+      (nv.numMeasurements <= WALLTIME_DRIFT_WEIGHT) &&
+      (nv.drift >= -WALLTIME_MAX_DRIFT) && (nv.drift <= WALLTIME_MAX_DRIFT))
+  {
+    driftNv = nv;
+
+    wallTime_getRef(&ref);
+    ref.drift = nv.drift;
+    wallTime_publish(&ref);
+  }
+}
+
+/*********************************************************************
+ * @fn      WallTime_validate
+ *
+ * @brief   Check a Current Time value. Has no side effects, may be called
+ *          from the stack context.
+ *
+ * @param   pValue - Current Time value
+ * @param   len    - length of the value
+ *
+ * @return  TRUE if the value can be applied
+ */
+uint8_t WallTime_validate(const uint8_t *pValue, uint16_t len)
+{
+  uint16_t year;
+  uint8_t month;
+
+  if (len != WALLTIME_CTS_LEN)
+  {
+    return FALSE;
+  }
+
+  year = BUILD_UINT16(pValue[WALLTIME_YEAR_POS], pValue[WALLTIME_YEAR_POS + 1]);
+  month = pValue[WALLTIME_MONTH_POS];
+
+  return ((year >= WALLTIME_MIN_YEAR) && (year <= WALLTIME_MAX_YEAR) &&
+          (month >= 1) && (month <= 12) &&
+          (pValue[WALLTIME_DAY_POS] >= 1) &&
+          (pValue[WALLTIME_DAY_POS] <= wallTime_daysInMonth(year, month)) &&
+          (pValue[WALLTIME_HOURS_POS] < 24) &&
+          (pValue[WALLTIME_MINUTES_POS] < 60) &&
+          (pValue[WALLTIME_SECONDS_POS] < 60) &&
+          (pValue[WALLTIME_DAY_OF_WEEK_POS] <= 7) &&
+          !(pValue[WALLTIME_REASON_POS] & ~WALLTIME_ADJUST_ALL));
+}
+
+/*********************************************************************
+ * @fn      WallTime_set
+ *
+ * @brief   Apply a Current Time write and update the drift estimate.
+ *          Called by the application task.
+ *
+ * @param   pSample - value written and its reception time
+ *
+ * @return  none
+ */
+void WallTime_set(const wallTimeSample_t *pSample)
+{
+  const uint8_t *pValue = pSample->value;
+  uint64_t local = pSample->rxTime;
+  uint64_t wall;
+  int64_t localElapsed;
+  int64_t error;
+  int32_t measured;
+  wallTimeRef_t ref;
+
+  wall = wallTime_daysFromDate(BUILD_UINT16(pValue[WALLTIME_YEAR_POS],
+                                            pValue[WALLTIME_YEAR_POS + 1]),
+                               pValue[WALLTIME_MONTH_POS],
+                               pValue[WALLTIME_DAY_POS]);
+  wall = wall * WALLTIME_SECONDS_PER_DAY +
+         pValue[WALLTIME_HOURS_POS] * 3600UL +
+         pValue[WALLTIME_MINUTES_POS] * 60UL +
+         pValue[WALLTIME_SECONDS_POS];
+  wall = TIMEBASE_FROM_SEC(wall) + ((uint64_t)pValue[WALLTIME_FRACTIONS_POS] << 8);
+
+  if (anchorValid && !(pValue[WALLTIME_REASON_POS] & WALLTIME_ADJUST_JUMP))
+  {
+    localElapsed = (int64_t)(local - anchorLocal);
+    error = (int64_t)(wall - anchorWall) - localElapsed;
+
+    if (localElapsed >= (int64_t)TIMEBASE_FROM_SEC(WALLTIME_MIN_DRIFT_INTERVAL))
+    {
+      // Larger than any oscillator error: the phone time jumped
+      if (((error < 0) ? -error : error) * (1000000 / WALLTIME_MAX_DRIFT_PPM) <= localElapsed)
+      {
+        measured = (int32_t)((error * 65536) / (localElapsed >> 16));
+
+        if (driftNv.numMeasurements < WALLTIME_DRIFT_WEIGHT)
+        {
+          driftNv.numMeasurements++;
+        }
+        driftNv.drift += (measured - driftNv.drift) / driftNv.numMeasurements;
+
+        // Lost at the next reset if SNV is full, the next writes estimate it again
+        osal_snv_write(WALLTIME_NV_ID, sizeof(wallTimeNv_t), &driftNv);
+      }
+
+      anchorLocal = local;
+      anchorWall = wall;
+    }
+  }
+  else
+  {
+    anchorLocal = local;
+    anchorWall = wall;
+    anchorValid = TRUE;
+  }
+
+  ref.refLocal = local;
+  ref.refWall = wall;
+  ref.drift = driftNv.drift;
+  ref.synced = TRUE;
+  wallTime_publish(&ref);
+}
+
+/*********************************************************************
+ * @fn      WallTime_correct
+ *
+ * @brief   Wall clock time of a timebase reading. May be called by any
+ *          task and from the stack context.
+ *
+ * @param   local - result of Timebase_now
+ *
+ * @return  time in 1/65536 s since 1970-01-01, or the drift corrected
+ *          timebase before the first write
+ */
+uint64_t WallTime_correct(uint64_t local)
+{
+  wallTimeRef_t ref;
+
+  wallTime_getRef(&ref);
+
+  // Readings taken just before a write are before refLocal
+  return (ref.refWall + wallTime_scale((int64_t)(local - ref.refLocal), ref.drift));
+}
+
+/*********************************************************************
+ * @fn      WallTime_toSeconds
+ *
+ * @brief   Stored timestamp of a timebase reading.
+ *
+ * @param   local - result of Timebase_now
+ *
+ * @return  seconds since 1970-01-01, below WALLTIME_MIN_EPOCH before the
+ *          first write
+ */
+uint32_t WallTime_toSeconds(uint64_t local)
+{
+  return (Timebase_toSeconds(WallTime_correct(local)));
+}
+
+/*********************************************************************
+ * @fn      WallTime_build
+ *
+ * @brief   Build the Current Time value of now, for reads of the Current
+ *          Time characteristic. May be called from the stack context.
+ *
+ * @param   pValue - WALLTIME_CTS_LEN bytes, filled in with the value
+ *
+ * @return  none
+ */
+void WallTime_build(uint8_t *pValue)
+{
+  wallTimeRef_t ref;
+  uint64_t now;
+  uint32_t seconds;
+  uint32_t days;
+
+  memset(pValue, 0, WALLTIME_CTS_LEN);
+
+  wallTime_getRef(&ref);
+  if (!ref.synced)
+  {
+    // Year, month and day 0: not known
+    return;
+  }
+
+  now = ref.refWall + wallTime_scale((int64_t)(Timebase_now() - ref.refLocal),
+                                     ref.drift);
+  seconds = Timebase_toSeconds(now);
+  days = seconds / WALLTIME_SECONDS_PER_DAY;
+  seconds %= WALLTIME_SECONDS_PER_DAY;
+
+  wallTime_dateFromDays(days, pValue);
+  pValue[WALLTIME_HOURS_POS] = seconds / 3600;
+  pValue[WALLTIME_MINUTES_POS] = (seconds / 60) % 60;
+  pValue[WALLTIME_SECONDS_POS] = seconds % 60;
+  // 1970-01-01 was a Thursday, Monday is 1
+  pValue[WALLTIME_DAY_OF_WEEK_POS] = (days + 3) % 7 + 1;
+  pValue[WALLTIME_FRACTIONS_POS] = (uint8_t)(now >> 8);
+}
+
+/*********************************************************************
+ * LOCAL FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      wallTime_getRef
+ *
+ * @brief   Copy the reference in force.
+ *
+ * @param   pRef - filled in with the reference
+ *
+ * @return  none
+ */
+static void wallTime_getRef(wallTimeRef_t *pRef)
+{
+  UInt key = Hwi_disable();
+
+  *pRef = activeRef;
+
+  Hwi_restore(key);
+}
+
+/*********************************************************************
+ * @fn      wallTime_publish
+ *
+ * @brief   Replace the reference in force. Only called by the
+ *          application task.
+ *
+ * @param   pRef - new reference
+ *
+ * @return  none
+ */
+static void wallTime_publish(const wallTimeRef_t *pRef)
+{
+  UInt key = Hwi_disable();
+
+  activeRef = *pRef;
+
+  Hwi_restore(key);
+}
+
+/*********************************************************************
+ * @fn      wallTime_scale
+ *
+ * @brief   Correct an interval of the timebase for the drift.
+ *
+ * @param   elapsed - interval, in 1/65536 s
+ * @param   drift   - drift, in 2^-32
+ *
+ * @return  interval the phone would have counted, in 1/65536 s
+ */
+static int64_t wallTime_scale(int64_t elapsed, int32_t drift)
+{
+  uint64_t mag = (elapsed < 0) ? -elapsed : elapsed;
+  int64_t corr;
+
+  corr = ((int64_t)(mag >> 16) * drift) / 65536 +
+         ((int64_t)(mag & 0xFFFF) * drift) / 4294967296LL;
+
+  return ((elapsed < 0) ? elapsed - corr : elapsed + corr);
+}
+
+/*********************************************************************
+ * @fn      wallTime_daysFromDate
+ *
+ * @brief   Days from 1970-01-01 to a date of the Gregorian calendar.
+ *
+ * @param   year  - year, from WALLTIME_MIN_YEAR
+ * @param   month - month, 1 to 12
+ * @param   day   - day of the month, from 1
+ *
+ * @return  days
+ */
+static uint32_t wallTime_daysFromDate(uint16_t year, uint8_t month, uint8_t day)
+{
+  uint32_t era;
+  uint32_t yearOfEra;
+  uint32_t dayOfYear;
+
+  // Years start on March 1st, the leap day is the last one
+  year -= (month <= 2);
+  era = year / 400;
+  yearOfEra = year - era * 400;
+  dayOfYear = (153 * ((month > 2) ? month - 3 : month + 9) + 2) / 5 + day - 1;
+
+  return (era * 146097 + yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 +
+          dayOfYear - 719468);
+}
+
+/*********************************************************************
+ * @fn      wallTime_dateFromDays
+ *
+ * @brief   Date of the Gregorian calendar a number of days after
+ *          1970-01-01.
+ *
+ * @param   days   - days
+ * @param   pValue - Current Time value, year, month and day are filled in
+ *
+ * @return  none
+ */
+static void wallTime_dateFromDays(uint32_t days, uint8_t *pValue)
+{
+  uint32_t era;
+  uint32_t dayOfEra;
+  uint32_t yearOfEra;
+  uint32_t dayOfYear;
+  uint32_t marchMonth;
+  uint16_t year;
+  uint8_t month;
+
+  days += 719468;
+  era = days / 146097;
+  dayOfEra = days - era * 146097;
+  yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+  dayOfYear = dayOfEra - (yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100);
+  marchMonth = (5 * dayOfYear + 2) / 153;
+  month = (marchMonth < 10) ? marchMonth + 3 : marchMonth - 9;
+  year = yearOfEra + era * 400 + (month <= 2);
+
+  pValue[WALLTIME_YEAR_POS] = LO_UINT16(year);
+  pValue[WALLTIME_YEAR_POS + 1] = HI_UINT16(year);
+  pValue[WALLTIME_MONTH_POS] = month;
+  pValue[WALLTIME_DAY_POS] = dayOfYear - (153 * marchMonth + 2) / 5 + 1;
+}
+
+/*********************************************************************
+ * @fn      wallTime_daysInMonth
+ *
+ * @brief   Length of a month.
+ *
+ * @param   year  - year
+ * @param   month - month, 1 to 12
+ *
+ * @return  days in the month
+ */
+static uint8_t wallTime_daysInMonth(uint16_t year, uint8_t month)
+{
+  static const uint8_t monthDays[12] =
+  {
+    31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31
+  };
+
+  if ((month == 2) && ((year % 4 == 0) && ((year % 100 != 0) || (year % 400 == 0))))
+  {
+    return 29;
+  }
+
+  return (monthDays[month - 1]);
+}
+
+/*********************************************************************
+*********************************************************************/
@@ -0,0 +1,164 @@
+/******************************************************************************
+
+ @file  walltime.h
+
+ @brief Wall clock time, set by the phone over the Current Time
+        characteristic and kept from the timebase with a drift correction.
+
+        Current Time value (CTS 0x2A2B, all values little endian):
+
+            [year u16][month u8][day u8][hours u8][minutes u8]
+            [seconds u8][dayOfWeek u8][fractions256 u8][adjustReason u8]
+
+        The time is taken as written, time zone included. A read before
+        the first write returns year and month 0 (not known).
+
+        Each write that is at least WALLTIME_MIN_DRIFT_INTERVAL after the
+        previous measurement gives the drift of the local oscillator, the
+        time the phone counted against the time the timebase counted. The
+        estimate is averaged over the measurements, kept in SNV and
+        applied to every time converted after that, so writes a few times
+        a day keep the clock within a second. Writes with the manual, time
+        zone or DST bits of adjustReason set, or that are off by more than
+        WALLTIME_MAX_DRIFT_PPM, set the time but start a new measurement.
+
+        Stored timestamps are 32 bit seconds since 1970-01-01. Before the
+        first write since boot they are the seconds of the timebase
+        instead, always below WALLTIME_MIN_EPOCH.
+
+ *****************************************************************************/
+
+#ifndef WALLTIME_H
+#define WALLTIME_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stdint.h>
+
+#include <bcomdef.h>
+
+/*********************************************************************
+ * CONSTANTS
+ */
+
+// SNV item holding the drift estimate
+#define WALLTIME_NV_ID                (BLE_NVID_CUST_START + 5)
+
+// Size of the Current Time value
+#define WALLTIME_CTS_LEN              10
+
+// Adjust reason bits of the Current Time value
+#define WALLTIME_ADJUST_MANUAL        0x01
+#define WALLTIME_ADJUST_EXTERNAL      0x02
+#define WALLTIME_ADJUST_TIME_ZONE     0x04
+#define WALLTIME_ADJUST_DST           0x08
+
+// Stored timestamps from this value on are wall clock time (2000-01-01)
+#define WALLTIME_MIN_EPOCH            946684800UL
+
+// Shortest time between two drift measurements, in s
+#define WALLTIME_MIN_DRIFT_INTERVAL   (4UL * 60 * 60)
+
+// Largest drift accepted, in ppm
+#define WALLTIME_MAX_DRIFT_PPM        500
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Current Time write and when it was received
+typedef struct
+{
+  uint64_t rxTime;                    // Timebase_now() at reception
+  uint8_t  value[WALLTIME_CTS_LEN];   // Current Time value
+} wallTimeSample_t;
+
+/*********************************************************************
+ * FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      WallTime_init
+ *
+ * @brief   Load the drift estimate of SNV. To be called by the
+ *          application task once it is registered with ICall.
+ *
+ * @param   none
+ *
+ * @return  none
+ */
+extern void WallTime_init(void);
+
+/*********************************************************************
+ * @fn      WallTime_validate
+ *
+ * @brief   Check a Current Time value. Has no side effects, may be called
+ *          from the stack context.
+ *
+ * @param   pValue - Current Time value
+ * @param   len    - length of the value
+ *
+ * @return  TRUE if the value can be applied
+ */
+extern uint8_t WallTime_validate(const uint8_t *pValue, uint16_t len);
+
+/*********************************************************************
+ * @fn      WallTime_set
+ *
+ * @brief   Apply a Current Time write and update the drift estimate.
+ *          Called by the application task.
+ *
+ * @param   pSample - value written and its reception time
+ *
+ * @return  none
+ */
+extern void WallTime_set(const wallTimeSample_t *pSample);
+
+/*********************************************************************
+ * @fn      WallTime_correct
+ *
+ * @brief   Wall clock time of a timebase reading. May be called by any
+ *          task and from the stack context.
+ *
+ * @param   local - result of Timebase_now
+ *
+ * @return  time in 1/65536 s since 1970-01-01, or the drift corrected
+ *          timebase before the first write
+ */
+extern uint64_t WallTime_correct(uint64_t local);
+
+/*********************************************************************
+ * @fn      WallTime_toSeconds
+ *
+ * @brief   Stored timestamp of a timebase reading.
+ *
+ * @param   local - result of Timebase_now
+ *
+ * @return  seconds since 1970-01-01, below WALLTIME_MIN_EPOCH before the
+ *          first write
+ */
+extern uint32_t WallTime_toSeconds(uint64_t local);
+
+/*********************************************************************
+ * @fn      WallTime_build
+ *
+ * @brief   Build the Current Time value of now, for reads of the Current
+ *          Time characteristic. May be called from the stack context.
+ *
+ * @param   pValue - WALLTIME_CTS_LEN bytes, filled in with the value
+ *
+ * @return  none
+ */
+extern void WallTime_build(uint8_t *pValue);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* WALLTIME_H */
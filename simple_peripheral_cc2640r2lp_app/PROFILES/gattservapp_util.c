@@ -51,6 +51,7 @@
 #include "util.h"
 /* This Header file contains all BLE API and icall structure definition */
 #include "icall_ble_api.h"
+#include "gattservapp_util.h"
 
 /*********************************************************************
  * MACROS
@@ -154,6 +155,7 @@ bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *pValue,
 {
   uint8 i;
   bStatus_t status = SUCCESS;
+  gattAttribute_t *pAttr;
 
   // Verify input parameters
   if ( ( charCfgTbl == NULL ) || ( pValue == NULL ) ||
@@ -162,6 +164,13 @@ bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *pValue,
     return ( INVALIDPARAMETER );
   }
 
+  // Find the characteristic value attribute, the same for every connection
+  pAttr = GATTServApp_FindAttr( attrTbl, numAttrs, pValue );
+  if ( pAttr == NULL )
+  {
+    return ( status );
+  }
+
   for ( i = 0; i < linkDBNumConns; i++ )
   {
     gattCharCfg_t *pItem = &(charCfgTbl[i]);
@@ -169,23 +178,16 @@ bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *pValue,
     if ( ( pItem->connHandle != INVALID_CONNHANDLE ) &&
          ( pItem->value != GATT_CFG_NO_OPERATION ) )
     {
-      gattAttribute_t *pAttr;
-
-      // Find the characteristic value attribute
-      pAttr = GATTServApp_FindAttr( attrTbl, numAttrs, pValue );
-      if ( pAttr != NULL )
+      if ( pItem->value & GATT_CLIENT_CFG_NOTIFY )
       {
-        if ( pItem->value & GATT_CLIENT_CFG_NOTIFY )
-        {
-           status |= gattServApp_SendNotiInd( pItem->connHandle, GATT_CLIENT_CFG_NOTIFY,
-                                              authenticated, pAttr, taskId, pfnReadAttrCB );
-        }
+         status |= gattServApp_SendNotiInd( pItem->connHandle, GATT_CLIENT_CFG_NOTIFY,
+                                            authenticated, pAttr, taskId, pfnReadAttrCB );
+      }
 
-        if ( pItem->value & GATT_CLIENT_CFG_INDICATE )
-        {
-           status |= gattServApp_SendNotiInd( pItem->connHandle, GATT_CLIENT_CFG_INDICATE,
-                                              authenticated, pAttr, taskId, pfnReadAttrCB );
-        }
+      if ( pItem->value & GATT_CLIENT_CFG_INDICATE )
+      {
+         status |= gattServApp_SendNotiInd( pItem->connHandle, GATT_CLIENT_CFG_INDICATE,
+                                            authenticated, pAttr, taskId, pfnReadAttrCB );
       }
     }
   } // for
@@ -193,6 +195,61 @@ bStatus_t GATTServApp_ProcessCharCfg( gattCharCfg_t *charCfgTbl, uint8 *pValue,
   return ( status );
 }
 
+/*********************************************************************
+ * @fn      GATTServApp_NotifyEncode
+ *
+ * @brief   Send a notification encoded straight into the stack buffer,
+ *          without an intermediate copy.
+ *
+ * @param   connHandle - connection handle of the central
+ * @param   charCfgTbl - client characteristic configuration table
+ * @param   pAttr - characteristic value attribute
+ * @param   pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes
+ *
+ * @return  SUCCESS, bleIncorrectMode when the central has not enabled
+ *          notifications, else the GATT status
+ */
+bStatus_t GATTServApp_NotifyEncode( uint16 connHandle, gattCharCfg_t *charCfgTbl,
+                                    gattAttribute_t *pAttr,
+                                    pfnGATTNotiEncode_t pfnEncode )
+{
+  attHandleValueNoti_t noti;
+  uint16 maxLen;
+  bStatus_t status;
+
+  if ( !( GATTServApp_ReadCharCfg( connHandle, charCfgTbl ) &
+          GATT_CLIENT_CFG_NOTIFY ) )
+  {
+    return ( bleIncorrectMode );
+  }
+
+  // Largest payload the link can carry in one notification
+  maxLen = ATT_GetMTU( connHandle ) - 3;
+
+  noti.pValue = (uint8 *)GATT_bm_alloc( connHandle, ATT_HANDLE_VALUE_NOTI,
+                                        maxLen, NULL );
+  if ( noti.pValue == NULL )
+  {
+    return ( MSG_BUFFER_NOT_AVAIL );
+  }
+
+  noti.len = pfnEncode( noti.pValue, maxLen );
+  if ( noti.len == 0 )
+  {
+    GATT_bm_free( (gattMsg_t *)&noti, ATT_HANDLE_VALUE_NOTI );
+    return ( SUCCESS );
+  }
+  noti.handle = pAttr->handle;
+
+  status = GATT_Notification( connHandle, &noti, FALSE );
+  if ( status != SUCCESS )
+  {
+    GATT_bm_free( (gattMsg_t *)&noti, ATT_HANDLE_VALUE_NOTI );
+  }
+
+  return ( status );
+}
+
 /*********************************************************************
  * @fn          GATTServApp_FindAttr
  *
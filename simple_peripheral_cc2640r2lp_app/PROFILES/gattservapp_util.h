@@ -0,0 +1,70 @@
+/******************************************************************************
+
+ @file  gattservapp_util.h
+
+ @brief This file contains the GATT Server Application utility functions
+        that are not part of the stack's gattservapp.h.
+
+ Group: WCS, BTS
+ Target Device: cc2640r2
+
+ ******************************************************************************
+
+
+ *****************************************************************************/
+
+#ifndef GATTSERVAPP_UTIL_H
+#define GATTSERVAPP_UTIL_H
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/*********************************************************************
+ * INCLUDES
+ */
+/* This Header file contains all BLE API and icall structure definition */
+#include "icall_ble_api.h"
+
+/*********************************************************************
+ * TYPEDEFS
+ */
+
+// Encoder writing a notification in place, returns the length written
+// (0 to send nothing)
+typedef uint16_t (*pfnGATTNotiEncode_t)( uint8_t *pBuf, uint16_t maxLen );
+
+/*********************************************************************
+ * API FUNCTIONS
+ */
+
+/*********************************************************************
+ * @fn      GATTServApp_NotifyEncode
+ *
+ * @brief   Send a notification encoded straight into the stack buffer,
+ *          without an intermediate copy.
+ *
+ * @param   connHandle - connection handle of the central
+ * @param   charCfgTbl - client characteristic configuration table
+ * @param   pAttr - characteristic value attribute
+ * @param   pfnEncode - encoder, given a buffer of ATT_MTU - 3 bytes. It is
+ *                      not called when no buffer could be allocated.
+ *
+ * @return  SUCCESS, bleIncorrectMode when the central has not enabled
+ *          notifications, else the GATT status (e.g. blePending,
+ *          MSG_BUFFER_NOT_AVAIL) when the payload could not be queued
+ */
+extern bStatus_t GATTServApp_NotifyEncode( uint16 connHandle,
+                                           gattCharCfg_t *charCfgTbl,
+                                           gattAttribute_t *pAttr,
+                                           pfnGATTNotiEncode_t pfnEncode );
+
+/*********************************************************************
+*********************************************************************/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* GATTSERVAPP_UTIL_H */
@@ -55,6 +55,8 @@
 #include "icall_ble_api.h"
 
 #include "simple_gatt_profile.h"
+#include "services/gatt_decl.h"
+#include "gattdb.h"
 
 /*********************************************************************
  * MACROS
@@ -66,6 +68,14 @@
 
 #define SERVAPP_NUM_ATTR_SUPPORTED        17
 
+// Position of the attributes in the attribute table
+#define SIMPLEPROFILE_CHAR1_VALUE_IDX     2
+#define SIMPLEPROFILE_CHAR2_VALUE_IDX     5
+#define SIMPLEPROFILE_CHAR3_VALUE_IDX     8
+#define SIMPLEPROFILE_CHAR4_VALUE_IDX     11
+#define SIMPLEPROFILE_CHAR4_CCC_IDX       12
+#define SIMPLEPROFILE_CHAR5_VALUE_IDX     15
+
 /*********************************************************************
  * TYPEDEFS
  */
@@ -132,37 +142,37 @@ static CONST gattAttrType_t simpleProfileService = { ATT_BT_UUID_SIZE, simplePro
 
 
 // Simple Profile Characteristic 1 Properties
-static uint8 simpleProfileChar1Props = GATT_PROP_READ | GATT_PROP_WRITE;
+static CONST uint8 simpleProfileChar1Props = GATT_PROP_READ | GATT_PROP_WRITE;
 
 // Characteristic 1 Value
 static uint8 simpleProfileChar1 = 0;
 
 // Simple Profile Characteristic 1 User Description
-static uint8 simpleProfileChar1UserDesp[17] = "Characteristic 1";
+static CONST uint8 simpleProfileChar1UserDesp[17] = "Characteristic 1";
 
 
 // Simple Profile Characteristic 2 Properties
-static uint8 simpleProfileChar2Props = GATT_PROP_READ;
+static CONST uint8 simpleProfileChar2Props = GATT_PROP_READ;
 
 // Characteristic 2 Value
 static uint8 simpleProfileChar2 = 0;
 
 // Simple Profile Characteristic 2 User Description
-static uint8 simpleProfileChar2UserDesp[17] = "Characteristic 2";
+static CONST uint8 simpleProfileChar2UserDesp[17] = "Characteristic 2";
 
 
 // Simple Profile Characteristic 3 Properties
-static uint8 simpleProfileChar3Props = GATT_PROP_WRITE;
+static CONST uint8 simpleProfileChar3Props = GATT_PROP_WRITE;
 
 // Characteristic 3 Value
 static uint8 simpleProfileChar3 = 0;
 
 // Simple Profile Characteristic 3 User Description
-static uint8 simpleProfileChar3UserDesp[17] = "Characteristic 3";
+static CONST uint8 simpleProfileChar3UserDesp[17] = "Characteristic 3";
 
 
 // Simple Profile Characteristic 4 Properties
-static uint8 simpleProfileChar4Props = GATT_PROP_NOTIFY;
+static CONST uint8 simpleProfileChar4Props = GATT_PROP_NOTIFY;
 
 // Characteristic 4 Value
 static uint8 simpleProfileChar4 = 0;
@@ -174,17 +184,17 @@ static uint8 simpleProfileChar4 = 0;
 static gattCharCfg_t *simpleProfileChar4Config;
 
 // Simple Profile Characteristic 4 User Description
-static uint8 simpleProfileChar4UserDesp[17] = "Characteristic 4";
+static CONST uint8 simpleProfileChar4UserDesp[17] = "Characteristic 4";
 
 
 // Simple Profile Characteristic 5 Properties
-static uint8 simpleProfileChar5Props = GATT_PROP_READ;
+static CONST uint8 simpleProfileChar5Props = GATT_PROP_READ;
 
 // Characteristic 5 Value
 static uint8 simpleProfileChar5[SIMPLEPROFILE_CHAR5_LEN] = { 0, 0, 0, 0, 0 };
 
 // Simple Profile Characteristic 5 User Description
-static uint8 simpleProfileChar5UserDesp[17] = "Characteristic 5";
+static CONST uint8 simpleProfileChar5UserDesp[17] = "Characteristic 5";
 
 /*********************************************************************
  * Profile Attributes - Table
@@ -193,140 +203,60 @@ static uint8 simpleProfileChar5UserDesp[17] = "Characteristic 5";
 static gattAttribute_t simpleProfileAttrTbl[SERVAPP_NUM_ATTR_SUPPORTED] =
 {
   // Simple Profile Service
-  {
-    { ATT_BT_UUID_SIZE, primaryServiceUUID }, /* type */
-    GATT_PERMIT_READ,                         /* permissions */
-    0,                                        /* handle */
-    (uint8 *)&simpleProfileService            /* pValue */
-  },
+  GATT_DECL_PRIMARY_SERVICE( &simpleProfileService ),
 
     // Characteristic 1 Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &simpleProfileChar1Props
-    },
+    GATT_DECL_CHAR( &simpleProfileChar1Props ),
 
       // Characteristic Value 1
-      {
-        { ATT_BT_UUID_SIZE, simpleProfilechar1UUID },
-        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-        0,
-        &simpleProfileChar1
-      },
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, simpleProfilechar1UUID,
+                       GATT_PERMIT_READ | GATT_PERMIT_WRITE, &simpleProfileChar1 ),
 
       // Characteristic 1 User Description
-      {
-        { ATT_BT_UUID_SIZE, charUserDescUUID },
-        GATT_PERMIT_READ,
-        0,
-        simpleProfileChar1UserDesp
-      },
+      GATT_DECL_USER_DESC( simpleProfileChar1UserDesp ),
 
     // Characteristic 2 Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &simpleProfileChar2Props
-    },
+    GATT_DECL_CHAR( &simpleProfileChar2Props ),
 
       // Characteristic Value 2
-      {
-        { ATT_BT_UUID_SIZE, simpleProfilechar2UUID },
-        GATT_PERMIT_READ,
-        0,
-        &simpleProfileChar2
-      },
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, simpleProfilechar2UUID,
+                       GATT_PERMIT_READ, &simpleProfileChar2 ),
 
       // Characteristic 2 User Description
-      {
-        { ATT_BT_UUID_SIZE, charUserDescUUID },
-        GATT_PERMIT_READ,
-        0,
-        simpleProfileChar2UserDesp
-      },
+      GATT_DECL_USER_DESC( simpleProfileChar2UserDesp ),
 
     // Characteristic 3 Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &simpleProfileChar3Props
-    },
+    GATT_DECL_CHAR( &simpleProfileChar3Props ),
 
       // Characteristic Value 3
-      {
-        { ATT_BT_UUID_SIZE, simpleProfilechar3UUID },
-        GATT_PERMIT_WRITE,
-        0,
-        &simpleProfileChar3
-      },
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, simpleProfilechar3UUID,
+                       GATT_PERMIT_WRITE, &simpleProfileChar3 ),
 
       // Characteristic 3 User Description
-      {
-        { ATT_BT_UUID_SIZE, charUserDescUUID },
-        GATT_PERMIT_READ,
-        0,
-        simpleProfileChar3UserDesp
-      },
+      GATT_DECL_USER_DESC( simpleProfileChar3UserDesp ),
 
     // Characteristic 4 Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &simpleProfileChar4Props
-    },
+    GATT_DECL_CHAR( &simpleProfileChar4Props ),
 
       // Characteristic Value 4
-      {
-        { ATT_BT_UUID_SIZE, simpleProfilechar4UUID },
-        0,
-        0,
-        &simpleProfileChar4
-      },
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, simpleProfilechar4UUID,
+                       0, &simpleProfileChar4 ),
 
       // Characteristic 4 configuration
-      {
-        { ATT_BT_UUID_SIZE, clientCharCfgUUID },
-        GATT_PERMIT_READ | GATT_PERMIT_WRITE,
-        0,
-        (uint8 *)&simpleProfileChar4Config
-      },
+      GATT_DECL_CCC( &simpleProfileChar4Config ),
 
       // Characteristic 4 User Description
-      {
-        { ATT_BT_UUID_SIZE, charUserDescUUID },
-        GATT_PERMIT_READ,
-        0,
-        simpleProfileChar4UserDesp
-      },
+      GATT_DECL_USER_DESC( simpleProfileChar4UserDesp ),
 
     // Characteristic 5 Declaration
-    {
-      { ATT_BT_UUID_SIZE, characterUUID },
-      GATT_PERMIT_READ,
-      0,
-      &simpleProfileChar5Props
-    },
+    GATT_DECL_CHAR( &simpleProfileChar5Props ),
 
       // Characteristic Value 5
-      {
-        { ATT_BT_UUID_SIZE, simpleProfilechar5UUID },
-        GATT_PERMIT_AUTHEN_READ,
-        0,
-        simpleProfileChar5
-      },
+      GATT_DECL_VALUE( ATT_BT_UUID_SIZE, simpleProfilechar5UUID,
+                       GATT_PERMIT_AUTHEN_READ, simpleProfileChar5 ),
 
       // Characteristic 5 User Description
-      {
-        { ATT_BT_UUID_SIZE, charUserDescUUID },
-        GATT_PERMIT_READ,
-        0,
-        simpleProfileChar5UserDesp
-      },
+      GATT_DECL_USER_DESC( simpleProfileChar5UserDesp ),
 };
 
 /*********************************************************************
@@ -398,6 +328,12 @@ bStatus_t SimpleProfile_AddService( uint32 services )
                                           GATT_NUM_ATTRS( simpleProfileAttrTbl ),
                                           GATT_MAX_ENCRYPT_KEY_SIZE,
                                           &simpleProfileCBs );
+    if ( status == SUCCESS )
+    {
+      // Part of the layout bonded centrals cache
+      GattDb_addService( simpleProfileAttrTbl,
+                         GATT_NUM_ATTRS( simpleProfileAttrTbl ) );
+    }
   }
   else
   {
@@ -593,44 +529,33 @@ static bStatus_t simpleProfile_ReadAttrCB(uint16_t connHandle,
     return ( ATT_ERR_ATTR_NOT_LONG );
   }
 
-  if ( pAttr->type.len == ATT_BT_UUID_SIZE )
+  switch ( GATT_ATTR_IDX( pAttr, simpleProfileAttrTbl ) )
   {
-    // 16-bit UUID
-    uint16 uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1]);
-    switch ( uuid )
-    {
-      // No need for "GATT_SERVICE_UUID" or "GATT_CLIENT_CHAR_CFG_UUID" cases;
-      // gattserverapp handles those reads
-
-      // characteristics 1 and 2 have read permissions
-      // characteritisc 3 does not have read permissions; therefore it is not
-      //   included here
-      // characteristic 4 does not have read permissions, but because it
-      //   can be sent as a notification, it is included here
-      case SIMPLEPROFILE_CHAR1_UUID:
-      case SIMPLEPROFILE_CHAR2_UUID:
-      case SIMPLEPROFILE_CHAR4_UUID:
-        *pLen = 1;
-        pValue[0] = *pAttr->pValue;
-        break;
-
-      case SIMPLEPROFILE_CHAR5_UUID:
-        *pLen = SIMPLEPROFILE_CHAR5_LEN;
-        VOID memcpy( pValue, pAttr->pValue, SIMPLEPROFILE_CHAR5_LEN );
-        break;
-
-      default:
-        // Should never get here! (characteristics 3 and 4 do not have read permissions)
-        *pLen = 0;
-        status = ATT_ERR_ATTR_NOT_FOUND;
-        break;
-    }
-  }
-  else
-  {
-    // 128-bit UUID
-    *pLen = 0;
-    status = ATT_ERR_INVALID_HANDLE;
+    // No need for the service declaration or the CCC; gattserverapp handles
+    // those reads
+
+    // characteristics 1 and 2 have read permissions
+    // characteritisc 3 does not have read permissions; therefore it is not
+    //   included here
+    // characteristic 4 does not have read permissions, but because it
+    //   can be sent as a notification, it is included here
+    case SIMPLEPROFILE_CHAR1_VALUE_IDX:
+    case SIMPLEPROFILE_CHAR2_VALUE_IDX:
+    case SIMPLEPROFILE_CHAR4_VALUE_IDX:
+      *pLen = 1;
+      pValue[0] = *pAttr->pValue;
+      break;
+
+    case SIMPLEPROFILE_CHAR5_VALUE_IDX:
+      *pLen = SIMPLEPROFILE_CHAR5_LEN;
+      VOID memcpy( pValue, pAttr->pValue, SIMPLEPROFILE_CHAR5_LEN );
+      break;
+
+    default:
+      // Should never get here! (characteristics 3 and 4 do not have read permissions)
+      *pLen = 0;
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
   }
 
   return ( status );
@@ -658,62 +583,52 @@ static bStatus_t simpleProfile_WriteAttrCB(uint16_t connHandle,
   bStatus_t status = SUCCESS;
   uint8 notifyApp = 0xFF;
 
-  if ( pAttr->type.len == ATT_BT_UUID_SIZE )
+  switch ( GATT_ATTR_IDX( pAttr, simpleProfileAttrTbl ) )
   {
-    // 16-bit UUID
-    uint16 uuid = BUILD_UINT16( pAttr->type.uuid[0], pAttr->type.uuid[1]);
-    switch ( uuid )
-    {
-      case SIMPLEPROFILE_CHAR1_UUID:
-      case SIMPLEPROFILE_CHAR3_UUID:
+    case SIMPLEPROFILE_CHAR1_VALUE_IDX:
+    case SIMPLEPROFILE_CHAR3_VALUE_IDX:
 
-        //Validate the value
-        // Make sure it's not a blob oper
-        if ( offset == 0 )
+      //Validate the value
+      // Make sure it's not a blob oper
+      if ( offset == 0 )
+      {
+        if ( len != 1 )
         {
-          if ( len != 1 )
-          {
-            status = ATT_ERR_INVALID_VALUE_SIZE;
-          }
+          status = ATT_ERR_INVALID_VALUE_SIZE;
         }
-        else
+      }
+      else
+      {
+        status = ATT_ERR_ATTR_NOT_LONG;
+      }
+
+      //Write the value
+      if ( status == SUCCESS )
+      {
+        uint8 *pCurValue = (uint8 *)pAttr->pValue;
+        *pCurValue = pValue[0];
+
+        if( pAttr->pValue == &simpleProfileChar1 )
         {
-          status = ATT_ERR_ATTR_NOT_LONG;
+          notifyApp = SIMPLEPROFILE_CHAR1;
         }
-
-        //Write the value
-        if ( status == SUCCESS )
+        else
         {
-          uint8 *pCurValue = (uint8 *)pAttr->pValue;
-          *pCurValue = pValue[0];
-
-          if( pAttr->pValue == &simpleProfileChar1 )
-          {
-            notifyApp = SIMPLEPROFILE_CHAR1;
-          }
-          else
-          {
-            notifyApp = SIMPLEPROFILE_CHAR3;
-          }
+          notifyApp = SIMPLEPROFILE_CHAR3;
         }
+      }
 
-        break;
+      break;
 
-      case GATT_CLIENT_CHAR_CFG_UUID:
-        status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
-                                                 offset, GATT_CLIENT_CFG_NOTIFY );
-        break;
+    case SIMPLEPROFILE_CHAR4_CCC_IDX:
+      status = GATTServApp_ProcessCCCWriteReq( connHandle, pAttr, pValue, len,
+                                               offset, GATT_CLIENT_CFG_NOTIFY );
+      break;
 
-      default:
-        // Should never get here! (characteristics 2 and 4 do not have write permissions)
-        status = ATT_ERR_ATTR_NOT_FOUND;
-        break;
-    }
-  }
-  else
-  {
-    // 128-bit UUID
-    status = ATT_ERR_INVALID_HANDLE;
+    default:
+      // Should never get here! (characteristics 2 and 4 do not have write permissions)
+      status = ATT_ERR_ATTR_NOT_FOUND;
+      break;
   }
 
   // If a characteristic value changed then callback function to notify application of change
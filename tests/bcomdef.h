@@ -0,0 +1,15 @@
+/******************************************************************************
+
+ @file  bcomdef.h
+
+ @brief Host stand-in of the BLE stack common definitions, see
+        icall_ble_api.h.
+
+ *****************************************************************************/
+
+#ifndef BCOMDEF_H
+#define BCOMDEF_H
+
+#include "icall_ble_api.h"
+
+#endif /* BCOMDEF_H */
@@ -0,0 +1,19 @@
+/******************************************************************************
+
+ @file  icall.h
+
+ @brief Host stand-in of the ICall header, for the modules of the host tests
+        that include it. Their BLE API comes from icall_ble_api.h.
+
+ *****************************************************************************/
+
+#ifndef ICALL_H
+#define ICALL_H
+
+#include <stdint.h>
+
+#include <ti/sysbios/knl/Event.h>
+
+typedef Event_Handle ICall_SyncHandle;
+
+#endif /* ICALL_H */
@@ -0,0 +1,85 @@
+/******************************************************************************
+
+ @file  icall_ble_api.h
+
+ @brief Host stand-in of the BLE stack API: the types, macros and status
+        codes used by the modules of the host tests, with the values of
+        the stack.
+
+ *****************************************************************************/
+
+#ifndef ICALL_BLE_API_H
+#define ICALL_BLE_API_H
+
+#include <stdint.h>
+
+#ifndef TRUE
+#define TRUE                    1
+#endif
+#ifndef FALSE
+#define FALSE                   0
+#endif
+
+#ifndef MIN
+#define MIN(n, m)               (((n) < (m)) ? (n) : (m))
+#endif
+#ifndef MAX
+#define MAX(n, m)               (((n) < (m)) ? (m) : (n))
+#endif
+
+#define BREAK_UINT32(var, ByteNum) \
+          (uint8_t)((uint32_t)(((var) >> ((ByteNum) * 8)) & 0x00FF))
+#define BUILD_UINT32(Byte0, Byte1, Byte2, Byte3) \
+          ((uint32_t)((uint32_t)((Byte0) & 0x00FF) \
+          + ((uint32_t)((Byte1) & 0x00FF) << 8) \
+          + ((uint32_t)((Byte2) & 0x00FF) << 16) \
+          + ((uint32_t)((Byte3) & 0x00FF) << 24)))
+#define BUILD_UINT16(loByte, hiByte) \
+          ((uint16_t)(((loByte) & 0x00FF) + (((hiByte) & 0x00FF) << 8)))
+#define HI_UINT16(a)            (((a) >> 8) & 0xFF)
+#define LO_UINT16(a)            ((a) & 0xFF)
+
+typedef uint8_t bStatus_t;
+typedef uint8_t uint8;
+typedef uint16_t uint16;
+typedef uint32_t uint32;
+
+#define SUCCESS                 0x00
+#define FAILURE                 0x01
+#define MSG_BUFFER_NOT_AVAIL    0x10
+#define bleIncorrectMode        0x12
+#define blePending              0x17
+
+#define B_ADDR_LEN              6
+
+#define LINKDB_CONNHANDLE_INVALID  0xFFFF
+#define LINKDB_CONNHANDLE_ALL      0xFFFE
+
+typedef struct
+{
+  uint8_t  addrType;
+  uint8_t  addr[B_ADDR_LEN];
+  uint16_t connInterval;
+  uint16_t connLatency;
+  uint16_t connTimeout;
+  uint8_t  clockAccuracy;
+  uint8_t  stateFlags;
+  uint8_t  taskID;
+} linkDBInfo_t;
+
+extern bStatus_t linkDB_GetInfo(uint16_t connHandle, linkDBInfo_t *pInfo);
+
+typedef struct
+{
+  uint8_t  status;
+  uint16_t handle;
+  uint8_t  channel;
+  uint8_t  phy;
+  int8_t   lastRssi;
+  uint16_t packets;
+  uint16_t errors;
+  uint8_t  nextTaskType;
+  uint32_t nextTaskTime;
+} Gap_ConnEventRpt_t;
+
+#endif /* ICALL_BLE_API_H */
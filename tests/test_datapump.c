@@ -0,0 +1,322 @@
+/******************************************************************************
+
+ @file  test_datapump.c
+
+ @brief Host tests of the data pump (datapump.c) on a model of the stack:
+        STACK_BUFFERS TX buffers, sent in order, of which the link sends
+        up to linkPerEvt per connection event. The send functions of the
+        streams stand in for GATT_Notification of the services, the log
+        download always having more to send.
+
+        Checks that an alert raised under a saturating download is queued
+        at once, and prints the connection event it goes out in: 1 is the
+        first event after the alert was raised.
+
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "datapump.h"
+
+// TX buffers of the stack
+#define STACK_BUFFERS     DATAPUMP_STACK_DEPTH
+
+// Most LIVE and BULK notifications queued per connection event
+#define SHARED_PER_EVT    (DATAPUMP_STACK_DEPTH - DATAPUMP_ALERT_RESERVE)
+
+// Connection interval the latency is printed for, ms
+#define CONN_INTERVAL_MS  100
+
+// Alert not queued or sent yet
+#define NOT_SENT          0xFFFFFFFF
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+static int failures = 0;
+
+// Stack model, queue[0] goes out first
+static uint8_t queue[STACK_BUFFERS];
+static uint8_t queued;
+static uint8_t linkPerEvt;
+static uint32_t eventNum;
+
+// Streams
+static bool liveOn;
+static bool alertPending;
+static uint32_t alertQueuedEvt;
+static uint32_t alertSentEvt;
+
+static bool registered;
+
+static bStatus_t stack_notify(uint8_t stream)
+{
+  if (queued == STACK_BUFFERS)
+  {
+    return blePending;
+  }
+
+  if ((stream == DATAPUMP_STREAM_ALERT) && (alertQueuedEvt == NOT_SENT))
+  {
+    alertQueuedEvt = eventNum;
+  }
+
+  queue[queued++] = stream;
+  return SUCCESS;
+}
+
+static void stack_connEvt(void)
+{
+  Gap_ConnEventRpt_t report;
+  uint8_t sent = (queued < linkPerEvt) ? queued : linkPerEvt;
+  uint8_t i;
+
+  eventNum++;
+  for (i = 0; i < sent; i++)
+  {
+    if ((queue[i] == DATAPUMP_STREAM_ALERT) && (alertSentEvt == NOT_SENT))
+    {
+      alertSentEvt = eventNum;
+    }
+  }
+  memmove(queue, &queue[sent], queued - sent);
+  queued -= sent;
+
+  memset(&report, 0, sizeof(report));
+  DataPump_processConnEvt(&report);
+}
+
+static bStatus_t logSend(void)
+{
+  return stack_notify(DATAPUMP_STREAM_LOG);
+}
+
+static bStatus_t liveSend(void)
+{
+  return (liveOn) ? stack_notify(DATAPUMP_STREAM_LIVE) : FAILURE;
+}
+
+// As liveStream_sendAlert, for a single central
+static bStatus_t alertSend(void)
+{
+  bStatus_t status;
+
+  if (!alertPending)
+  {
+    DataPump_stop(DATAPUMP_STREAM_ALERT);
+    return FAILURE;
+  }
+
+  status = stack_notify(DATAPUMP_STREAM_ALERT);
+  if (status == SUCCESS)
+  {
+    alertPending = false;
+  }
+
+  return status;
+}
+
+static void registerCb(uint8_t enable)
+{
+  registered = enable;
+}
+
+static void reset(uint8_t perEvt)
+{
+  DataPump_stop(DATAPUMP_STREAM_LOG);
+  DataPump_stop(DATAPUMP_STREAM_LIVE);
+  DataPump_stop(DATAPUMP_STREAM_ALERT);
+
+  DataPump_init(registerCb);
+  DataPump_addStream(DATAPUMP_STREAM_LOG, DATAPUMP_CLASS_BULK, logSend);
+  DataPump_addStream(DATAPUMP_STREAM_LIVE, DATAPUMP_CLASS_LIVE, liveSend);
+  DataPump_addStream(DATAPUMP_STREAM_ALERT, DATAPUMP_CLASS_ALERT,
+                     alertSend);
+
+  queued = 0;
+  linkPerEvt = perEvt;
+  eventNum = 0;
+  liveOn = false;
+  alertPending = false;
+  alertQueuedEvt = NOT_SENT;
+  alertSentEvt = NOT_SENT;
+}
+
+static void run(uint32_t numEvents)
+{
+  while (numEvents--)
+  {
+    stack_connEvt();
+  }
+}
+
+// Raise an alert between two connection events and run until it is sent.
+// The connection events it was queued after and went out in are counted
+// from the alert: queued 0 is before the first event.
+static void raiseAlert(uint32_t *pQueued, uint32_t *pSent)
+{
+  uint32_t raisedEvt = eventNum;
+
+  alertPending = true;
+  alertQueuedEvt = NOT_SENT;
+  alertSentEvt = NOT_SENT;
+  DataPump_start(DATAPUMP_STREAM_ALERT);
+
+  while ((alertSentEvt == NOT_SENT) && (eventNum < raisedEvt + 100))
+  {
+    stack_connEvt();
+  }
+
+  *pQueued = alertQueuedEvt - raisedEvt;
+  *pSent = alertSentEvt - raisedEvt;
+}
+
+static void test_bulkAlone(void)
+{
+  dataPumpStats_t stats;
+
+  // A download alone on the link is not held back by DATAPUMP_BULK_LIMIT,
+  // only by the buffers reserved for alerts
+  reset(STACK_BUFFERS + 1);
+  DataPump_start(DATAPUMP_STREAM_LOG);
+  CHECK(registered);
+  CHECK(queued == SHARED_PER_EVT);
+  run(10);
+  DataPump_getStats(&stats);
+  CHECK(stats.lastPerEvt == SHARED_PER_EVT);
+  CHECK(stats.lastPerEvt > DATAPUMP_BULK_LIMIT);
+
+  // A slower link: every buffer it frees is refilled
+  reset(2);
+  DataPump_start(DATAPUMP_STREAM_LOG);
+  run(10);
+  DataPump_getStats(&stats);
+  CHECK(stats.lastPerEvt == 2);
+  CHECK(queued == STACK_BUFFERS);
+
+  DataPump_stop(DATAPUMP_STREAM_LOG);
+  CHECK(!registered);
+}
+
+static void test_liveAndBulk(void)
+{
+  dataPumpStats_t stats;
+
+  // Both saturating: LIVE and BULK share by their weights
+  reset(STACK_BUFFERS);
+  liveOn = true;
+  DataPump_start(DATAPUMP_STREAM_LOG);
+  DataPump_start(DATAPUMP_STREAM_LIVE);
+  run(40);
+  DataPump_getStats(&stats);
+  CHECK(stats.lastPerEvt == SHARED_PER_EVT);
+  CHECK(stats.classNotis[DATAPUMP_CLASS_LIVE] >=
+        2 * stats.classNotis[DATAPUMP_CLASS_BULK]);
+  CHECK(stats.classNotis[DATAPUMP_CLASS_BULK] > 0);
+
+  // The live stream runs dry: the download takes its buffers back
+  liveOn = false;
+  run(2);
+  DataPump_getStats(&stats);
+  CHECK(stats.lastPerEvt == SHARED_PER_EVT);
+  CHECK(stats.classNotis[DATAPUMP_CLASS_ALERT] == 0);
+}
+
+static void test_alertIdleLink(void)
+{
+  uint32_t queuedEvt;
+  uint32_t sentEvt;
+
+  // Nothing else queued: the alert goes out in the next event
+  reset(STACK_BUFFERS);
+  raiseAlert(&queuedEvt, &sentEvt);
+  CHECK(queuedEvt == 0);
+  CHECK(sentEvt == 1);
+  CHECK(!registered);
+}
+
+static void test_alertLatency(void)
+{
+  static const uint8_t perEvt[] = { STACK_BUFFERS, STACK_BUFFERS + 1 };
+  dataPumpStats_t stats;
+  uint32_t queuedEvt;
+  uint32_t sentEvt;
+  uint8_t i;
+
+  // The link sends the whole stack in a connection event: the alert is
+  // queued at once and goes out in the next event
+  for (i = 0; i < sizeof(perEvt); i++)
+  {
+    // Download alone
+    reset(perEvt[i]);
+    DataPump_start(DATAPUMP_STREAM_LOG);
+    run(10);
+    raiseAlert(&queuedEvt, &sentEvt);
+    CHECK(queuedEvt == 0);
+    CHECK(sentEvt == 1);
+    printf("test_datapump: %u per event, download: alert in event %u "
+           "(at most %u ms)\n", perEvt[i], (unsigned)sentEvt,
+           (unsigned)(sentEvt * CONN_INTERVAL_MS));
+
+    // The alert stream stopped by itself, the download goes on
+    DataPump_getStats(&stats);
+    CHECK(stats.classNotis[DATAPUMP_CLASS_ALERT] == 1);
+    CHECK(registered);
+
+    // Download and live stream
+    reset(perEvt[i]);
+    liveOn = true;
+    DataPump_start(DATAPUMP_STREAM_LOG);
+    DataPump_start(DATAPUMP_STREAM_LIVE);
+    run(10);
+    raiseAlert(&queuedEvt, &sentEvt);
+    CHECK(queuedEvt == 0);
+    CHECK(sentEvt == 1);
+    printf("test_datapump: %u per event, download and live: alert in "
+           "event %u (at most %u ms)\n", perEvt[i], (unsigned)sentEvt,
+           (unsigned)(sentEvt * CONN_INTERVAL_MS));
+  }
+}
+
+static void test_alertSlowLink(void)
+{
+  static const uint8_t perEvt[] = { 2, SHARED_PER_EVT };
+  uint32_t queuedEvt;
+  uint32_t sentEvt;
+  uint8_t i;
+
+  // The link sends less than the stack holds: the alert is still queued
+  // within the first connection event
+  for (i = 0; i < sizeof(perEvt); i++)
+  {
+    reset(perEvt[i]);
+    liveOn = true;
+    DataPump_start(DATAPUMP_STREAM_LOG);
+    DataPump_start(DATAPUMP_STREAM_LIVE);
+    run(10);
+    raiseAlert(&queuedEvt, &sentEvt);
+    CHECK(queuedEvt <= 1);
+    printf("test_datapump: %u per event, download and live: alert in "
+           "event %u (at most %u ms)\n", perEvt[i], (unsigned)sentEvt,
+           (unsigned)(sentEvt * CONN_INTERVAL_MS));
+  }
+}
+
+int main(void)
+{
+  test_bulkAlone();
+  test_liveAndBulk();
+  test_alertIdleLink();
+  test_alertLatency();
+  test_alertSlowLink();
+
+  printf("test_datapump: %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
@@ -0,0 +1,389 @@
+/******************************************************************************
+
+ @file  test_logsync.c
+
+ @brief Host tests of the log transfer (logsync.c) at the default ATT_MTU
+        of 23, where a notification carries 20 bytes, and at the largest
+        MTU. The transfer runs on the real data pump (datapump.c); the Log
+        Transfer service, the log, the bookmarks, the clocks and the time
+        base are stood in for below.
+
+ *****************************************************************************/
+
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "util.h"
+#include "services/logxfer.h"
+#include "datalog.h"
+#include "datapump.h"
+#include "logbookmark.h"
+#include "logsync.h"
+#include "timebase.h"
+
+#define CONN_HANDLE       0
+
+// Payload of a notification at the default ATT_MTU and at the largest one
+#define MTU23_PAYLOAD     (23 - 3)
+#define MTU247_PAYLOAD    (247 - 3)
+
+// TX buffers of the stack
+#define STACK_BUFFERS     5
+
+// Records in the log
+#define LOG_RECORDS       40
+
+// Records of the log still only in RAM at the head
+#define RAM_RECORDS       10
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+static int failures = 0;
+
+// Notifications queued in the stack, in order
+static uint8_t notis[STACK_BUFFERS][MTU247_PAYLOAD];
+static uint16_t notiLen[STACK_BUFFERS];
+static uint8_t numNotis;
+
+static uint16_t payloadLen = MTU23_PAYLOAD;
+
+// Records of the log written to flash
+static uint32_t syncedRecords = LOG_RECORDS;
+
+// Value of the Control read
+static uint8_t status[LOGXFER_CONTROL_LEN];
+
+// Most units the central received in one notification
+static uint32_t maxPerNoti;
+
+/*********************************************************************
+ * Stand-ins
+ */
+
+void Event_post(Event_Handle handle, uint32_t eventMask)
+{
+  (void)handle;
+  (void)eventMask;
+}
+
+Clock_Handle Util_constructClock(Clock_Struct *pClock, Clock_FuncPtr clockCB,
+                                 uint32_t clockDuration, uint32_t clockPeriod,
+                                 uint8_t startFlag, UArg arg)
+{
+  (void)clockPeriod;
+  pClock->fxn = clockCB;
+  pClock->arg = arg;
+  pClock->timeout = clockDuration;
+  pClock->active = startFlag;
+  return pClock;
+}
+
+void Util_restartClock(Clock_Struct *pClock, uint32_t clockTimeout)
+{
+  pClock->timeout = clockTimeout;
+  pClock->active = true;
+}
+
+bool Util_isActive(Clock_Struct *pClock)
+{
+  return pClock->active;
+}
+
+void Util_stopClock(Clock_Struct *pClock)
+{
+  pClock->active = false;
+}
+
+uint64_t Timebase_now(void)
+{
+  return 0;
+}
+
+uint32_t Timebase_msSince(uint64_t since)
+{
+  (void)since;
+  return 0;
+}
+
+bStatus_t linkDB_GetInfo(uint16_t connHandle, linkDBInfo_t *pInfo)
+{
+  (void)connHandle;
+  memset(pInfo, 0, sizeof(*pInfo));
+  return SUCCESS;
+}
+
+void LogBookmark_init(void)
+{
+}
+
+uint8_t LogBookmark_open(uint8_t addrType, uint8_t *pAddr, uint32_t seq)
+{
+  (void)addrType;
+  (void)pAddr;
+  (void)seq;
+  return LOGBOOKMARK_NONE;
+}
+
+uint32_t LogBookmark_get(uint8_t index)
+{
+  (void)index;
+  return 0;
+}
+
+void LogBookmark_set(uint8_t index, uint32_t seq)
+{
+  (void)index;
+  (void)seq;
+}
+
+// Amplitude record seq at second 1000 + seq, of level seq, read from
+// flash or RAM alike
+uint8_t Datalog_read(uint32_t seq, datalogRecord_t *pRecs, uint8_t maxCount)
+{
+  uint8_t count = 0;
+
+  while ((count < maxCount) && (seq + count < LOG_RECORDS))
+  {
+    memset(&pRecs[count], 0, sizeof(pRecs[count]));
+    pRecs[count].seq = seq + count;
+    pRecs[count].timeStamp = 1000 + seq + count;
+    pRecs[count].type = DATALOG_TYPE_AMPLITUDE;
+    pRecs[count].value[0] = seq + count;
+    count++;
+  }
+
+  return count;
+}
+
+uint32_t Datalog_getHeadSeq(void)
+{
+  return LOG_RECORDS;
+}
+
+uint32_t Datalog_getSyncedSeq(void)
+{
+  return syncedRecords;
+}
+
+uint32_t Datalog_getOldestSeq(void)
+{
+  return 0;
+}
+
+uint8_t Datalog_getStorageState(void)
+{
+  return 0;
+}
+
+bStatus_t LogXfer_SetParameter(uint8_t param, uint16_t len, void *value)
+{
+  (void)param;
+  memcpy(status, value, len);
+  return SUCCESS;
+}
+
+uint8_t LogXfer_IsNotifyEnabled(uint16_t connHandle)
+{
+  (void)connHandle;
+  return TRUE;
+}
+
+bStatus_t LogXfer_Notify(uint16_t connHandle, uint8_t *pData, uint16_t len)
+{
+  (void)connHandle;
+
+  if ((numNotis == STACK_BUFFERS) || (len > payloadLen))
+  {
+    return blePending;
+  }
+
+  memcpy(notis[numNotis], pData, len);
+  notiLen[numNotis++] = len;
+  return SUCCESS;
+}
+
+// As GATTServApp_NotifyEncode, with a buffer of the payload size
+bStatus_t LogXfer_NotifyEncode(uint16_t connHandle, logXferEncode_t pfnEncode)
+{
+  uint16_t len;
+
+  (void)connHandle;
+
+  if (numNotis == STACK_BUFFERS)
+  {
+    return blePending;
+  }
+
+  len = pfnEncode(notis[numNotis], payloadLen);
+  if (len)
+  {
+    notiLen[numNotis++] = len;
+  }
+
+  return SUCCESS;
+}
+
+/*********************************************************************
+ * Central
+ */
+
+static void registerCb(uint8_t enable)
+{
+  (void)enable;
+}
+
+static void control(const uint8_t *pData, uint16_t len)
+{
+  uint8_t buf[16];
+
+  memcpy(buf, pData, len);
+  LogSync_processControl(CONN_HANDLE, buf, len);
+}
+
+static void start(uint32_t fromSeq)
+{
+  const uint8_t op[] =
+  {
+    LOGSYNC_OP_START, BREAK_UINT32(fromSeq, 0), BREAK_UINT32(fromSeq, 1),
+    BREAK_UINT32(fromSeq, 2), BREAK_UINT32(fromSeq, 3)
+  };
+
+  control(op, sizeof(op));
+}
+
+static void ack(uint32_t nextSeq)
+{
+  const uint8_t op[] =
+  {
+    LOGSYNC_OP_ACK, BREAK_UINT32(nextSeq, 0), BREAK_UINT32(nextSeq, 1),
+    BREAK_UINT32(nextSeq, 2), BREAK_UINT32(nextSeq, 3), 0, 0, 0, 0
+  };
+
+  control(op, sizeof(op));
+}
+
+// Connection event: the link sends every queued notification, the central
+// checks the units against the log and acknowledges them. *pLast is set on
+// the last unit.
+static void connEvt(uint32_t *pNextSeq, bool *pLast)
+{
+  Gap_ConnEventRpt_t report;
+  uint8_t *pUnit;
+  uint32_t seq;
+  uint8_t i;
+
+  for (i = 0; i < numNotis; i++)
+  {
+    CHECK(notiLen[i] <= payloadLen);
+    CHECK((notiLen[i] % LOGSYNC_UNIT_LEN) == 0);
+    maxPerNoti = MAX(maxPerNoti, notiLen[i] / LOGSYNC_UNIT_LEN);
+
+    for (pUnit = notis[i]; pUnit < notis[i] + notiLen[i];
+         pUnit += LOGSYNC_UNIT_LEN)
+    {
+      seq = BUILD_UINT32(pUnit[0], pUnit[1], pUnit[2], pUnit[3]);
+      CHECK(seq == *pNextSeq);
+      CHECK(pUnit[4] == 1);
+      CHECK(BUILD_UINT32(pUnit[5], pUnit[6], pUnit[7], pUnit[8]) ==
+            1000 + seq);
+      CHECK((pUnit[9] & LOGSYNC_UNIT_TYPE_MASK) == DATALOG_TYPE_AMPLITUDE);
+      CHECK(BUILD_UINT16(pUnit[10], pUnit[11]) == seq);
+      if (pUnit[9] & LOGSYNC_UNIT_FLAG_LAST)
+      {
+        *pLast = true;
+      }
+
+      *pNextSeq += pUnit[4];
+    }
+  }
+  numNotis = 0;
+
+  memset(&report, 0, sizeof(report));
+  DataPump_processConnEvt(&report);
+  ack(*pNextSeq);
+}
+
+// Full sync of the log, returns the most units received in a notification
+static uint32_t sync(void)
+{
+  uint32_t nextSeq = 0;
+  bool last = false;
+  int events;
+
+  maxPerNoti = 0;
+  start(0);
+  CHECK(status[0] == LOGSYNC_STATE_ACTIVE);
+
+  for (events = 0; (events < 100) && !last; events++)
+  {
+    connEvt(&nextSeq, &last);
+  }
+
+  CHECK(last);
+  CHECK(nextSeq == syncedRecords);
+  CHECK(status[0] == LOGSYNC_STATE_IDLE);
+
+  return maxPerNoti;
+}
+
+static void test_syncMtu23(void)
+{
+  // One unit per notification fills the payload
+  payloadLen = MTU23_PAYLOAD;
+  CHECK(LOGSYNC_UNIT_LEN <= MTU23_PAYLOAD);
+  CHECK(sync() == 1);
+}
+
+static void test_syncMtu247(void)
+{
+  payloadLen = MTU247_PAYLOAD;
+  CHECK(sync() > 1);
+  payloadLen = MTU23_PAYLOAD;
+}
+
+static void test_syncRamTail(void)
+{
+  // Records only in RAM are not sent, nor reported as in the log
+  syncedRecords = LOG_RECORDS - RAM_RECORDS;
+  sync();
+  CHECK(BUILD_UINT32(status[5], status[6], status[7], status[8]) ==
+        syncedRecords);
+  syncedRecords = LOG_RECORDS;
+}
+
+static void test_nothingToSend(void)
+{
+  uint8_t *pUnit = notis[0];
+
+  // An empty last unit at the head, which fits the default MTU
+  start(LOG_RECORDS);
+  CHECK(numNotis == 1);
+  CHECK(notiLen[0] == LOGSYNC_UNIT_LEN);
+  CHECK(BUILD_UINT32(pUnit[0], pUnit[1], pUnit[2], pUnit[3]) == LOG_RECORDS);
+  CHECK(pUnit[4] == 0);
+  CHECK(pUnit[9] == (LOGSYNC_RECORD_SKIP | LOGSYNC_UNIT_FLAG_LAST));
+  CHECK(status[0] == LOGSYNC_STATE_IDLE);
+  numNotis = 0;
+}
+
+int main(void)
+{
+  DataPump_init(registerCb);
+  LogSync_init(NULL, 0);
+  LogSync_linkEstablished(CONN_HANDLE);
+
+  test_syncMtu23();
+  test_syncMtu247();
+  test_syncRamTail();
+  test_nothingToSend();
+
+  printf("test_logsync: %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
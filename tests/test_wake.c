@@ -0,0 +1,193 @@
+/******************************************************************************
+
+ @file  test_wake.c
+
+ @brief Host tests of the wake-on-sound idle (wake.c), on level traces
+        played back by wake_hal_replay.c.
+
+        wake.c keeps its noise floor across calls, as on the device, so the
+        tests run in order on the same instance.
+
+ *****************************************************************************/
+
+#include <stdio.h>
+
+#include "wake.h"
+#include "wake_hal_replay.h"
+
+#define NOISE_THRESHOLD   1000
+
+#define CHECK(cond)                                                   \
+  do {                                                                \
+    if (!(cond)) {                                                    \
+      printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+      failures++;                                                     \
+    }                                                                 \
+  } while (0)
+
+#define ARRAY_LEN(a)      (sizeof(a) / sizeof((a)[0]))
+
+static int failures = 0;
+
+// Reading due: what the sensor task does when woken in the idle
+static void readingDue(void)
+{
+  if (Wake_poll())
+  {
+    Wake_exit();
+  }
+}
+
+static wakeStats_t getStats(void)
+{
+  wakeStats_t stats;
+
+  Wake_getStats(&stats);
+  return stats;
+}
+
+// Traces, one level per WAKE_HAL_CHECK_PERIOD
+
+// Quiet room with a single knock on the table
+static const uint16_t knockTrace[] =
+{
+  210, 205, 1600, 208, 212, 206, 209, 211
+};
+
+// Quiet room, a knock, then someone starts to speak
+static const uint16_t speechTrace[] =
+{
+  207, 211, 1640, 204, 209, 1380, 1520, 1610, 1580
+};
+
+// Speech below the noise threshold but above the floor
+static const uint16_t softSpeechTrace[] =
+{
+  205, 990, 995, 980
+};
+
+// Speech above the noise threshold
+static const uint16_t loudSpeechTrace[] =
+{
+  205, 1040, 1100
+};
+
+static void test_noFloor(void)
+{
+  // Nothing heard yet to know the room by: wake on speech only
+  Wake_enter(NOISE_THRESHOLD);
+  CHECK(getStats().threshold == NOISE_THRESHOLD);
+  CHECK(WakeHalReplay_isArmed());
+  Wake_exit();
+  CHECK(!WakeHalReplay_isArmed());
+}
+
+static void test_floorTracking(void)
+{
+  int i;
+
+  // The first quiet sample sets the floor
+  Wake_track(100, NOISE_THRESHOLD);
+  CHECK(getStats().noiseFloor == 100);
+
+  for (i = 0; i < 100; i++)
+  {
+    Wake_track(100, NOISE_THRESHOLD);
+  }
+  CHECK(getStats().noiseFloor == 100);
+
+  // Speech is not part of the floor
+  for (i = 0; i < 100; i++)
+  {
+    Wake_track(NOISE_THRESHOLD + 1, NOISE_THRESHOLD);
+  }
+  CHECK(getStats().noiseFloor == 100);
+
+  // The floor follows a louder room, 1/16 of the step per sample
+  Wake_track(260, NOISE_THRESHOLD);
+  CHECK(getStats().noiseFloor == 110);
+  for (i = 0; i < 128; i++)
+  {
+    Wake_track(200, NOISE_THRESHOLD);
+  }
+  CHECK(getStats().noiseFloor >= 199);
+  CHECK(getStats().noiseFloor <= 200);
+
+  // A quiet room does not lower the threshold of the next idle
+  Wake_enter(NOISE_THRESHOLD);
+  CHECK(getStats().threshold == NOISE_THRESHOLD);
+  Wake_exit();
+}
+
+static void test_debounce(void)
+{
+  wakeStats_t before = getStats();
+  uint32_t read;
+
+  // A single knock does not end the idle
+  Wake_enter(NOISE_THRESHOLD);
+  WakeHalReplay_load(knockTrace, ARRAY_LEN(knockTrace));
+  read = WakeHalReplay_run();
+  CHECK(read == ARRAY_LEN(knockTrace));
+  CHECK(WakeHalReplay_isArmed());
+  CHECK(getStats().numSoundWakes == before.numSoundWakes);
+  Wake_exit();
+
+  // Nor does a knock followed by a quiet reading; WAKE_CONFIRM readings
+  // in a row above the threshold do, at the second of them
+  Wake_enter(NOISE_THRESHOLD);
+  WakeHalReplay_load(speechTrace, ARRAY_LEN(speechTrace));
+  read = WakeHalReplay_run();
+  CHECK(read == 7);
+  CHECK(!WakeHalReplay_isArmed());
+  CHECK(getStats().numSoundWakes == before.numSoundWakes + 1);
+  CHECK(getStats().numIdles == before.numIdles + 2);
+}
+
+static void test_thresholdFloor(void)
+{
+  int i;
+
+  // A room close to the noise threshold: floor + margin is above it
+  for (i = 0; i < 256; i++)
+  {
+    Wake_track(NOISE_THRESHOLD - 10, NOISE_THRESHOLD);
+  }
+  CHECK(getStats().noiseFloor + WAKE_MARGIN > NOISE_THRESHOLD);
+
+  Wake_enter(NOISE_THRESHOLD);
+  CHECK(getStats().threshold == getStats().noiseFloor + WAKE_MARGIN);
+  Wake_exit();
+
+  // In a quiet room speech below the noise threshold, which the governor
+  // would not count as sound, does not wake the task
+  for (i = 0; i < 256; i++)
+  {
+    Wake_track(200, NOISE_THRESHOLD);
+  }
+  Wake_enter(NOISE_THRESHOLD);
+  CHECK(getStats().threshold == NOISE_THRESHOLD);
+  WakeHalReplay_load(softSpeechTrace, ARRAY_LEN(softSpeechTrace));
+  CHECK(WakeHalReplay_run() == ARRAY_LEN(softSpeechTrace));
+  CHECK(WakeHalReplay_isArmed());
+  Wake_exit();
+
+  // Speech above it does
+  Wake_enter(NOISE_THRESHOLD);
+  WakeHalReplay_load(loudSpeechTrace, ARRAY_LEN(loudSpeechTrace));
+  CHECK(WakeHalReplay_run() == ARRAY_LEN(loudSpeechTrace));
+  CHECK(!WakeHalReplay_isArmed());
+}
+
+int main(void)
+{
+  Wake_init(NULL, readingDue);
+
+  test_noFloor();
+  test_floorTracking();
+  test_debounce();
+  test_thresholdFloor();
+
+  printf("test_wake: %s\n", failures ? "FAILED" : "passed");
+  return failures ? 1 : 0;
+}
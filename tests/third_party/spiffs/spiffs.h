@@ -0,0 +1,15 @@
+/******************************************************************************
+
+ @file  spiffs.h
+
+ @brief Host stand-in of SPIFFS: only the file system type, for the
+        headers that name it.
+
+ *****************************************************************************/
+
+#ifndef SPIFFS_H
+#define SPIFFS_H
+
+typedef struct spiffs_t spiffs;
+
+#endif /* SPIFFS_H */
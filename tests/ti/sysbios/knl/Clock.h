@@ -0,0 +1,29 @@
+/******************************************************************************
+
+ @file  Clock.h
+
+ @brief Host stand-in of the TI-RTOS Clock module: the types util.h uses.
+
+ *****************************************************************************/
+
+#ifndef TI_SYSBIOS_KNL_CLOCK_H
+#define TI_SYSBIOS_KNL_CLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <ti/sysbios/knl/Event.h>
+
+typedef void (*Clock_FuncPtr)(UArg arg);
+
+typedef struct
+{
+  Clock_FuncPtr fxn;
+  UArg          arg;
+  uint32_t      timeout;
+  bool          active;
+} Clock_Struct;
+
+typedef Clock_Struct *Clock_Handle;
+
+#endif /* TI_SYSBIOS_KNL_CLOCK_H */
@@ -0,0 +1,19 @@
+/******************************************************************************
+
+ @file  Event.h
+
+ @brief Host stand-in of the TI-RTOS Event module.
+
+ *****************************************************************************/
+
+#ifndef TI_SYSBIOS_KNL_EVENT_H
+#define TI_SYSBIOS_KNL_EVENT_H
+
+#include <stdint.h>
+
+typedef uintptr_t UArg;
+typedef struct Event_Object *Event_Handle;
+
+extern void Event_post(Event_Handle handle, uint32_t eventMask);
+
+#endif /* TI_SYSBIOS_KNL_EVENT_H */
@@ -0,0 +1,20 @@
+/******************************************************************************
+
+ @file  Queue.h
+
+ @brief Host stand-in of the TI-RTOS Queue module: the types util.h uses.
+
+ *****************************************************************************/
+
+#ifndef TI_SYSBIOS_KNL_QUEUE_H
+#define TI_SYSBIOS_KNL_QUEUE_H
+
+typedef struct
+{
+  void *next;
+  void *prev;
+} Queue_Struct;
+
+typedef Queue_Struct *Queue_Handle;
+
+#endif /* TI_SYSBIOS_KNL_QUEUE_H */
@@ -0,0 +1,88 @@
+/******************************************************************************
+
+ @file  wake_hal_replay.c
+
+ @brief Host stand-in of wake_hal.c: plays back a trace of recorded levels.
+
+        While armed, WakeHalReplay_run calls the due callback once per
+        reading of the trace, as the clock of the device does every
+        WAKE_HAL_CHECK_PERIOD ms; WakeHal_read returns the next level of
+        the trace.
+
+ *****************************************************************************/
+
+/*********************************************************************
+ * INCLUDES
+ */
+#include <stddef.h>
+
+#include "wake_hal.h"
+#include "wake_hal_replay.h"
+
+/*********************************************************************
+ * LOCAL VARIABLES
+ */
+
+static wakeHalDue_t pfnReadingDue = NULL;
+static bool armed = false;
+
+static const uint16_t *pTrace = NULL;
+static uint32_t traceLen = 0;
+static uint32_t traceNext = 0;
+
+/*********************************************************************
+ * PUBLIC FUNCTIONS
+ */
+
+void WakeHal_init(void *pSource, wakeHalDue_t pfnDue)
+{
+  (void)pSource;
+  pfnReadingDue = pfnDue;
+  armed = false;
+}
+
+void WakeHal_arm(void)
+{
+  armed = true;
+}
+
+void WakeHal_disarm(void)
+{
+  armed = false;
+}
+
+bool WakeHal_read(uint16_t *pLevel)
+{
+  if (traceNext >= traceLen)
+  {
+    return false;
+  }
+
+  *pLevel = pTrace[traceNext++];
+  return true;
+}
+
+void WakeHalReplay_load(const uint16_t *pLevels, uint32_t numLevels)
+{
+  pTrace = pLevels;
+  traceLen = numLevels;
+  traceNext = 0;
+}
+
+uint32_t WakeHalReplay_run(void)
+{
+  while (armed && (traceNext < traceLen))
+  {
+    pfnReadingDue();
+  }
+
+  return traceNext;
+}
+
+bool WakeHalReplay_isArmed(void)
+{
+  return armed;
+}
+
+/*********************************************************************
+*********************************************************************/
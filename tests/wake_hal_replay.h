@@ -0,0 +1,24 @@
+/******************************************************************************
+
+ @file  wake_hal_replay.h
+
+ @brief Host stand-in of wake_hal.c: plays back a trace of recorded levels.
+
+ *****************************************************************************/
+
+#ifndef WAKE_HAL_REPLAY_H
+#define WAKE_HAL_REPLAY_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Levels returned by WakeHal_read, one per reading, in order
+extern void WakeHalReplay_load(const uint16_t *pLevels, uint32_t numLevels);
+
+// Fire the due callback until disarmed or the trace is over. Returns the
+// number of levels of the trace read so far.
+extern uint32_t WakeHalReplay_run(void);
+
+extern bool WakeHalReplay_isArmed(void);
+
+#endif /* WAKE_HAL_REPLAY_H */